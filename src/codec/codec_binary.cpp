@@ -0,0 +1,336 @@
+#include "codec_binary.h"
+
+namespace gateway
+{
+
+	namespace
+	{
+
+		// Bounds checked reader over one record
+		struct Reader
+		{
+			const uint8_t * data;
+			size_t size;
+			size_t offset;
+
+			bool varint(uint64_t & x)
+			{
+				x = 0;
+				for (int shift = 0; shift < 64; shift += 7)
+				{
+					if (offset >= size)
+						return false;
+
+					uint8_t byte = data[offset++];
+					x |= (uint64_t)(byte & 0x7F) << shift;
+
+					if ((byte & 0x80) == 0)
+						return true;
+				}
+				return false;
+			}
+
+			bool byte(uint8_t & x)
+			{
+				if (offset >= size)
+					return false;
+				x = data[offset++];
+				return true;
+			}
+
+			bool bytes(size_t length, const uint8_t *& x)
+			{
+				if (length > size - offset)
+					return false;
+				x = data + offset;
+				offset += length;
+				return true;
+			}
+
+			template<typename T>
+			bool raw(T & x)
+			{
+				const uint8_t * p;
+				if (bytes(sizeof(T), p) == false)
+					return false;
+				memcpy(&x, p, sizeof(T));
+				return true;
+			}
+		};
+
+		bool decodeElement(Reader & reader, CODEC_Type_t type, CODEC_Record_t & record)
+		{
+			CODEC_Number_t number;
+			uint64_t x;
+
+			switch (type)
+			{
+			case CODEC_TYPE_BOOL:
+			{
+				uint8_t b;
+				if (reader.byte(b) == false)
+					return false;
+				number.u = b;
+			} break;
+			case CODEC_TYPE_INT8:
+			case CODEC_TYPE_INT16:
+			case CODEC_TYPE_INT32:
+			case CODEC_TYPE_INT64:
+			case CODEC_TYPE_DATETIME:
+				if (reader.varint(x) == false)
+					return false;
+				number.i = codec_unzigzag(x);
+				break;
+			case CODEC_TYPE_UINT8:
+			case CODEC_TYPE_UINT16:
+			case CODEC_TYPE_UINT32:
+			case CODEC_TYPE_UINT64:
+				if (reader.varint(x) == false)
+					return false;
+				number.u = x;
+				break;
+			case CODEC_TYPE_FLOAT:
+			{
+				float f;
+				if (reader.raw(f) == false)
+					return false;
+				number.d = f;
+			} break;
+			case CODEC_TYPE_DOUBLE:
+				if (reader.raw(number.d) == false)
+					return false;
+				break;
+			case CODEC_TYPE_STRING:
+			{
+				const uint8_t * p;
+				if (reader.varint(x) == false || reader.bytes((size_t) x, p) == false)
+					return false;
+				record.strings.push_back(std::string((const char *) p, (size_t) x));
+				return true;
+			}
+			default:
+				return false;
+			}
+
+			record.numbers.push_back(number);
+			return true;
+		}
+
+	}
+
+	double CODEC_Record_t::toDouble(size_t index) const
+	{
+		if (index >= numbers.size())
+			return 0.0;
+
+		switch (type)
+		{
+		case CODEC_TYPE_FLOAT:
+		case CODEC_TYPE_DOUBLE:
+			return numbers[index].d;
+		case CODEC_TYPE_INT8:
+		case CODEC_TYPE_INT16:
+		case CODEC_TYPE_INT32:
+		case CODEC_TYPE_INT64:
+		case CODEC_TYPE_DATETIME:
+			return (double) numbers[index].i;
+		default:
+			return (double) numbers[index].u;
+		}
+	}
+
+	CODEC_Decoder::CODEC_Decoder() :
+		m_entries(),
+		m_pending(),
+		m_started(false)
+	{
+
+	}
+
+	void CODEC_Decoder::reset()
+	{
+		m_entries.clear();
+		m_pending.clear();
+		m_started = false;
+	}
+
+	size_t CODEC_Decoder::getEntryCount() const
+	{
+		return m_entries.size();
+	}
+
+	bool CODEC_Decoder::feed(const uint8_t * data, size_t size, std::vector<CODEC_Record_t> & records)
+	{
+		m_pending.insert(m_pending.end(), data, data + size);
+
+		size_t offset = 0;
+		bool ok = true;
+
+		while (offset < m_pending.size())
+		{
+			// A magic (re)starts the stream with an empty dictionary
+			if (m_pending[offset] == 0)
+			{
+				if (m_pending.size() - offset < sizeof(CODEC_MAGIC))
+					break;
+
+				if (memcmp(&m_pending[offset], CODEC_MAGIC, sizeof(CODEC_MAGIC)) != 0)
+				{
+					ok = false;
+					break;
+				}
+
+				m_entries.clear();
+				m_started = true;
+				offset += sizeof(CODEC_MAGIC);
+				continue;
+			}
+
+			if (m_started == false)
+			{
+				ok = false;
+				break;
+			}
+
+			// Wait for the rest of a partial record
+			Reader header = { m_pending.data() + offset, m_pending.size() - offset, 0 };
+			uint64_t length;
+			if (header.varint(length) == false)
+			{
+				if (header.size >= 10)
+					ok = false;
+				break;
+			}
+
+			if (length > header.size - header.offset)
+				break;
+
+			CODEC_Record_t record = CODEC_Record_t();
+			bool isRecord = false;
+
+			if (decode(header.data + header.offset, (size_t) length, record, isRecord) == false)
+			{
+				ok = false;
+				break;
+			}
+
+			if (isRecord)
+				records.push_back(std::move(record));
+
+			offset += header.offset + (size_t) length;
+		}
+
+		m_pending.erase(m_pending.begin(), m_pending.begin() + offset);
+		return ok;
+	}
+
+	bool CODEC_Decoder::decode(const uint8_t * data, size_t size, CODEC_Record_t & record, bool & isRecord)
+	{
+		Reader reader = { data, size, 0 };
+		uint8_t kind;
+		uint64_t id;
+
+		if (reader.byte(kind) == false || reader.varint(id) == false)
+			return false;
+
+		if (kind == CODEC_KIND_ENTRY)
+		{
+			uint64_t serverId, nsIndex, length;
+			const uint8_t * identifier;
+
+			if (reader.varint(serverId) == false || reader.varint(nsIndex) == false || reader.varint(length) == false || reader.bytes((size_t) length, identifier) == false)
+				return false;
+
+			// Ids are assigned densely, a later definition of the same id replaces the earlier one. Records
+			// already decoded keep the entry they refer to
+			if (id > m_entries.size() + (1 << 20))
+				return false;
+			if (id >= m_entries.size())
+				m_entries.resize((size_t) id + 1);
+
+			CODEC_Entry_t * entry = new CODEC_Entry_t();
+			entry->serverId = (int32_t) codec_unzigzag(serverId);
+			entry->nsIndex = (uint16_t) nsIndex;
+			entry->identifier.assign((const char *) identifier, (size_t) length);
+			m_entries[(size_t) id] = std::shared_ptr<const CODEC_Entry_t>(entry);
+			return true;
+		}
+
+		// Unknown kinds are skipped for forward compatibility
+		if (kind != CODEC_KIND_VALUE && kind != CODEC_KIND_AGGREGATE)
+			return true;
+
+		if (id >= m_entries.size() || m_entries[(size_t) id] == NULL)
+			return false;
+
+		uint64_t timestamp;
+		uint8_t type;
+
+		if (kind == CODEC_KIND_AGGREGATE)
+		{
+			uint64_t window;
+			CODEC_Window_t & aggregate = record.aggregate;
+
+			if (reader.varint(timestamp) == false || reader.varint(window) == false || reader.byte(aggregate.functions) == false)
+				return false;
+
+			if (((aggregate.functions & CODEC_AGGREGATE_MIN) && reader.raw(aggregate.min) == false) ||
+				((aggregate.functions & CODEC_AGGREGATE_MAX) && reader.raw(aggregate.max) == false) ||
+				((aggregate.functions & CODEC_AGGREGATE_AVG) && reader.raw(aggregate.avg) == false) ||
+				((aggregate.functions & CODEC_AGGREGATE_COUNT) && reader.varint(aggregate.count) == false) ||
+				((aggregate.functions & CODEC_AGGREGATE_LAST) && reader.raw(aggregate.last) == false))
+				return false;
+
+			record.kind = CODEC_KIND_AGGREGATE;
+			record.entry = m_entries[(size_t) id];
+			record.sourceTimestamp = codec_unzigzag(timestamp);
+			record.type = CODEC_TYPE_DOUBLE;
+			aggregate.window = (int64_t) window;
+
+			isRecord = true;
+			return true;
+		}
+
+		if (reader.varint(timestamp) == false || reader.byte(type) == false)
+			return false;
+
+		record.kind = CODEC_KIND_VALUE;
+		record.entry = m_entries[(size_t) id];
+		record.sourceTimestamp = codec_unzigzag(timestamp);
+		record.type = (CODEC_Type_t)(type & ~CODEC_ARRAY);
+		record.isArray = (type & CODEC_ARRAY) != 0;
+
+		uint64_t count = 1;
+
+		if (record.isArray)
+		{
+			uint64_t n_dimensions;
+			if (reader.varint(n_dimensions) == false || n_dimensions > size)
+				return false;
+
+			for (uint64_t i = 0; i < n_dimensions; i++)
+			{
+				uint64_t dimension;
+				if (reader.varint(dimension) == false)
+					return false;
+
+				record.dimensions.push_back((uint32_t) dimension);
+				count *= dimension;
+			}
+
+			// Every element takes at least one byte
+			if (count > size)
+				return false;
+		}
+
+		for (uint64_t i = 0; i < count; i++)
+		{
+			if (decodeElement(reader, record.type, record) == false)
+				return false;
+		}
+
+		isRecord = true;
+		return true;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,202 @@
+#ifndef CODEC_BINARY_H
+#define CODEC_BINARY_H
+
+// std includes
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+// ---------------------------------------------------------------------------
+// Binary wire format of variable records
+//
+// Depends on the C++ standard library only, so receivers can build this
+// header and codec_binary.cpp on their own to decode the stream.
+//
+// A stream starts with the 5 byte magic "\0GWB1"; a repeated magic starts a
+// new stream and forgets the dictionary. A record never starts with a zero
+// byte, since its length covers at least the kind. Every record is
+//
+//   varint length      bytes of the record after this field
+//   u8     kind        CODEC_KIND_ENTRY, CODEC_KIND_VALUE or
+//                      CODEC_KIND_AGGREGATE
+//
+// An entry defines an identifier once per stream, values refer to it by id:
+//
+//   varint id, zigzag serverId, varint nsIndex, varint length, identifier
+//
+// A value record is
+//
+//   varint id, zigzag sourceTimestamp (UA_DateTime, 100 ns since 1601)
+//   u8     type        CODEC_Type_t, | CODEC_ARRAY for arrays
+//   arrays only:       varint dimension count, varint dimensions..., the
+//                      element count is their product
+//   elements           bool as u8, signed integers as zigzag varints,
+//                      unsigned ones as varints, float and double as raw
+//                      little-endian IEEE 754, strings as varint length and
+//                      bytes, datetimes as zigzag varints
+//
+// An aggregate record summarizes one window of a tag:
+//
+//   varint id, zigzag window start (UA_DateTime), varint window length in
+//   100 ns ticks
+//   u8     functions   CODEC_AGGREGATE_* bits, then per set bit in this
+//                      order min, max, avg as raw double, count as varint
+//                      and last as raw double
+//
+// Decoders skip records of an unknown kind by their length.
+// ---------------------------------------------------------------------------
+
+namespace gateway
+{
+
+	static const char CODEC_MAGIC[5] = { '\0', 'G', 'W', 'B', '1' };
+
+	enum CODEC_Kind_t
+	{
+		CODEC_KIND_ENTRY = 1,
+		CODEC_KIND_VALUE = 2,
+		CODEC_KIND_AGGREGATE = 3
+	};
+
+	enum CODEC_Aggregate_t
+	{
+		CODEC_AGGREGATE_MIN = 1,
+		CODEC_AGGREGATE_MAX = 2,
+		CODEC_AGGREGATE_AVG = 4,
+		CODEC_AGGREGATE_COUNT = 8,
+		CODEC_AGGREGATE_LAST = 16
+	};
+
+	enum CODEC_Type_t
+	{
+		CODEC_TYPE_BOOL = 1,
+		CODEC_TYPE_INT8,
+		CODEC_TYPE_INT16,
+		CODEC_TYPE_INT32,
+		CODEC_TYPE_INT64,
+		CODEC_TYPE_UINT8,
+		CODEC_TYPE_UINT16,
+		CODEC_TYPE_UINT32,
+		CODEC_TYPE_UINT64,
+		CODEC_TYPE_FLOAT,
+		CODEC_TYPE_DOUBLE,
+		CODEC_TYPE_STRING,
+		CODEC_TYPE_DATETIME,
+		CODEC_ARRAY = 0x80
+	};
+
+	// ---------------------------------------------------------------------------
+	// Encoding helpers, append to any string-like buffer
+	// ---------------------------------------------------------------------------
+	template<typename S>
+	inline void codec_putvarint(S & out, uint64_t x)
+	{
+		while (x >= 0x80)
+		{
+			out += (char)(uint8_t)(x | 0x80);
+			x >>= 7;
+		}
+		out += (char)(uint8_t) x;
+	}
+
+	inline uint64_t codec_zigzag(int64_t x)
+	{
+		return ((uint64_t) x << 1) ^ (uint64_t)(x >> 63);
+	}
+
+	inline int64_t codec_unzigzag(uint64_t x)
+	{
+		return (int64_t)(x >> 1) ^ -(int64_t)(x & 1);
+	}
+
+	template<typename S, typename T>
+	inline void codec_putraw(S & out, T x)
+	{
+		// The supported platforms are little-endian, the bytes are written as they are
+		char bytes[sizeof(T)];
+		memcpy(bytes, &x, sizeof(T));
+		out.append(bytes, sizeof(T));
+	}
+
+	inline size_t codec_varintsize(uint64_t x)
+	{
+		size_t n = 1;
+		while (x >= 0x80)
+		{
+			x >>= 7;
+			n++;
+		}
+		return n;
+	}
+
+	// ---------------------------------------------------------------------------
+	// CODEC_Entry_t / CODEC_Record_t
+	// Decoded dictionary entry and value or aggregate record. Numbers keep
+	// their type: signed ones in i, unsigned ones and bools in u, float and
+	// double in d. Aggregate records have the window start as timestamp and
+	// only the sent functions of aggregate set.
+	// ---------------------------------------------------------------------------
+	struct CODEC_Entry_t
+	{
+		int32_t serverId;
+		uint16_t nsIndex;
+		std::string identifier;
+	};
+
+	union CODEC_Number_t
+	{
+		int64_t i;
+		uint64_t u;
+		double d;
+	};
+
+	struct CODEC_Window_t
+	{
+		int64_t window;
+		uint8_t functions;
+		double min;
+		double max;
+		double avg;
+		uint64_t count;
+		double last;
+	};
+
+	struct CODEC_Record_t
+	{
+		CODEC_Kind_t kind;
+		std::shared_ptr<const CODEC_Entry_t> entry;
+		int64_t sourceTimestamp;
+		CODEC_Type_t type;
+		bool isArray;
+		std::vector<uint32_t> dimensions;
+		std::vector<CODEC_Number_t> numbers;
+		std::vector<std::string> strings;
+		CODEC_Window_t aggregate;
+		double toDouble(size_t index = 0) const;
+	};
+
+	// ---------------------------------------------------------------------------
+	// CODEC_Decoder
+	// Decodes one stream, chunk by chunk as it arrives. Records complete in
+	// the fed bytes are returned, a partial one is kept until the next feed.
+	// Returns false on malformed input, the stream can then not be trusted.
+	// ---------------------------------------------------------------------------
+	class CODEC_Decoder
+	{
+	public:
+		CODEC_Decoder();
+		bool feed(const uint8_t * data, size_t size, std::vector<CODEC_Record_t> & records);
+		void reset();
+		size_t getEntryCount() const;
+	private:
+		bool decode(const uint8_t * data, size_t size, CODEC_Record_t & record, bool & isRecord);
+		std::vector<std::shared_ptr<const CODEC_Entry_t>> m_entries;
+		std::vector<uint8_t> m_pending;
+		bool m_started;
+	};
+
+}
+
+#endif // CODEC_BINARY_H
\ No newline at end of file
@@ -0,0 +1,373 @@
+#include "codec_gorilla.h"
+#include <cstring>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace gateway
+{
+
+	namespace
+	{
+
+		// Largest unit of the timestamps, 1 ms in 100 ns ticks
+		const int MAX_UNIT_EXPONENT = 4;
+
+		// Sentinel leading zero count, no XOR window has been sent yet
+		const int NO_WINDOW = 64;
+
+		const int64_t POW10[8] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000 };
+
+		inline uint64_t toBits(double value)
+		{
+			uint64_t bits;
+			memcpy(&bits, &value, 8);
+			return bits;
+		}
+
+		inline double fromBits(uint64_t bits)
+		{
+			double value;
+			memcpy(&value, &bits, 8);
+			return value;
+		}
+
+		inline uint64_t mask(int n)
+		{
+			return (n >= 64) ? ~(uint64_t) 0 : (((uint64_t) 1 << n) - 1);
+		}
+
+		inline int64_t signExtend(uint64_t bits, int n)
+		{
+			return (int64_t)(bits << (64 - n)) >> (64 - n);
+		}
+
+		// x is never zero
+		inline int leadingZeros(uint64_t x)
+		{
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanReverse64(&index, x);
+			return 63 - (int) index;
+#else
+			return __builtin_clzll(x);
+#endif
+		}
+
+		inline int trailingZeros(uint64_t x)
+		{
+#ifdef _MSC_VER
+			unsigned long index;
+			_BitScanForward64(&index, x);
+			return (int) index;
+#else
+			return __builtin_ctzll(x);
+#endif
+		}
+
+	}
+
+	CODEC_GorillaEncoder::CODEC_GorillaEncoder() :
+		m_bytes(),
+		m_acc(0),
+		m_accBits(0),
+		m_count(0),
+		m_unit(1),
+		m_time(0),
+		m_delta(0),
+		m_value(0),
+		m_leading(NO_WINDOW),
+		m_trailing(0)
+	{
+
+	}
+
+	void CODEC_GorillaEncoder::put(uint64_t bits, int n)
+	{
+		// At most 7 bits wait in the accumulator, 32 more always fit
+		if (n > 32)
+		{
+			put(bits >> 32, n - 32);
+			bits &= 0xFFFFFFFF;
+			n = 32;
+		}
+
+		m_acc = (m_acc << n) | (bits & mask(n));
+		m_accBits += n;
+
+		while (m_accBits >= 8)
+		{
+			m_accBits -= 8;
+			m_bytes += (char)(uint8_t)(m_acc >> m_accBits);
+		}
+	}
+
+	void CODEC_GorillaEncoder::append(int64_t time, double value)
+	{
+		uint64_t bits = toBits(value);
+
+		if (m_count == 0)
+		{
+			int exponent = MAX_UNIT_EXPONENT;
+			while (exponent > 0 && time % POW10[exponent] != 0)
+				exponent--;
+			m_unit = POW10[exponent];
+
+			put((uint64_t) exponent, 4);
+			put((uint64_t) time, 64);
+			put(bits, 64);
+
+			m_time = time;
+			m_delta = 0;
+			m_value = bits;
+			m_count = 1;
+			return;
+		}
+
+		// Wrapping differences, any timestamp order round-trips
+		int64_t delta = (int64_t)((uint64_t) time - (uint64_t) m_time);
+		int64_t dod = (int64_t)((uint64_t) delta - (uint64_t) m_delta);
+		int64_t q = dod / m_unit;
+
+		if (dod == 0)
+			put(0, 1);
+		else if (dod % m_unit != 0 || q < INT32_MIN || q > INT32_MAX)
+		{
+			put(0x1F, 5);
+			put((uint64_t) dod, 64);
+		}
+		else if (q >= -64 && q <= 63)
+		{
+			put(0x2, 2);
+			put((uint64_t) q, 7);
+		}
+		else if (q >= -256 && q <= 255)
+		{
+			put(0x6, 3);
+			put((uint64_t) q, 9);
+		}
+		else if (q >= -2048 && q <= 2047)
+		{
+			put(0xE, 4);
+			put((uint64_t) q, 12);
+		}
+		else
+		{
+			put(0x1E, 5);
+			put((uint64_t) q, 32);
+		}
+
+		m_time = time;
+		m_delta = delta;
+
+		uint64_t x = bits ^ m_value;
+		if (x == 0)
+			put(0, 1);
+		else
+		{
+			int leading = leadingZeros(x);
+			int trailing = trailingZeros(x);
+			if (leading > 31)
+				leading = 31;
+
+			if (m_leading != NO_WINDOW && leading >= m_leading && trailing >= m_trailing)
+			{
+				put(0x2, 2);
+				put(x >> m_trailing, 64 - m_leading - m_trailing);
+			}
+			else
+			{
+				int meaningful = 64 - leading - trailing;
+				put(0x3, 2);
+				put((uint64_t) leading, 5);
+				put((uint64_t)(meaningful & 0x3F), 6);
+				put(x >> trailing, meaningful);
+				m_leading = leading;
+				m_trailing = trailing;
+			}
+		}
+
+		m_value = bits;
+		m_count++;
+	}
+
+	void CODEC_GorillaEncoder::getBytes(std::string & out) const
+	{
+		out = m_bytes;
+		if (m_accBits > 0)
+			out += (char)(uint8_t)(m_acc << (8 - m_accBits));
+	}
+
+	void CODEC_GorillaEncoder::reset()
+	{
+		m_bytes.clear();
+		m_acc = 0;
+		m_accBits = 0;
+		m_count = 0;
+		m_unit = 1;
+		m_leading = NO_WINDOW;
+		m_trailing = 0;
+	}
+
+	uint32_t CODEC_GorillaEncoder::getCount() const
+	{
+		return m_count;
+	}
+
+	size_t CODEC_GorillaEncoder::size() const
+	{
+		return m_bytes.size() + ((m_accBits > 0) ? 1 : 0);
+	}
+
+	CODEC_GorillaDecoder::CODEC_GorillaDecoder(const uint8_t * data, size_t size, uint32_t count) :
+		m_data(data),
+		m_size(size),
+		m_offset(0),
+		m_acc(0),
+		m_accBits(0),
+		m_count(count),
+		m_index(0),
+		m_failed(false),
+		m_unit(1),
+		m_time(0),
+		m_delta(0),
+		m_value(0),
+		m_leading(NO_WINDOW),
+		m_trailing(0)
+	{
+
+	}
+
+	bool CODEC_GorillaDecoder::get(int n, uint64_t & bits)
+	{
+		if (n > 32)
+		{
+			uint64_t high;
+			if (get(n - 32, high) == false || get(32, bits) == false)
+				return false;
+			bits |= high << 32;
+			return true;
+		}
+
+		while (m_accBits <= 56 && m_offset < m_size)
+		{
+			m_acc = (m_acc << 8) | m_data[m_offset++];
+			m_accBits += 8;
+		}
+
+		if (m_accBits < n)
+		{
+			m_failed = true;
+			return false;
+		}
+
+		m_accBits -= n;
+		bits = (m_acc >> m_accBits) & mask(n);
+		return true;
+	}
+
+	bool CODEC_GorillaDecoder::next(int64_t & time, double & value)
+	{
+		if (m_failed || m_index >= m_count)
+			return false;
+
+		uint64_t bits;
+
+		if (m_index == 0)
+		{
+			uint64_t exponent, first;
+			if (get(4, exponent) == false || get(64, first) == false || get(64, m_value) == false)
+				return false;
+			if (exponent >= 8)
+			{
+				m_failed = true;
+				return false;
+			}
+
+			m_unit = POW10[exponent];
+			m_time = (int64_t) first;
+		}
+		else
+		{
+			// Count the leading ones of the timestamp prefix, up to 4 after the first
+			int ones = 0;
+			while (ones < 5)
+			{
+				if (get(1, bits) == false)
+					return false;
+				if (bits == 0)
+					break;
+				ones++;
+			}
+
+			static const int WIDTHS[5] = { 0, 7, 9, 12, 32 };
+			int64_t dod = 0;
+
+			if (ones == 5)
+			{
+				if (get(64, bits) == false)
+					return false;
+				dod = (int64_t) bits;
+			}
+			else if (ones > 0)
+			{
+				if (get(WIDTHS[ones], bits) == false)
+					return false;
+				dod = (int64_t)((uint64_t) signExtend(bits, WIDTHS[ones]) * (uint64_t) m_unit);
+			}
+
+			m_delta = (int64_t)((uint64_t) m_delta + (uint64_t) dod);
+			m_time = (int64_t)((uint64_t) m_time + (uint64_t) m_delta);
+
+			if (get(1, bits) == false)
+				return false;
+
+			if (bits == 1)
+			{
+				uint64_t window;
+				if (get(1, window) == false)
+					return false;
+
+				if (window == 0)
+				{
+					if (m_leading == NO_WINDOW)
+					{
+						m_failed = true;
+						return false;
+					}
+				}
+				else
+				{
+					uint64_t leading, meaningful;
+					if (get(5, leading) == false || get(6, meaningful) == false)
+						return false;
+					if (meaningful == 0)
+						meaningful = 64;
+					if (leading + meaningful > 64)
+					{
+						m_failed = true;
+						return false;
+					}
+
+					m_leading = (int) leading;
+					m_trailing = 64 - (int) leading - (int) meaningful;
+				}
+
+				if (get(64 - m_leading - m_trailing, bits) == false)
+					return false;
+				m_value ^= bits << m_trailing;
+			}
+		}
+
+		m_index++;
+		time = m_time;
+		value = fromBits(m_value);
+		return true;
+	}
+
+	bool CODEC_GorillaDecoder::failed() const
+	{
+		return m_failed;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,103 @@
+#ifndef CODEC_GORILLA_H
+#define CODEC_GORILLA_H
+
+// std includes
+#include <string>
+#include <cstdint>
+
+// ---------------------------------------------------------------------------
+// Gorilla compression of one tag's (time, value) samples
+//
+// Depends on the C++ standard library only, like codec_binary. A chunk is a
+// bit stream, most significant bit first, its last byte padded with zeros.
+// The sample count is kept by the container, the stream has no end marker.
+//
+//   4 bits  unit exponent e, timestamps are stepped in units of 10^e ticks
+//   64 bits first timestamp (UA_DateTime, 100 ns since 1601)
+//   64 bits first value, IEEE 754 double
+//
+// Each further sample is its timestamp's delta of delta in units, then its
+// value's XOR with the previous value:
+//
+//   '0'                         delta of delta 0
+//   '10'    + 7 bits            two's complement, in [-64, 63]
+//   '110'   + 9 bits            in [-256, 255]
+//   '1110'  + 12 bits           in [-2048, 2047]
+//   '11110' + 32 bits           in 32 bits
+//   '11111' + 64 bits           in ticks, not a multiple of the unit or
+//                               too large
+//
+//   '0'                         same value
+//   '10'    + meaningful bits   XOR fits within the previous leading and
+//                               trailing zeros
+//   '11'    + 5 bits leading zeros, 6 bits meaningful length (64 as 0)
+//           + meaningful bits
+//
+// The unit is the largest power of ten up to 1 ms dividing the first
+// timestamp, servers stamping in milliseconds then cost 9 bits per sample
+// of jitter rather than 20.
+// ---------------------------------------------------------------------------
+
+namespace gateway
+{
+
+	// ---------------------------------------------------------------------------
+	// CODEC_GorillaEncoder
+	// Appends samples to one chunk, full bytes are kept in a string and up to
+	// 63 bits wait in an accumulator. getBytes also works on an open chunk.
+	// ---------------------------------------------------------------------------
+	class CODEC_GorillaEncoder
+	{
+	public:
+		CODEC_GorillaEncoder();
+		void append(int64_t time, double value);
+		void getBytes(std::string & out) const;
+		void reset();
+		uint32_t getCount() const;
+		size_t size() const;
+	private:
+		void put(uint64_t bits, int n);
+		std::string m_bytes;
+		uint64_t m_acc;
+		int m_accBits;
+		uint32_t m_count;
+		int64_t m_unit;
+		int64_t m_time;
+		int64_t m_delta;
+		uint64_t m_value;
+		int m_leading;
+		int m_trailing;
+	};
+
+	// ---------------------------------------------------------------------------
+	// CODEC_GorillaDecoder
+	// Reads the count samples of one chunk. next returns false past the last
+	// sample or on a stream cut short, check failed() to tell them apart.
+	// ---------------------------------------------------------------------------
+	class CODEC_GorillaDecoder
+	{
+	public:
+		CODEC_GorillaDecoder(const uint8_t * data, size_t size, uint32_t count);
+		bool next(int64_t & time, double & value);
+		bool failed() const;
+	private:
+		bool get(int n, uint64_t & bits);
+		const uint8_t * m_data;
+		size_t m_size;
+		size_t m_offset;
+		uint64_t m_acc;
+		int m_accBits;
+		uint32_t m_count;
+		uint32_t m_index;
+		bool m_failed;
+		int64_t m_unit;
+		int64_t m_time;
+		int64_t m_delta;
+		uint64_t m_value;
+		int m_leading;
+		int m_trailing;
+	};
+
+}
+
+#endif // CODEC_GORILLA_H
\ No newline at end of file
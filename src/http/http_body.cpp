@@ -0,0 +1,161 @@
+#include "http_body.h"
+#include <algorithm>
+#include <cstring>
+
+namespace gateway
+{
+
+	HTTP_Body::HTTP_Body(size_t blockSize) :
+		m_segments(),
+		m_blocks(),
+		m_blockSize(std::max<size_t>(blockSize, 64)),
+		m_blockUsed(0),
+		m_size(0),
+		m_readSegment(0),
+		m_readOffset(0)
+	{
+
+	}
+
+	HTTP_Body::~HTTP_Body()
+	{
+		for (char * block : m_blocks)
+			delete[] block;
+	}
+
+	void HTTP_Body::append(const char * data, size_t size)
+	{
+		if (size == 0)
+			return;
+
+		// Slices lying back to back in one payload make up a single segment
+		if (m_segments.empty() == false && m_segments.back().data + m_segments.back().size == data)
+			m_segments.back().size += size;
+		else
+			m_segments.push_back({ data, size });
+
+		m_size += size;
+	}
+
+	void HTTP_Body::copy(const char * data, size_t size)
+	{
+		while (size > 0)
+		{
+			if (m_blocks.empty() || m_blockUsed == m_blockSize)
+			{
+				m_blocks.push_back(new char[m_blockSize]);
+				m_blockUsed = 0;
+			}
+
+			char * tail = m_blocks.back() + m_blockUsed;
+			size_t n = std::min(size, m_blockSize - m_blockUsed);
+			memcpy(tail, data, n);
+
+			// Consecutive copies into the same block grow one segment
+			if (m_segments.empty() == false && m_segments.back().data + m_segments.back().size == tail)
+				m_segments.back().size += n;
+			else
+				m_segments.push_back({ tail, n });
+
+			m_blockUsed += n;
+			m_size += n;
+			data += n;
+			size -= n;
+		}
+	}
+
+	void HTTP_Body::clear()
+	{
+		// Keep the first block for the next body, larger ones are returned
+		for (size_t i = 1; i < m_blocks.size(); i++)
+			delete[] m_blocks[i];
+		if (m_blocks.size() > 1)
+			m_blocks.resize(1);
+
+		m_segments.clear();
+		m_blockUsed = 0;
+		m_size = 0;
+		m_readSegment = 0;
+		m_readOffset = 0;
+	}
+
+	void HTTP_Body::reserve(size_t segments)
+	{
+		m_segments.reserve(segments);
+	}
+
+	size_t HTTP_Body::size() const
+	{
+		return m_size;
+	}
+
+	size_t HTTP_Body::getSegmentCount() const
+	{
+		return m_segments.size();
+	}
+
+	const HTTP_Segment_t & HTTP_Body::getSegment(size_t index) const
+	{
+		return m_segments[index];
+	}
+
+	void HTTP_Body::rewind()
+	{
+		m_readSegment = 0;
+		m_readOffset = 0;
+	}
+
+	bool HTTP_Body::seek(size_t offset)
+	{
+		if (offset > m_size)
+			return false;
+
+		rewind();
+		while (m_readSegment < m_segments.size() && offset >= m_segments[m_readSegment].size)
+			offset -= m_segments[m_readSegment++].size;
+		m_readOffset = offset;
+
+		return true;
+	}
+
+	size_t HTTP_Body::read(char * buffer, size_t size)
+	{
+		size_t n = 0;
+
+		while (n < size && m_readSegment < m_segments.size())
+		{
+			const HTTP_Segment_t & segment = m_segments[m_readSegment];
+			size_t count = std::min(size - n, segment.size - m_readOffset);
+
+			memcpy(buffer + n, segment.data + m_readOffset, count);
+			n += count;
+			m_readOffset += count;
+
+			if (m_readOffset == segment.size)
+			{
+				m_readSegment++;
+				m_readOffset = 0;
+			}
+		}
+
+		return n;
+	}
+
+	int HTTP_Body::overflow(int c)
+	{
+		if (c != traits_type::eof())
+		{
+			char ch = (char) c;
+			copy(&ch, 1);
+		}
+
+		return traits_type::not_eof(c);
+	}
+
+	std::streamsize HTTP_Body::xsputn(const char * data, std::streamsize size)
+	{
+		copy(data, (size_t) size);
+		return size;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#ifndef HTTP_BODY_H
+#define HTTP_BODY_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <streambuf>
+
+namespace gateway
+{
+
+	struct HTTP_Segment_t
+	{
+		const char * data;
+		size_t size;
+	};
+
+	// A request body as a chain of segments, read by libcurl through a read
+	// callback so it never has to be contiguous. append() refers to bytes that
+	// outlive the request, eg. queued payloads, without copying them. copy()
+	// and the streambuf (for std::ostream, eg. json dumps) write into owned
+	// blocks of blockSize bytes, the first of which is kept across clear().
+	class HTTP_Body : public std::streambuf
+	{
+	public:
+		explicit HTTP_Body(size_t blockSize = 64 * 1024);
+		~HTTP_Body();
+		void append(const char * data, size_t size);
+		void copy(const char * data, size_t size);
+		void clear();
+		void reserve(size_t segments);
+		size_t size() const;
+		size_t getSegmentCount() const;
+		const HTTP_Segment_t & getSegment(size_t index) const;
+		void rewind();
+		bool seek(size_t offset);
+		size_t read(char * buffer, size_t size);
+	protected:
+		int overflow(int c) override;
+		std::streamsize xsputn(const char * data, std::streamsize size) override;
+	private:
+		HTTP_Body(const HTTP_Body &);
+		HTTP_Body & operator=(const HTTP_Body &);
+		std::vector<HTTP_Segment_t> m_segments;
+		std::vector<char *> m_blocks;
+		size_t m_blockSize;
+		size_t m_blockUsed;
+		size_t m_size;
+		size_t m_readSegment;
+		size_t m_readOffset;
+	};
+
+}
+
+#endif // HTTP_BODY_H
\ No newline at end of file
@@ -1,10 +1,31 @@
 #include "http_client.h"
 #include <open62541.h>
+#include <chrono>
 #include "../macros.h"
+#include "../util/metrics.h"
 
 namespace gateway
 {
 
+	namespace
+	{
+
+		size_t readBody(void * buffer, size_t size, size_t count, void * userdata)
+		{
+			return ((HTTP_Body *) userdata)->read((char *) buffer, size * count);
+		}
+
+		// Authentication and redirects may send the body again
+		int seekBody(void * userdata, curl_off_t offset, int origin)
+		{
+			if (origin != SEEK_SET)
+				return CURL_SEEKFUNC_CANTSEEK;
+
+			return ((HTTP_Body *) userdata)->seek((size_t) offset) ? CURL_SEEKFUNC_OK : CURL_SEEKFUNC_FAIL;
+		}
+
+	}
+
 	HTTP_Client::HTTP_Client(
 		const std::string & jsonConfig
 	) :
@@ -13,7 +34,17 @@ namespace gateway
 		m_username(""),
 		m_password(""),
 		m_outputFile(), // output, std::ofstream::out | std::ofstream::binary | std::ofstream::app
-		m_verbose(false)
+		m_verbose(false),
+		m_name("rest"),
+		m_gzip(NULL),
+		m_gzipMinSize(1024),
+		m_compressed(),
+		m_compressedBody(0),
+		m_metricsMutex(),
+		m_gzipBytesIn(0),
+		m_gzipBytesOut(0),
+		m_gzipBodies(0),
+		m_gzipTime(0.0)
 	{
 		// Get config strings as JSON objects
 		json jsonCfg = json::parse(m_jsonConfig);
@@ -24,6 +55,14 @@ namespace gateway
 		m_password = jsonCfg["password"].get<std::string>();
 		m_outputFile = std::ofstream(jsonCfg["output"].get<std::string>(), std::ofstream::out | std::ofstream::binary | std::ofstream::app);
 		m_verbose = jsonCfg["verbose"].get<bool>();
+		m_name = jsonCfg.value("name", m_name);
+
+		// Optional gzip compression of request bodies from the given size on
+		if (jsonCfg.value("compression", std::string("none")) == "gzip")
+		{
+			m_gzip = new Gzip(jsonCfg.value("compressionLevel", 6));
+			m_gzipMinSize = jsonCfg.value("compressionMinSize", m_gzipMinSize);
+		}
 
 		LOG("HTTP_Client initialized successfully, endpoint: %s, output: %s\n", UA_DateTime_now(), m_endpoint.c_str(), jsonCfg["output"].get<std::string>().c_str());
 	}
@@ -31,6 +70,7 @@ namespace gateway
 	HTTP_Client::~HTTP_Client()
 	{
 		m_outputFile.close();
+		DELETES(m_gzip);
 	}
 
 	json HTTP_Client::getJSON(const std::string & path)
@@ -87,11 +127,33 @@ namespace gateway
 		return result;
 	}
 
-	void HTTP_Client::sendJSON(const std::string & path, HTTP_Request_t request, json & data)
+	bool HTTP_Client::sendJSON(const std::string & path, HTTP_Request_t request, json & data)
+	{
+		// Dump straight into the segments of the body, the text is never made contiguous
+		HTTP_Body body;
+		std::ostream stream(&body);
+		stream << data;
+
+		return sendBody(path, request, body);
+	}
+
+	bool HTTP_Client::sendBody(const std::string & path, HTTP_Request_t request, const std::string & body)
+	{
+		return sendBody(path, request, body.data(), body.size());
+	}
+
+	bool HTTP_Client::sendBody(const std::string & path, HTTP_Request_t request, const char * data, size_t size, const char * contentType)
+	{
+		HTTP_Body body(0);
+		body.append(data, size);
+
+		return sendBody(path, request, body, contentType);
+	}
+
+	bool HTTP_Client::sendBody(const std::string & path, HTTP_Request_t request, HTTP_Body & body, const char * contentType)
 	{
 		// Store request variables
 		std::string url_str(m_endpoint + path);
-		std::string data_str = data.dump();
 
 		// Input stream for request output
 		curl_ios<std::ostream> cwriter(m_outputFile);
@@ -103,7 +165,43 @@ namespace gateway
 		curl_header cheader;
 
 		// Add request headers
-		cheader.add("Content-Type: application/json");
+		cheader.add(std::string("Content-Type: ") + contentType);
+
+		// The body is read by libcurl as it goes out, without waiting for 100-continue
+		cheader.add("Expect:");
+		HTTP_Body * payload = &body;
+
+		// Compress on the calling thread, which is the sender of the body
+		if (m_gzip != NULL && body.size() >= m_gzipMinSize)
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			size_t size = body.size();
+
+			// Deflate needs its input in one piece, a body of several segments is gathered first
+			if (body.getSegmentCount() == 1)
+			{
+				m_gzip->compress(body.getSegment(0).data, size, m_compressed);
+			}
+			else
+			{
+				std::string gathered(size, '\0');
+				body.rewind();
+				body.read(&gathered[0], size);
+				m_gzip->compress(gathered.data(), size, m_compressed);
+			}
+
+			m_compressedBody.clear();
+			m_compressedBody.append(m_compressed.data(), m_compressed.size());
+			payload = &m_compressedBody;
+
+			std::lock_guard<std::mutex> lock(m_metricsMutex);
+			m_gzipTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			m_gzipBytesIn += size;
+			m_gzipBytesOut += m_compressed.size();
+			m_gzipBodies++;
+
+			cheader.add("Content-Encoding: gzip");
+		}
 
 		// Add request payload
 		ceasy.add<CURLOPT_HTTPHEADER>(cheader.get());
@@ -116,14 +214,20 @@ namespace gateway
 			ceasy.add<CURLOPT_PASSWORD>(m_password.c_str());
 			ceasy.add<CURLOPT_HTTPAUTH>(CURLAUTH_BASIC | CURLAUTH_DIGEST);
 		}
+		payload->rewind();
+		ceasy.add<CURLOPT_POST>(1L);
 		ceasy.add<CURLOPT_CUSTOMREQUEST>((request == HTTP_POST) ? "POST" : "PUT");
-		ceasy.add<CURLOPT_POSTFIELDS>(data_str.c_str());
-		ceasy.add<CURLOPT_POSTFIELDSIZE>(-1L);
+		ceasy.add<CURLOPT_POSTFIELDSIZE>((long) payload->size());
+		ceasy.add<CURLOPT_READFUNCTION>(&readBody);
+		ceasy.add<CURLOPT_READDATA>((void *) payload);
+		ceasy.add<CURLOPT_SEEKFUNCTION>(&seekBody);
+		ceasy.add<CURLOPT_SEEKDATA>((void *) payload);
 
 		try
 		{
 			// Excecute the request
 			ceasy.perform();
+			return isSuccess(ceasy, url_str);
 		}
 		catch (const curl_easy_exception & e)
 		{
@@ -133,6 +237,62 @@ namespace gateway
 		{
 			ERR("normal Exception: %s\n", UA_DateTime_now(), e.what());
 		}
+
+		return false;
+	}
+
+	bool HTTP_Client::streamBody(const std::string & path, HTTP_Request_t request, size_t (*read)(void * buffer, size_t size, size_t count, void * userdata), void * userdata, const char * contentType)
+	{
+		// Store request variables
+		std::string url_str(m_endpoint + path);
+
+		// Input stream for request output
+		curl_ios<std::ostream> cwriter(m_outputFile);
+
+		// Create the curl easy handle
+		curl_easy ceasy(cwriter);
+
+		// Create request header
+		curl_header cheader;
+
+		// Add request headers, the body goes in chunks of unknown total size without waiting for 100-continue
+		cheader.add(std::string("Content-Type: ") + contentType);
+		cheader.add("Transfer-Encoding: chunked");
+		cheader.add("Expect:");
+
+		// Add request payload. A body pulled off the queue cannot be rewound, so no
+		// redirects and no digest authentication, which would send it a second time
+		ceasy.add<CURLOPT_HTTPHEADER>(cheader.get());
+		ceasy.add<CURLOPT_URL>(url_str.c_str());
+		ceasy.add<CURLOPT_FOLLOWLOCATION>(0L);
+		ceasy.add<CURLOPT_VERBOSE>((m_verbose == true) ? 1L : 0L);
+		if (m_username.empty() == false)
+		{
+			ceasy.add<CURLOPT_USERNAME>(m_username.c_str());
+			ceasy.add<CURLOPT_PASSWORD>(m_password.c_str());
+			ceasy.add<CURLOPT_HTTPAUTH>(CURLAUTH_BASIC);
+		}
+		ceasy.add<CURLOPT_POST>(1L);
+		ceasy.add<CURLOPT_CUSTOMREQUEST>((request == HTTP_POST) ? "POST" : "PUT");
+		ceasy.add<CURLOPT_READFUNCTION>(read);
+		ceasy.add<CURLOPT_READDATA>(userdata);
+
+		try
+		{
+			// Excecute the request, returns once read() ends the body
+			ceasy.perform();
+			return isSuccess(ceasy, url_str);
+		}
+		catch (const curl_easy_exception & e)
+		{
+			ERR("libcurl Exception: %s\n", UA_DateTime_now(), e.what());
+		}
+		catch (const std::exception & e)
+		{
+			ERR("normal Exception: %s\n", UA_DateTime_now(), e.what());
+		}
+
+		return false;
 	}
 
 	void HTTP_Client::sendREQ(const std::string & path, HTTP_Request_t request)
@@ -180,9 +340,40 @@ namespace gateway
 		}
 	}
 
+	bool HTTP_Client::isSuccess(curl_easy & ceasy, const std::string & url)
+	{
+		// The transfer went through, the server still has to accept the body
+		long status = ceasy.get_info<CURLINFO_RESPONSE_CODE>().get();
+		if (status >= 200 && status < 300)
+			return true;
+
+		ERR("HTTP_Client %s answered with status %ld\n", UA_DateTime_now(), url.c_str(), status);
+		return false;
+	}
+
 	bool HTTP_Client::isVerbose() const
 	{
 		return m_verbose;
 	}
 
+	void HTTP_Client::reportMetrics()
+	{
+		if (m_gzip == NULL)
+			return;
+
+		std::lock_guard<std::mutex> lock(m_metricsMutex);
+		std::string prefix = "http." + m_name + ".";
+
+		// Ratio and time per body are over the bodies compressed since the previous report
+		Metrics::instance().add(prefix + "gzip_bytes_in", (double) m_gzipBytesIn);
+		Metrics::instance().add(prefix + "gzip_bytes_out", (double) m_gzipBytesOut);
+		Metrics::instance().set(prefix + "gzip_ratio", (m_gzipBytesOut > 0) ? (double) m_gzipBytesIn / m_gzipBytesOut : 1.0);
+		Metrics::instance().set(prefix + "gzip_ms", (m_gzipBodies > 0) ? m_gzipTime / m_gzipBodies : 0.0);
+
+		m_gzipBytesIn = 0;
+		m_gzipBytesOut = 0;
+		m_gzipBodies = 0;
+		m_gzipTime = 0.0;
+	}
+
 }
\ No newline at end of file
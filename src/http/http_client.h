@@ -4,11 +4,14 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <mutex>
 #include <curl_easy.h>
 #include <curl_ios.h>
 #include <curl_exception.h>
 #include <curl_header.h>
 #include "../3rdparty/json.hpp"
+#include "../util/gzip.h"
+#include "http_body.h"
 
 // For convenience
 using json = nlohmann::json;
@@ -29,6 +32,13 @@ namespace gateway
 		HTTP_DELETE
 	};
 
+	// Bodies are handed to libcurl through a read callback from the segments
+	// of an HTTP_Body, so they are neither made contiguous nor copied by it.
+	// streamBody holds one request open with chunked transfer encoding and
+	// pulls its body from the read callback until it returns 0; such bodies
+	// are not compressed, not redirected and use basic authentication only.
+	// Sending returns true once the server answered with a 2xx status, a
+	// libcurl error or any other status is logged and returns false.
 	class HTTP_Client
 	{
 	public:
@@ -37,16 +47,32 @@ namespace gateway
 		);
 		~HTTP_Client();
 		nlohmann::json getJSON(const std::string & path);
-		void sendJSON(const std::string & path, HTTP_Request_t request, nlohmann::json & data);
+		bool sendJSON(const std::string & path, HTTP_Request_t request, nlohmann::json & data);
+		bool sendBody(const std::string & path, HTTP_Request_t request, const std::string & body);
+		bool sendBody(const std::string & path, HTTP_Request_t request, const char * data, size_t size, const char * contentType = "application/json");
+		bool sendBody(const std::string & path, HTTP_Request_t request, HTTP_Body & body, const char * contentType = "application/json");
+		bool streamBody(const std::string & path, HTTP_Request_t request, size_t (*read)(void * buffer, size_t size, size_t count, void * userdata), void * userdata, const char * contentType = "application/x-ndjson");
 		void sendREQ(const std::string & path, HTTP_Request_t request);
 		bool isVerbose() const;
+		void reportMetrics();
 	private:
+		bool isSuccess(curl_easy & ceasy, const std::string & url);
 		std::string m_jsonConfig;
 		std::string m_endpoint;
 		std::string m_username;
 		std::string m_password;
 		std::ofstream m_outputFile;
 		bool m_verbose;
+		std::string m_name;
+		Gzip * m_gzip;
+		size_t m_gzipMinSize;
+		std::string m_compressed;
+		HTTP_Body m_compressedBody;
+		std::mutex m_metricsMutex;
+		uint64_t m_gzipBytesIn;
+		uint64_t m_gzipBytesOut;
+		uint64_t m_gzipBodies;
+		double m_gzipTime;
 	};
 
 }
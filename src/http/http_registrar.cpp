@@ -0,0 +1,138 @@
+#include "http_registrar.h"
+#include <algorithm>
+#include <cmath>
+#include <open62541.h>
+#include "../macros.h"
+#include "../3rdparty/json.hpp"
+#include "http_client.h"
+
+// For convenience
+using json = nlohmann::json;
+
+namespace gateway
+{
+
+	HTTP_Registrar::HTTP_Registrar(
+		const std::string & jsonConfig
+	) :
+		m_httpClient(new HTTP_Client(jsonConfig)),
+		m_retryDelay(5000.0),
+		m_retryMaxDelay(60000.0),
+		m_tasks(),
+		m_retries(),
+		m_mutex(),
+		m_condition(),
+		m_running(true),
+		m_thread()
+	{
+		json jsonCfg = json::parse(jsonConfig);
+		m_retryDelay = jsonCfg.value("retryDelay", m_retryDelay);
+		m_retryMaxDelay = jsonCfg.value("retryMaxDelay", m_retryMaxDelay);
+
+		// Start the worker only after all members are initialized
+		m_thread = std::thread(&HTTP_Registrar::run, this);
+
+		LOG("HTTP_Registrar initialized successfully.\n", UA_DateTime_now());
+	}
+
+	HTTP_Registrar::~HTTP_Registrar()
+	{
+		size_t n_dropped = 0;
+
+		// Stop the worker, tasks still waiting are dropped
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			n_dropped = m_tasks.size() + m_retries.size();
+			m_tasks.clear();
+			m_retries.clear();
+			m_running = false;
+		}
+		m_condition.notify_all();
+
+		if (m_thread.joinable())
+			m_thread.join();
+
+		DELETES(m_httpClient);
+
+		if (n_dropped > 0)
+			WRN("HTTP_Registrar was destroyed, %u pending tasks were dropped.\n", UA_DateTime_now(), (unsigned int) n_dropped);
+	}
+
+	void HTTP_Registrar::push(const HTTP_Task_t & task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_tasks.push_back(task);
+		}
+		m_condition.notify_one();
+	}
+
+	size_t HTTP_Registrar::getPendingCount()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_tasks.size() + m_retries.size();
+	}
+
+	void HTTP_Registrar::run()
+	{
+		while (true)
+		{
+			HTTP_Task_t task;
+			uint32_t attempts = 0;
+
+			// Wait for the next task, a due retry or shutdown
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+
+				while (m_running && m_tasks.empty() && (m_retries.empty() || std::chrono::steady_clock::now() < m_retries.front().dueAt))
+				{
+					if (m_retries.empty())
+						m_condition.wait(lock);
+					else
+						m_condition.wait_until(lock, m_retries.front().dueAt);
+				}
+
+				if (m_running == false)
+					break;
+
+				if (m_tasks.empty() == false)
+				{
+					task = m_tasks.front();
+					m_tasks.pop_front();
+				}
+				else
+				{
+					task = m_retries.front().task;
+					attempts = m_retries.front().attempts;
+					m_retries.pop_front();
+				}
+			}
+
+			bool ok = false;
+
+			try
+			{
+				ok = task(m_httpClient);
+			}
+			catch (const std::exception & e)
+			{
+				ERR("HTTP_Registrar task Exception: %s\n", UA_DateTime_now(), e.what());
+			}
+
+			if (ok)
+				continue;
+
+			// Retries wait in the order they failed, the delay only grows with the attempts
+			attempts++;
+			double delay = std::min(m_retryMaxDelay, m_retryDelay * std::pow(2.0, (double) std::min(attempts - 1, 16u)));
+			std::chrono::steady_clock::time_point dueAt = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(delay));
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+			auto it = std::upper_bound(m_retries.begin(), m_retries.end(), dueAt, [](const std::chrono::steady_clock::time_point & t, const HTTP_Retry_t & retry) { return t < retry.dueAt; });
+			m_retries.insert(it, { task, attempts, dueAt });
+
+			WRN("HTTP_Registrar task failed %u times, retry in %.0f ms\n", UA_DateTime_now(), attempts, delay);
+		}
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#ifndef REGISTRAR_HTTP_H
+#define REGISTRAR_HTTP_H
+
+#include <string>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+namespace gateway
+{
+
+	class HTTP_Client;
+
+	// Returns false when the request failed and should be tried again
+	typedef std::function<bool(HTTP_Client * const)> HTTP_Task_t;
+
+	struct HTTP_Retry_t
+	{
+		HTTP_Task_t task;
+		uint32_t attempts;
+		std::chrono::steady_clock::time_point dueAt;
+	};
+
+	// Runs REST bookkeeping (server / subscription registration) on a
+	// background thread with its own HTTP_Client, so data capture does not
+	// have to wait for the metadata round trips. A failed task is run again
+	// after retryDelay ms, doubled per attempt up to retryMaxDelay ms; new
+	// tasks go before the retries that are waiting.
+	class HTTP_Registrar
+	{
+	public:
+		HTTP_Registrar(
+			const std::string & jsonConfig
+		);
+		~HTTP_Registrar();
+		void push(const HTTP_Task_t & task);
+		size_t getPendingCount();
+	private:
+		void run();
+		HTTP_Client * m_httpClient;
+		double m_retryDelay;
+		double m_retryMaxDelay;
+		std::deque<HTTP_Task_t> m_tasks;
+		std::deque<HTTP_Retry_t> m_retries;
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		bool m_running;
+		std::thread m_thread;
+	};
+
+}
+
+#endif // REGISTRAR_HTTP_H
\ No newline at end of file
@@ -5,9 +5,13 @@
 #include "3rdparty/json.hpp"
 #include "macros.h"
 #include "util/strutils.h"
+#include "util/metrics.h"
 #include "opcua/opcua_client.h"
 #include "opcua/opcua_subscription.h"
 #include "http/http_client.h"
+#include "http/http_registrar.h"
+#include "sink/sink_fanout.h"
+#include "store/store_timeseries.h"
 
 // For convenience
 using json = nlohmann::json;
@@ -22,6 +26,13 @@ static std::vector<OPCUA_Client *> gateway_opcua_clients;
 
 // Gateway HTTP data
 static HTTP_Client * gateway_http_client;
+static HTTP_Registrar * gateway_http_registrar;
+
+// Gateway egress data
+static SINK_Fanout * gateway_sinks;
+
+// Gateway local history data
+static STORE_TimeSeries * gateway_history;
 
 // Gateway DB data
 static json gateway_db_servers;
@@ -51,63 +62,113 @@ int main(int argc, char * argv[])
 	// Initialize HTTP client
 	gateway_http_client = new HTTP_Client(gateway_settings["ua_rest_config"].dump());
 
+	// Initialize background REST registration
+	gateway_http_registrar = new HTTP_Registrar(gateway_settings["ua_rest_config"].dump());
+
+	// Initialize the sinks variables are written to in the background
+	gateway_sinks = new SINK_Fanout(gateway_settings["sinks"].dump(), gateway_settings["ua_rest_config"].dump());
+
+	// Initialize the local history of numeric samples if enabled
+	if (gateway_settings.count("history") > 0 && gateway_settings["history"].value("enabled", false))
+		gateway_history = new STORE_TimeSeries(gateway_settings["history"].dump());
+
 	// Get list of servers and subscriptions from db
 	gateway_db_servers = gateway_http_client->getJSON("/opcuaservers");
 	gateway_db_subscriptions = gateway_http_client->getJSON("/opcuasubscriptions");
 
-	try
+	// Initialize all clients, a failing client must not prevent the others from starting
+	size_t n_clients = gateway_settings["ua_client_config"].size();
+	for (size_t i = 0; i < n_clients; i++)
 	{
-		// Initialize all clients
-		size_t n_clients = gateway_settings["ua_client_config"].size();
-		for (size_t i = 0; i < n_clients; i++)
+		try
 		{
 			// Create client instance
 			OPCUA_Client * client = new OPCUA_Client(
 				gateway_settings["ua_client_config"][i].dump(),
 				gateway_db_servers.dump(),
 				gateway_db_subscriptions.dump(),
-				gateway_http_client
+				gateway_http_client,
+				gateway_http_registrar,
+				gateway_sinks,
+				gateway_history
 			);
 
 			// Push the client into clients vector
 			gateway_opcua_clients.push_back(client);
 		}
-	}
-	catch (const std::exception & e)
-	{
-		ERR("Exception: %s\n", UA_DateTime_now(), e.what());
+		catch (const std::exception & e)
+		{
+			ERR("Exception: %s\n", UA_DateTime_now(), e.what());
+		}
 	}
 
 	// Runtime service config properties
 	bool quit_on_error = gateway_settings["ua_service_config"]["quit_on_error"].get<bool>();
+	double metrics_interval = gateway_settings["ua_service_config"].value("metrics_interval", 60.0);
+	UA_DateTime metrics_report_at = UA_DateTime_now() + (UA_DateTime)(metrics_interval * UA_SEC_TO_DATETIME);
 
-	// Main loop, exit if an error occurs
+	// Main loop, every client keeps its own health so a failing server only affects itself
 	while (true)
 	{
+		size_t n_available = 0;
+
 		// Iterate through all clients
 		for (OPCUA_Client * c : gateway_opcua_clients)
 		{
-			c->update();
-
-			// Break if error happened and quit_on_error is true
-			if ((gateway_opcua_status = c->getStatus()) != UA_STATUSCODE_GOOD && quit_on_error)
-				break;
+			try
+			{
+				c->update();
+			}
+			catch (const std::exception & e)
+			{
+				ERR("OPCUA_Client serverId(%d) update Exception: %s\n", UA_DateTime_now(), c->getServerId(), e.what());
+			}
+
+			// Quarantined and failed clients are skipped by update() until their retry is due
+			if (c->isAvailable())
+				n_available++;
+			else
+				gateway_opcua_status = c->getStatus();
 		}
 
-		// Exit if error happened and quit_on_error is true
-		if (gateway_opcua_status != UA_STATUSCODE_GOOD && quit_on_error || gateway_opcua_clients.size() == 0 && quit_on_error)
+		// Exit only if no server is available anymore and quit_on_error is true
+		if (n_available == 0 && quit_on_error)
 			break;
 
+		// Report metrics periodically
+		if (metrics_interval > 0.0 && UA_DateTime_now() >= metrics_report_at)
+		{
+			for (OPCUA_Client * c : gateway_opcua_clients)
+				c->reportMetrics();
+
+			gateway_sinks->reportMetrics();
+
+			if (gateway_history != NULL)
+				gateway_history->reportMetrics();
+
+			Metrics::instance().report();
+			metrics_report_at = UA_DateTime_now() + (UA_DateTime)(metrics_interval * UA_SEC_TO_DATETIME);
+		}
+
 		// Sleep for a bit, just to keep the OS sane
 		std::this_thread::sleep_for(std::chrono::milliseconds(1));
 	}
 
+	// Cleanup background REST registration, pending tasks refer to the clients
+	delete gateway_http_registrar;
+
+	// Cleanup the sinks, pending variables are written out for up to drainTimeout ms each
+	delete gateway_sinks;
+
 	// Cleanup OPC UA clients
 	for (OPCUA_Client * c : gateway_opcua_clients)
 	{
 		delete c;
 	}
 
+	// Cleanup the local history, pending samples are written out
+	delete gateway_history;
+
 	// Cleanup HTTP client
 	delete gateway_http_client;
 
@@ -0,0 +1,178 @@
+#include "opcua_aggregator.h"
+#include <algorithm>
+#include <limits>
+#include "../util/metrics.h"
+
+namespace gateway
+{
+
+	const uint32_t OPCUA_Aggregator::npos;
+
+	OPCUA_Aggregator::OPCUA_Aggregator(
+		double delay
+	) :
+		m_delay((UA_DateTime)(delay * UA_MSEC_TO_DATETIME)),
+		m_nextExpiry(std::numeric_limits<UA_DateTime>::max()),
+		m_newestTime(std::numeric_limits<UA_DateTime>::min()),
+		m_newestAt(0),
+		m_handles(),
+		m_windows(),
+		m_starts(),
+		m_closedUntil(),
+		m_lastTimes(),
+		m_mins(),
+		m_maxs(),
+		m_sums(),
+		m_lasts(),
+		m_counts(),
+		m_closed(),
+		m_samples(0),
+		m_rows(0),
+		m_late(0)
+	{
+
+	}
+
+	uint32_t OPCUA_Aggregator::add(uint32_t handle, double window)
+	{
+		uint32_t slot = (uint32_t) m_handles.size();
+
+		m_handles.emplace() = handle;
+		m_windows.emplace() = std::max<UA_DateTime>(1, (UA_DateTime)(window * UA_MSEC_TO_DATETIME));
+		m_starts.emplace() = 0;
+		m_closedUntil.emplace() = std::numeric_limits<UA_DateTime>::min();
+		m_lastTimes.emplace() = 0;
+		m_mins.emplace() = 0.0;
+		m_maxs.emplace() = 0.0;
+		m_sums.emplace() = 0.0;
+		m_lasts.emplace() = 0.0;
+		m_counts.emplace() = 0;
+
+		return slot;
+	}
+
+	bool OPCUA_Aggregator::push(uint32_t slot, UA_DateTime time, double value)
+	{
+		UA_DateTime window = m_windows[slot];
+		UA_DateTime start = time - time % window;
+		if (time % window < 0)
+			start -= window;
+
+		m_samples++;
+
+		// expire() stamps it with the gateway time
+		if (time > m_newestTime)
+		{
+			m_newestTime = time;
+			m_newestAt = 0;
+		}
+
+		// Only the newest window is open, older ones have been sent
+		if (start < m_closedUntil[slot] || (m_counts[slot] > 0 && start < m_starts[slot]))
+		{
+			m_late++;
+			return false;
+		}
+
+		if (m_counts[slot] > 0 && start > m_starts[slot])
+			close(slot);
+
+		if (m_counts[slot] == 0)
+		{
+			m_starts[slot] = start;
+			m_mins[slot] = value;
+			m_maxs[slot] = value;
+			m_sums[slot] = value;
+			m_lasts[slot] = value;
+			m_lastTimes[slot] = time;
+			m_counts[slot] = 1;
+			m_nextExpiry = std::min(m_nextExpiry, start + window);
+			return true;
+		}
+
+		m_mins[slot] = std::min(m_mins[slot], value);
+		m_maxs[slot] = std::max(m_maxs[slot], value);
+		m_sums[slot] += value;
+		m_counts[slot]++;
+
+		if (time >= m_lastTimes[slot])
+		{
+			m_lasts[slot] = value;
+			m_lastTimes[slot] = time;
+		}
+
+		return true;
+	}
+
+	void OPCUA_Aggregator::close(uint32_t slot)
+	{
+		m_closed.push_back({ m_handles[slot], m_starts[slot], m_windows[slot], m_mins[slot], m_maxs[slot], m_sums[slot], m_lasts[slot], m_counts[slot] });
+		m_closedUntil[slot] = m_starts[slot] + m_windows[slot];
+		m_counts[slot] = 0;
+		m_rows++;
+	}
+
+	void OPCUA_Aggregator::expire(UA_DateTime now)
+	{
+		if (m_nextExpiry == std::numeric_limits<UA_DateTime>::max())
+			return;
+
+		// Source time now, the newest sample time plus the gateway time since it arrived. It keeps
+		// the offset between the clocks of the server and the gateway out of the delay
+		if (m_newestAt == 0)
+			m_newestAt = now;
+		UA_DateTime sourceNow = m_newestTime + (now - m_newestAt);
+
+		// Nothing is due before the earliest open window ends, the slots are only scanned then
+		if (sourceNow < m_nextExpiry + m_delay)
+			return;
+
+		UA_DateTime next = std::numeric_limits<UA_DateTime>::max();
+
+		for (uint32_t slot = 0; slot < (uint32_t) m_handles.size(); slot++)
+		{
+			if (m_counts[slot] == 0)
+				continue;
+
+			UA_DateTime end = m_starts[slot] + m_windows[slot];
+			if (sourceNow >= end + m_delay)
+				close(slot);
+			else
+				next = std::min(next, end);
+		}
+
+		m_nextExpiry = next;
+	}
+
+	std::vector<OPCUA_AggregateRow_t> & OPCUA_Aggregator::getClosed()
+	{
+		return m_closed;
+	}
+
+	size_t OPCUA_Aggregator::size() const
+	{
+		return m_handles.size();
+	}
+
+	size_t OPCUA_Aggregator::getMemoryUsage() const
+	{
+		return m_handles.getMemoryUsage() + m_windows.getMemoryUsage() + m_starts.getMemoryUsage() + m_closedUntil.getMemoryUsage() +
+			m_lastTimes.getMemoryUsage() + m_mins.getMemoryUsage() + m_maxs.getMemoryUsage() + m_sums.getMemoryUsage() +
+			m_lasts.getMemoryUsage() + m_counts.getMemoryUsage() + m_closed.capacity() * sizeof(OPCUA_AggregateRow_t);
+	}
+
+	void OPCUA_Aggregator::reportMetrics(int32_t serverId)
+	{
+		Metrics::instance().add(metricname("opcua", serverId, "aggregate_samples"), (double) m_samples);
+		Metrics::instance().add(metricname("opcua", serverId, "aggregate_rows"), (double) m_rows);
+		Metrics::instance().add(metricname("opcua", serverId, "aggregate_late"), (double) m_late);
+		Metrics::instance().set(metricname("opcua", serverId, "aggregate_ratio"), (m_rows > 0) ? (double) m_samples / m_rows : 0.0);
+		Metrics::instance().set(metricname("opcua", serverId, "aggregate_tags"), (double) m_handles.size());
+		Metrics::instance().set(metricname("opcua", serverId, "aggregate_bytes"), (double) getMemoryUsage());
+
+		m_samples = 0;
+		m_rows = 0;
+		m_late = 0;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,72 @@
+#ifndef AGGREGATOR_H
+#define AGGREGATOR_H
+
+#include <cstdint>
+#include <vector>
+#include <open62541.h>
+#include "opcua_tagstore.h"
+
+namespace gateway
+{
+
+	// One closed window of a tag, avg is sum / count
+	struct OPCUA_AggregateRow_t
+	{
+		uint32_t handle;
+		UA_DateTime start;
+		UA_DateTime window;
+		double min;
+		double max;
+		double sum;
+		double last;
+		uint32_t count;
+	};
+
+	// Windowed min / max / avg / count / last of the numeric tags that have an
+	// aggregation window. Each aggregated tag owns a slot of fixed size state
+	// in structure-of-arrays form. Windows are aligned to multiples of their
+	// length since 1601, which are UTC minute, hour and day boundaries too.
+	// A window closes once a sample of a later window arrives or delay ms
+	// after its end, samples of a closed window are dropped as late. Window
+	// ends are in source time, so expire() follows the source clock from the
+	// newest sample time seen on, not the clock of the gateway.
+	// Closed windows wait in getClosed() until the caller sends them.
+	class OPCUA_Aggregator
+	{
+	public:
+		OPCUA_Aggregator(
+			double delay
+		);
+		uint32_t add(uint32_t handle, double window);
+		bool push(uint32_t slot, UA_DateTime time, double value);
+		void expire(UA_DateTime now);
+		std::vector<OPCUA_AggregateRow_t> & getClosed();
+		size_t size() const;
+		size_t getMemoryUsage() const;
+		void reportMetrics(int32_t serverId);
+		static const uint32_t npos = 0xFFFFFFFF;
+	private:
+		void close(uint32_t slot);
+		UA_DateTime m_delay;
+		UA_DateTime m_nextExpiry;
+		UA_DateTime m_newestTime;
+		UA_DateTime m_newestAt;
+		OPCUA_Column<uint32_t> m_handles;
+		OPCUA_Column<UA_DateTime> m_windows;
+		OPCUA_Column<UA_DateTime> m_starts;
+		OPCUA_Column<UA_DateTime> m_closedUntil;
+		OPCUA_Column<UA_DateTime> m_lastTimes;
+		OPCUA_Column<double> m_mins;
+		OPCUA_Column<double> m_maxs;
+		OPCUA_Column<double> m_sums;
+		OPCUA_Column<double> m_lasts;
+		OPCUA_Column<uint32_t> m_counts;
+		std::vector<OPCUA_AggregateRow_t> m_closed;
+		uint64_t m_samples;
+		uint64_t m_rows;
+		uint64_t m_late;
+	};
+
+}
+
+#endif // AGGREGATOR_H
\ No newline at end of file
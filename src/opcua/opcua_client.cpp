@@ -1,10 +1,25 @@
 #include "opcua_client.h"
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
 #include <open62541.h>
 #include "../macros.h"
 #include "opcua_subscription.h"
+#include "opcua_group.h"
+#include "opcua_poller.h"
+#include "opcua_session.h"
+#include "opcua_tuner.h"
+#include "opcua_nodetable.h"
+#include "opcua_tagstore.h"
+#include "opcua_aggregator.h"
+#include "opcua_compressor.h"
 #include "../http/http_client.h"
+#include "../http/http_registrar.h"
+#include "../sink/sink_fanout.h"
+#include "../util/metrics.h"
+#include "../util/arena.h"
 #include "../3rdparty/json.hpp"
 
 // For convenience
@@ -27,9 +42,8 @@ namespace gateway
 		// Get the client instance
 		OPCUA_Client * client = (OPCUA_Client *)handle;
 
-		// Create a new subscription instance
-		OPCUA_Subscription * sub = new OPCUA_Subscription(client, &childId);
-		client->getSubscriptions().push_back(sub);
+		// Add a tag for the node
+		OPCUA_Subscription_Create(client, childId, client->getBrowseGroup());
 
 		return client->getStatus();
 	}
@@ -38,14 +52,21 @@ namespace gateway
 		const std::string & jsonConfig,
 		const std::string & jsonDbServersConfig,
 		const std::string & jsonDbSubscriptionsConfig,
-		HTTP_Client * const httpClient
+		HTTP_Client * const httpClient,
+		HTTP_Registrar * const httpRegistrar,
+		SINK_Fanout * const sinks,
+		STORE_TimeSeries * const history
 	) :
 		m_jsonConfig(jsonConfig),
 		m_jsonDbServersConfig(jsonDbServersConfig),
 		m_jsonDbSubscriptionsConfig(jsonDbSubscriptionsConfig),
 		m_client(NULL),
 		m_status(UA_STATUSCODE_GOOD),
+		m_state(OPCUA_RECONNECTING),
 		m_httpClient(httpClient),
+		m_httpRegistrar(httpRegistrar),
+		m_sinks(sinks),
+		m_history(history),
 		m_serverId(0),
 		m_endpoint("null"),
 		m_username(""),
@@ -56,7 +77,35 @@ namespace gateway
 		m_subMaxNotificationsPerPublish(10),
 		m_subPublishEnabled(true),
 		m_subPublishPriority(1),
-		m_subscriptions()
+		m_arrayEncoding(OPCUA_ARRAY_TEXT),
+		m_reconnectMinDelay(500.0),
+		m_reconnectMaxDelay(30000.0),
+		m_reconnectMaxAttempts(0),
+		m_quarantineTime(60000.0),
+		m_initialized(false),
+		m_reconnectAttempts(0),
+		m_reconnectCount(0),
+		m_reconnectAt(0),
+		m_connector(),
+		m_connecting(false),
+		m_recovering(false),
+		m_disconnectedAt(0),
+		m_lastRecoveryTime(0.0),
+		m_updatedAt(0),
+		m_availableTime(0.0),
+		m_unavailableTime(0.0),
+		m_random(std::random_device()()),
+		m_groups(),
+		m_browseGroup(NULL),
+		m_poller(NULL),
+		m_nodeTable(NULL),
+		m_sessions(),
+		m_tuner(NULL),
+		m_tunedAt(0),
+		m_tags(NULL),
+		m_aggregator(NULL),
+		m_compressor(NULL),
+		m_arena(NULL)
 	{
 		// Get config strings as JSON objects
 		json jsonCfg = json::parse(m_jsonConfig);
@@ -74,58 +123,95 @@ namespace gateway
 		m_subMaxNotificationsPerPublish = jsonCfg["subMaxNotificationsPerPublish"].get<uint32_t>();
 		m_subPublishEnabled = jsonCfg["subPublishEnabled"].get<bool>();
 		m_subPublishPriority = jsonCfg["subPublishPriority"].get<uint8_t>();
+		m_arrayEncoding = (jsonCfg.value("arrayEncoding", std::string("text")) == "binary") ? OPCUA_ARRAY_BINARY : OPCUA_ARRAY_TEXT;
+		m_reconnectMinDelay = jsonCfg.value("reconnectMinDelay", m_reconnectMinDelay);
+		m_reconnectMaxDelay = jsonCfg.value("reconnectMaxDelay", m_reconnectMaxDelay);
+		m_reconnectMaxAttempts = jsonCfg.value("reconnectMaxAttempts", m_reconnectMaxAttempts);
+		m_quarantineTime = jsonCfg.value("quarantineTime", m_quarantineTime);
+		uint32_t sessionCount = std::max(jsonCfg.value("sessions", 1u), 1u);
 
-		// Create UA_Client instance
-		m_client = UA_Client_new(UA_ClientConfig_standard);
+		// Fetch subscription groups
+		for (const json & jsonGroup : jsonCfg["subscriptions"])
+			m_groups.push_back(new OPCUA_Group(jsonGroup));
 
-		// Attempt to connect the client based on given configuration
-		if (m_username.empty())
-			m_status = UA_Client_connect(m_client, m_endpoint.c_str());
-		else
-			m_status = UA_Client_connect_username(m_client, m_endpoint.c_str(), m_username.c_str(), m_password.c_str());
+		// NodeIds of all subscriptions, referred to by handle
+		m_nodeTable = new OPCUA_NodeTable();
 
-		// Throw if connection attempt failed
-		if (m_status != UA_STATUSCODE_GOOD)
-			throw std::exception("OPCUA_Client failed to connect to target endpoint.");
+		// Records of a tag held back while its REST registration is pending, the oldest are dropped beyond heldBackLimit
+		m_tags = new OPCUA_TagStore(jsonCfg.value("heldBackLimit", (size_t) 1024));
 
-		LOG("OPCUA_Client serverId(%d) connected successfully to %s\n", UA_DateTime_now(), m_serverId, m_endpoint.c_str());
+		// Window state of the aggregated tags, a window is sent at the latest aggregateDelay ms after its end
+		m_aggregator = new OPCUA_Aggregator(jsonCfg.value("aggregateDelay", 1000.0));
 
-		// GET target serverId from REST
-		json jsonDbServer = m_httpClient->getJSON("/opcuaservers/" + std::to_string(m_serverId));
+		// Swinging door state of the compressed tags
+		m_compressor = new OPCUA_Compressor();
 
-		// POST or PUT server config to REST
-		HTTP_Request_t http_req = (jsonDbServer.type() == json::value_t::array) ? HTTP_PUT : HTTP_POST;
-		m_httpClient->sendJSON("/opcuaservers", http_req, jsonCfg);
+		// Temporaries of one publish or read response, reset once the response is handed off
+		m_arena = new Arena();
 
-		LOG("OPCUA_Client serverId(%d) %s to REST.\n", UA_DateTime_now(), m_serverId, (http_req == HTTP_POST) ? "HTTP_POST" : "HTTP_PUT");
+		// Reads the nodes of polled groups on a thread and connection of its own
+		m_poller = new OPCUA_Poller(this);
 
-		// Subscribe to all namespaces / nodes described in config
-		size_t n_subscriptions = jsonCfg["subscriptions"].size();
-		for (size_t i = 0; i < n_subscriptions; i++)
+		// Create UA_Client instance, used for browsing and reading
+		m_client = UA_Client_new(UA_ClientConfig_standard);
+
+		// Adjusts the subscription of every session to the measured load
+		OPCUA_Tuning_t tuning = { m_subPublishInterval, m_subMaxNotificationsPerPublish };
+		m_tuner = new OPCUA_Tuner(jsonCfg.value("tuning", json::object()), tuning, m_subMaxKeepAliveCount, (double) UA_ClientConfig_standard.timeout);
+
+		// Monitored items are sharded across data sessions with a connection each
+		for (uint32_t i = 0; i < sessionCount; i++)
+			m_sessions.push_back(new OPCUA_Session(this, i));
+
+		// GET / POST or PUT server config to REST in the background
+		int32_t serverId = m_serverId;
+		m_httpRegistrar->push([jsonCfg, serverId](HTTP_Client * const httpClient) mutable
 		{
-			bool isFolder = jsonCfg["subscriptions"][i]["isFolder"].get<bool>();
-			uint16_t nsIndex = jsonCfg["subscriptions"][i]["nsIndex"].get<uint16_t>();
+			// GET target serverId from REST
+			json jsonDbServer = httpClient->getJSON("/opcuaservers/" + std::to_string(serverId));
 
-			size_t n_identifiers = jsonCfg["subscriptions"][i]["identifiers"].size();
-			for (size_t j = 0; j < n_identifiers; j++)
+			// POST or PUT server config to REST
+			HTTP_Request_t http_req = (jsonDbServer.type() == json::value_t::array) ? HTTP_PUT : HTTP_POST;
+			if (httpClient->sendJSON("/opcuaservers", http_req, jsonCfg) == false)
 			{
-				std::string identifier = jsonCfg["subscriptions"][i]["identifiers"][j].get<std::string>();
-				if (isFolder == false)
-					subscribeToOne(nsIndex, &identifier[0u]);
-				else
-					subscribeToAll(nsIndex, &identifier[0u]);
+				WRN("OPCUA_Client serverId(%d) %s to REST failed.\n", UA_DateTime_now(), serverId, (http_req == HTTP_POST) ? "HTTP_POST" : "HTTP_PUT");
+				return false;
 			}
-		}
 
-		LOG("OPCUA_Client serverId(%d) initialized successfully.\n", UA_DateTime_now(), m_serverId);
+			LOG("OPCUA_Client serverId(%d) %s to REST.\n", UA_DateTime_now(), serverId, (http_req == HTTP_POST) ? "HTTP_POST" : "HTTP_PUT");
+			return true;
+		});
+
+		// The first connect runs on the connector thread like every reconnect, an unreachable server must not stall the others
+		m_disconnectedAt = UA_DateTime_now();
+		m_reconnectAt = m_disconnectedAt;
+
+		LOG("OPCUA_Client serverId(%d) connecting to %s with %u sessions in background\n", UA_DateTime_now(), m_serverId, m_endpoint.c_str(), sessionCount);
 	}
 
 	OPCUA_Client::~OPCUA_Client()
 	{
+		// A connect attempt in progress uses the sessions and tags
+		if (m_connector.joinable())
+			m_connector.join();
+
 		if (m_client != NULL)
 		{
-			for (OPCUA_Subscription * sub : m_subscriptions)
-				delete sub;
+			// Stops the publish and poll threads before the tags they dispatch to go away
+			for (OPCUA_Session * session : m_sessions)
+				delete session;
+
+			DELETES(m_poller);
+
+			for (OPCUA_Group * group : m_groups)
+				delete group;
+
+			DELETES(m_tuner);
+			DELETES(m_nodeTable);
+			DELETES(m_tags);
+			DELETES(m_aggregator);
+			DELETES(m_compressor);
+			DELETES(m_arena);
 
 			UA_Client_disconnect(m_client);
 			UA_Client_delete(m_client);
@@ -140,24 +226,387 @@ namespace gateway
 
 	void OPCUA_Client::update()
 	{
-		UA_Client_Subscriptions_manuallySendPublishRequest(m_client);
+		UA_DateTime now = UA_DateTime_now();
+
+		// Availability bookkeeping, time since the previous update counts for the current state
+		if (m_updatedAt != 0)
+		{
+			if (m_state == OPCUA_CONNECTED)
+				m_availableTime += (double)(now - m_updatedAt) / UA_MSEC_TO_DATETIME;
+			else
+				m_unavailableTime += (double)(now - m_updatedAt) / UA_MSEC_TO_DATETIME;
+		}
+		m_updatedAt = now;
+
+		// A connect attempt owns the UA clients and the tag store until it is done
+		if (m_connecting)
+			return;
+
+		// Send the aggregation windows that ended without a later sample, also while disconnected
+		m_aggregator->expire(now);
+		if (m_aggregator->getClosed().empty() == false)
+		{
+			OPCUA_Callback_Aggregates(this);
+			m_arena->reset();
+		}
+
+		// Archive the points of compressed tags that stopped changing for maxInterval
+		m_compressor->expire(now);
+		if (m_compressor->getArchived().empty() == false)
+		{
+			OPCUA_Callback_Compressed(this);
+			m_arena->reset();
+		}
+
+		// Try to restore the session, publish only while connected
+		if (m_state != OPCUA_CONNECTED)
+		{
+			reconnect();
+			return;
+		}
+
+		// Hand the notifications received by the session threads to the callbacks
+		for (OPCUA_Session * session : m_sessions)
+		{
+			if ((m_status = session->dispatch()) != UA_STATUSCODE_GOOD)
+			{
+				disconnected();
+				return;
+			}
+		}
+
+		// Adjust the subscriptions to the load measured since the previous evaluation
+		if (m_tuner->isEnabled() && now >= m_tunedAt + (UA_DateTime)(m_tuner->getPeriod() * UA_MSEC_TO_DATETIME))
+		{
+			if (m_tunedAt != 0)
+			{
+				for (OPCUA_Session * session : m_sessions)
+				{
+					if (session->isRunning())
+						session->tune(*m_tuner);
+				}
+			}
+
+			m_tunedAt = now;
+		}
+
+		// Hand the values read by the poll thread to the callbacks
+		if ((m_status = m_poller->dispatch()) != UA_STATUSCODE_GOOD)
+		{
+			disconnected();
+			return;
+		}
+
+		// Release variables held back until their subscription got registered to REST, in arrival order
+		std::unordered_map<uint32_t, std::deque<OPCUA_HeldBack_t>> & heldBack = m_tags->getHeldBack();
+		for (auto it = heldBack.begin(); it != heldBack.end();)
+		{
+			if (m_tags->isRegistered(it->first) == false)
+			{
+				++it;
+				continue;
+			}
+
+			// The held back items still refer to the payloads of their batches, release them per path and format
+			std::vector<const char *> paths;
+			for (const OPCUA_HeldBack_t & held : it->second)
+			{
+				if (std::none_of(paths.begin(), paths.end(), [&held](const char * path) { return strcmp(path, held.path) == 0; }))
+					paths.push_back(held.path);
+			}
+
+			for (const char * path : paths)
+			{
+				for (int f = 0; f < SINK_FORMAT_COUNT; f++)
+				{
+					std::vector<SINK_Item_t> items;
+					for (const OPCUA_HeldBack_t & held : it->second)
+					{
+						if (held.format == (SINK_Format_t) f && strcmp(held.path, path) == 0)
+							items.push_back(held.item);
+					}
+
+					if (items.empty() == false)
+						m_sinks->push(path, (SINK_Format_t) f, items.data(), items.size());
+				}
+			}
+
+			it = heldBack.erase(it);
+		}
 	}
 
-	void OPCUA_Client::subscribeToAll(uint16_t nsIndex, char * identifier)
+	void OPCUA_Client::reportMetrics()
 	{
+		double total = m_availableTime + m_unavailableTime;
+
+		Metrics::instance().set(metricname("opcua", m_serverId, "available_ms"), m_availableTime);
+		Metrics::instance().set(metricname("opcua", m_serverId, "unavailable_ms"), m_unavailableTime);
+		Metrics::instance().set(metricname("opcua", m_serverId, "availability"), (total > 0.0) ? m_availableTime / total : 1.0);
+		Metrics::instance().set(metricname("opcua", m_serverId, "state"), (double) m_state);
+		Metrics::instance().set(metricname("opcua", m_serverId, "arena_bytes"), (double) m_arena->getCapacity());
+		Metrics::instance().set(metricname("opcua", m_serverId, "arena_blocks"), (double) m_arena->getBlockAllocations());
+
+		// The tag store, node table, aggregator and compressor grow while the first connect browses, their counters wait for the next report
+		if (m_connecting)
+			return;
+
+		Metrics::instance().set(metricname("opcua", m_serverId, "nodetable_bytes"), (double) m_nodeTable->getMemoryUsage());
+		Metrics::instance().set(metricname("opcua", m_serverId, "tagstore_bytes"), (double) m_tags->getMemoryUsage());
+		Metrics::instance().set(metricname("opcua", m_serverId, "bytes_per_tag"), (m_tags->size() > 0) ? (double)(m_tags->getMemoryUsage() + m_nodeTable->getMemoryUsage()) / m_tags->size() : 0.0);
+
+		m_tags->reportMetrics(m_serverId);
+		m_aggregator->reportMetrics(m_serverId);
+		m_compressor->reportMetrics(m_serverId);
+	}
+
+	void OPCUA_Client::subscribeToAll(uint16_t nsIndex, char * identifier, OPCUA_Group * group)
+	{
+		size_t first = m_tags->size();
+
+		m_browseGroup = group;
 		m_status = UA_Client_forEachChildNodeCall(m_client, UA_NODEID_STRING(nsIndex, identifier), &OPCUA_Callback_NodeIterator, (void *) this);
+		m_browseGroup = NULL;
+
+		// Link all found nodes in bulk
+		if (m_status == UA_STATUSCODE_GOOD)
+			m_status = createMonitoredItems(first);
+
+		if (m_status == UA_STATUSCODE_GOOD)
+			m_status = m_poller->add(first);
+
+		if (m_initialized)
+			startSessions();
 
 		LOG("OPCUA_Client serverId(%d) subscribeToAll %d: %s\n", UA_DateTime_now(), m_serverId, nsIndex, identifier);
 	}
 
-	void OPCUA_Client::subscribeToOne(uint16_t nsIndex, char * identifier)
+	void OPCUA_Client::subscribeToOne(uint16_t nsIndex, char * identifier, OPCUA_Group * group)
 	{
-		OPCUA_Subscription * sub = new OPCUA_Subscription(this, &UA_NODEID_STRING(nsIndex, identifier));
-		m_subscriptions.push_back(sub);
+		size_t first = m_tags->size();
+
+		OPCUA_Subscription_Create(this, UA_NODEID_STRING(nsIndex, identifier), group);
+
+		m_status = createMonitoredItems(first);
+
+		if (m_status == UA_STATUSCODE_GOOD)
+			m_status = m_poller->add(first);
+
+		if (m_initialized)
+			startSessions();
 
 		LOG("OPCUA_Client serverId(%d) subscribeToOne %d: %s\n", UA_DateTime_now(), m_serverId, nsIndex, identifier);
 	}
 
+	void OPCUA_Client::initialize()
+	{
+		// Subscribe to all namespaces / nodes described in config
+		for (OPCUA_Group * group : m_groups)
+		{
+			for (std::string identifier : group->getIdentifiers())
+			{
+				if (group->isFolder() == false)
+					subscribeToOne(group->getNsIndex(), &identifier[0u], group);
+				else
+					subscribeToAll(group->getNsIndex(), &identifier[0u], group);
+			}
+		}
+
+		m_initialized = true;
+
+		LOG("OPCUA_Client serverId(%d) initialized successfully.\n", UA_DateTime_now(), m_serverId);
+	}
+
+	UA_StatusCode OPCUA_Client::connect()
+	{
+		UA_StatusCode status = connect(m_client);
+
+		// Each data session gets its own UA_Subscription
+		for (size_t i = 0; i < m_sessions.size() && status == UA_STATUSCODE_GOOD; i++)
+		{
+			status = m_sessions[i]->connect();
+
+			if (status == UA_STATUSCODE_GOOD)
+				status = m_sessions[i]->createSubscription();
+		}
+
+		return status;
+	}
+
+	UA_StatusCode OPCUA_Client::connect(UA_Client * client)
+	{
+		if (m_username.empty())
+			return UA_Client_connect(client, m_endpoint.c_str());
+		else
+			return UA_Client_connect_username(client, m_endpoint.c_str(), m_username.c_str(), m_password.c_str());
+	}
+
+	UA_StatusCode OPCUA_Client::createMonitoredItems(size_t first)
+	{
+		std::vector<std::vector<uint32_t>> shards(m_sessions.size());
+
+		// Shard by NodeId hash so a node lands on the same session across restarts, polled nodes are read by m_poller instead
+		for (uint32_t i = (uint32_t) first; i < m_tags->size(); i++)
+		{
+			OPCUA_Group * group = m_tags->getGroup(i);
+
+			if (group == NULL || group->isPolled() == false)
+				shards[m_nodeTable->getHash(m_tags->getNode(i)) % shards.size()].push_back(i);
+		}
+
+		for (size_t i = 0; i < m_sessions.size(); i++)
+		{
+			if (shards[i].empty())
+				continue;
+
+			UA_StatusCode status = m_sessions[i]->add(shards[i]);
+
+			if (status != UA_STATUSCODE_GOOD)
+				return status;
+		}
+
+		return UA_STATUSCODE_GOOD;
+	}
+
+	void OPCUA_Client::startSessions()
+	{
+		// Sessions without monitored items do not start publishing, nor does the poller without polled items
+		for (OPCUA_Session * session : m_sessions)
+			session->start();
+
+		m_poller->start();
+	}
+
+	void OPCUA_Client::disconnected()
+	{
+		m_state = OPCUA_RECONNECTING;
+		m_disconnectedAt = UA_DateTime_now();
+		m_reconnectAt = m_disconnectedAt;
+		m_reconnectAttempts = 0;
+
+		for (OPCUA_Session * session : m_sessions)
+			session->stop();
+
+		m_poller->stop();
+
+		Metrics::instance().add(metricname("opcua", m_serverId, "disconnects"));
+
+		ERR("OPCUA_Client serverId(%d) lost connection to %s, status: 0x%08x\n", UA_DateTime_now(), m_serverId, m_endpoint.c_str(), m_status);
+	}
+
+	void OPCUA_Client::reconnect()
+	{
+		// The outcome of a finished attempt is handled on the main thread
+		if (m_connector.joinable())
+		{
+			m_connector.join();
+			reconnected();
+			return;
+		}
+
+		UA_DateTime now = UA_DateTime_now();
+
+		if (m_state == OPCUA_FAILED || now < m_reconnectAt)
+			return;
+
+		// Quarantine is over, start a fresh round of attempts
+		if (m_state == OPCUA_QUARANTINED)
+		{
+			m_state = OPCUA_RECONNECTING;
+			m_reconnectAttempts = 0;
+
+			LOG("OPCUA_Client serverId(%d) left quarantine, reconnecting to %s\n", UA_DateTime_now(), m_serverId, m_endpoint.c_str());
+		}
+
+		m_reconnectAttempts++;
+
+		// Connect timeouts of an unreachable server only block the connector thread
+		m_recovering = m_initialized;
+		m_connecting = true;
+		m_connector = std::thread(&OPCUA_Client::attempt, this);
+	}
+
+	void OPCUA_Client::attempt()
+	{
+		// Drop the old sessions and secure channels, then restore everything in bulk
+		UA_Client_reset(m_client);
+
+		for (OPCUA_Session * session : m_sessions)
+			session->reset();
+
+		m_poller->reset();
+
+		m_status = connect();
+
+		// Browse the configured nodes on the first connect, restore them afterwards
+		if (m_status == UA_STATUSCODE_GOOD && m_initialized == false)
+		{
+			initialize();
+		}
+		else if (m_status == UA_STATUSCODE_GOOD)
+		{
+			for (size_t i = 0; i < m_sessions.size() && m_status == UA_STATUSCODE_GOOD; i++)
+				m_status = m_sessions[i]->relink();
+
+			// Registered NodeIds are only valid within the session that registered them, the poller connects its own again
+			if (m_status == UA_STATUSCODE_GOOD)
+				m_status = m_poller->registerNodes();
+		}
+
+		m_connecting = false;
+	}
+
+	void OPCUA_Client::reconnected()
+	{
+		if (m_status == UA_STATUSCODE_GOOD)
+		{
+			startSessions();
+
+			m_state = OPCUA_CONNECTED;
+
+			if (m_recovering == false)
+			{
+				LOG("OPCUA_Client serverId(%d) connected successfully to %s with %u sessions after %u attempts\n", UA_DateTime_now(), m_serverId, m_endpoint.c_str(), (unsigned int) m_sessions.size(), m_reconnectAttempts);
+				return;
+			}
+
+			m_lastRecoveryTime = (double)(UA_DateTime_now() - m_disconnectedAt) / UA_MSEC_TO_DATETIME;
+			m_reconnectCount++;
+
+			Metrics::instance().add(metricname("opcua", m_serverId, "reconnects"));
+			Metrics::instance().set(metricname("opcua", m_serverId, "recovery_ms"), m_lastRecoveryTime);
+
+			LOG("OPCUA_Client serverId(%d) reconnected to %s after %u attempts, recovered %u items in %.0f ms\n", UA_DateTime_now(), m_serverId, m_endpoint.c_str(), m_reconnectAttempts, (unsigned int) m_tags->size(), m_lastRecoveryTime);
+			return;
+		}
+
+		// Quarantine once the configured amount of attempts is used, or give up for good without quarantine
+		if (m_reconnectMaxAttempts > 0 && m_reconnectAttempts >= m_reconnectMaxAttempts)
+		{
+			if (m_quarantineTime <= 0.0)
+			{
+				m_state = OPCUA_FAILED;
+
+				ERR("OPCUA_Client serverId(%d) gave up reconnecting to %s after %u attempts\n", UA_DateTime_now(), m_serverId, m_endpoint.c_str(), m_reconnectAttempts);
+				return;
+			}
+
+			m_state = OPCUA_QUARANTINED;
+			m_reconnectAt = UA_DateTime_now() + (UA_DateTime)(m_quarantineTime * UA_MSEC_TO_DATETIME);
+
+			Metrics::instance().add(metricname("opcua", m_serverId, "quarantines"));
+
+			ERR("OPCUA_Client serverId(%d) quarantined for %.0f ms after %u failed attempts\n", UA_DateTime_now(), m_serverId, m_quarantineTime, m_reconnectAttempts);
+			return;
+		}
+
+		// Exponential backoff with jitter, so many gateways do not reconnect in lockstep
+		double delay = std::min(m_reconnectMaxDelay, m_reconnectMinDelay * std::pow(2.0, (double) std::min(m_reconnectAttempts - 1, 16u)));
+		delay = std::uniform_real_distribution<double>(delay * 0.5, delay)(m_random);
+		m_reconnectAt = UA_DateTime_now() + (UA_DateTime)(delay * UA_MSEC_TO_DATETIME);
+
+		WRN("OPCUA_Client serverId(%d) reconnect attempt %u failed, status: 0x%08x, retry in %.0f ms\n", UA_DateTime_now(), m_serverId, m_reconnectAttempts, m_status, delay);
+	}
+
 	std::string OPCUA_Client::getJsonConfig() const
 	{
 		return m_jsonConfig;
@@ -183,11 +632,31 @@ namespace gateway
 		return m_status;
 	}
 
+	OPCUA_State_t OPCUA_Client::getState() const
+	{
+		return m_state;
+	}
+
 	HTTP_Client * OPCUA_Client::getHttpClient()
 	{
 		return m_httpClient;
 	}
 
+	HTTP_Registrar * OPCUA_Client::getHttpRegistrar()
+	{
+		return m_httpRegistrar;
+	}
+
+	SINK_Fanout * OPCUA_Client::getSinks()
+	{
+		return m_sinks;
+	}
+
+	STORE_TimeSeries * OPCUA_Client::getHistory()
+	{
+		return m_history;
+	}
+
 	int32_t OPCUA_Client::getServerId() const
 	{
 		return m_serverId;
@@ -238,9 +707,65 @@ namespace gateway
 		return m_subPublishPriority;
 	}
 
-	std::vector<OPCUA_Subscription *> & OPCUA_Client::getSubscriptions()
+	OPCUA_ArrayEncoding_t OPCUA_Client::getArrayEncoding() const
+	{
+		return m_arrayEncoding;
+	}
+
+	size_t OPCUA_Client::getSessionCount() const
+	{
+		return m_sessions.size();
+	}
+
+	uint32_t OPCUA_Client::getReconnectCount() const
+	{
+		return m_reconnectCount;
+	}
+
+	double OPCUA_Client::getLastRecoveryTime() const
+	{
+		return m_lastRecoveryTime;
+	}
+
+	bool OPCUA_Client::isAvailable() const
+	{
+		return m_state == OPCUA_CONNECTED || m_state == OPCUA_RECONNECTING;
+	}
+
+	double OPCUA_Client::getAvailability() const
+	{
+		double total = m_availableTime + m_unavailableTime;
+		return (total > 0.0) ? m_availableTime / total : 1.0;
+	}
+
+	OPCUA_Group * OPCUA_Client::getBrowseGroup()
+	{
+		return m_browseGroup;
+	}
+
+	OPCUA_NodeTable * OPCUA_Client::getNodeTable()
+	{
+		return m_nodeTable;
+	}
+
+	Arena & OPCUA_Client::getArena()
+	{
+		return *m_arena;
+	}
+
+	OPCUA_TagStore * OPCUA_Client::getTagStore()
+	{
+		return m_tags;
+	}
+
+	OPCUA_Aggregator * OPCUA_Client::getAggregator()
+	{
+		return m_aggregator;
+	}
+
+	OPCUA_Compressor * OPCUA_Client::getCompressor()
 	{
-		return m_subscriptions;
+		return m_compressor;
 	}
 
 }
\ No newline at end of file
@@ -4,17 +4,46 @@
 #include <string>
 #include <cstdint>
 #include <vector>
+#include <random>
+#include <thread>
+#include <atomic>
 
 struct UA_Client;
 struct _UA_NodeId;
 typedef _UA_NodeId UA_NodeId;
 typedef uint32_t UA_StatusCode;
+typedef int64_t UA_DateTime;
 
 namespace gateway
 {
 
-	class OPCUA_Subscription;
+	class OPCUA_TagStore;
+	class OPCUA_Aggregator;
+	class OPCUA_Compressor;
+	class OPCUA_Group;
+	class OPCUA_Poller;
+	class OPCUA_Session;
+	class OPCUA_Tuner;
+	class OPCUA_NodeTable;
 	class HTTP_Client;
+	class HTTP_Registrar;
+	class SINK_Fanout;
+	class STORE_TimeSeries;
+	class Arena;
+
+	enum OPCUA_State_t
+	{
+		OPCUA_CONNECTED,
+		OPCUA_RECONNECTING,
+		OPCUA_QUARANTINED,
+		OPCUA_FAILED
+	};
+
+	enum OPCUA_ArrayEncoding_t
+	{
+		OPCUA_ARRAY_TEXT,
+		OPCUA_ARRAY_BINARY
+	};
 
 	class OPCUA_Client
 	{
@@ -23,18 +52,27 @@ namespace gateway
 			const std::string & jsonConfig,
 			const std::string & jsonDbServersConfig,
 			const std::string & jsonDbSubscriptionsConfig,
-			HTTP_Client * const httpClient
+			HTTP_Client * const httpClient,
+			HTTP_Registrar * const httpRegistrar,
+			SINK_Fanout * const sinks,
+			STORE_TimeSeries * const history
 		);
 		~OPCUA_Client();
 		void update();
-		void subscribeToAll(uint16_t nsIndex = 0, char * identifier = "");
-		void subscribeToOne(uint16_t nsIndex = 0, char * identifier = "");
+		void reportMetrics();
+		void subscribeToAll(uint16_t nsIndex = 0, char * identifier = "", OPCUA_Group * group = NULL);
+		void subscribeToOne(uint16_t nsIndex = 0, char * identifier = "", OPCUA_Group * group = NULL);
+		UA_StatusCode connect(UA_Client * client);
 		std::string getJsonConfig() const;
 		std::string getJsonDbServersConfig() const;
 		std::string getJsonDbSubscriptionsConfig() const;
 		UA_Client * getClient();
 		UA_StatusCode & getStatus();
+		OPCUA_State_t getState() const;
 		HTTP_Client * getHttpClient();
+		HTTP_Registrar * getHttpRegistrar();
+		SINK_Fanout * getSinks();
+		STORE_TimeSeries * getHistory();
 		int32_t getServerId() const;
 		std::string getEndpoint() const;
 		std::string getUsername() const;
@@ -45,14 +83,37 @@ namespace gateway
 		uint32_t getSubMaxNotificationsPerPublish() const;
 		bool isSubPublishEnabled() const;
 		uint8_t getSubPublishPriority() const;
-		std::vector<OPCUA_Subscription *> & getSubscriptions();
+		OPCUA_ArrayEncoding_t getArrayEncoding() const;
+		size_t getSessionCount() const;
+		uint32_t getReconnectCount() const;
+		double getLastRecoveryTime() const;
+		bool isAvailable() const;
+		double getAvailability() const;
+		OPCUA_Group * getBrowseGroup();
+		OPCUA_NodeTable * getNodeTable();
+		OPCUA_TagStore * getTagStore();
+		OPCUA_Aggregator * getAggregator();
+		OPCUA_Compressor * getCompressor();
+		Arena & getArena();
 	private:
+		void initialize();
+		UA_StatusCode connect();
+		UA_StatusCode createMonitoredItems(size_t first);
+		void startSessions();
+		void disconnected();
+		void reconnect();
+		void attempt();
+		void reconnected();
 		std::string m_jsonConfig;
 		std::string m_jsonDbServersConfig;
 		std::string m_jsonDbSubscriptionsConfig;
 		UA_Client * m_client;
 		UA_StatusCode m_status;
+		OPCUA_State_t m_state;
 		HTTP_Client * m_httpClient;
+		HTTP_Registrar * m_httpRegistrar;
+		SINK_Fanout * m_sinks;
+		STORE_TimeSeries * m_history;
 		int32_t m_serverId;
 		std::string m_endpoint;
 		std::string m_username;
@@ -63,7 +124,35 @@ namespace gateway
 		uint32_t m_subMaxNotificationsPerPublish;
 		bool m_subPublishEnabled;
 		uint8_t m_subPublishPriority;
-		std::vector<OPCUA_Subscription *> m_subscriptions;
+		OPCUA_ArrayEncoding_t m_arrayEncoding;
+		double m_reconnectMinDelay;
+		double m_reconnectMaxDelay;
+		uint32_t m_reconnectMaxAttempts;
+		double m_quarantineTime;
+		bool m_initialized;
+		uint32_t m_reconnectAttempts;
+		uint32_t m_reconnectCount;
+		UA_DateTime m_reconnectAt;
+		std::thread m_connector;
+		std::atomic<bool> m_connecting;
+		bool m_recovering;
+		UA_DateTime m_disconnectedAt;
+		double m_lastRecoveryTime;
+		UA_DateTime m_updatedAt;
+		double m_availableTime;
+		double m_unavailableTime;
+		std::mt19937 m_random;
+		std::vector<OPCUA_Group *> m_groups;
+		OPCUA_Group * m_browseGroup;
+		OPCUA_Poller * m_poller;
+		OPCUA_NodeTable * m_nodeTable;
+		std::vector<OPCUA_Session *> m_sessions;
+		OPCUA_Tuner * m_tuner;
+		UA_DateTime m_tunedAt;
+		OPCUA_TagStore * m_tags;
+		OPCUA_Aggregator * m_aggregator;
+		OPCUA_Compressor * m_compressor;
+		Arena * m_arena;
 	};
 
 }
@@ -0,0 +1,240 @@
+#include "opcua_compressor.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "../util/metrics.h"
+
+namespace gateway
+{
+
+	namespace
+	{
+
+		// Bits of the per slot state
+		const uint8_t STATE_PASSED = 1;
+		const uint8_t STATE_DROPPED = 2;
+		const uint8_t STATE_ARCHIVED = 4;
+		const uint8_t STATE_HELD = 8;
+
+	}
+
+	const uint32_t OPCUA_Compressor::npos;
+
+	OPCUA_Compressor::OPCUA_Compressor() :
+		m_expiredAt(0),
+		m_newestTime(0),
+		m_newestAt(0),
+		m_handles(),
+		m_exceptionDeviations(),
+		m_compressionDeviations(),
+		m_maxIntervals(),
+		m_states(),
+		m_passedTimes(),
+		m_passedValues(),
+		m_droppedTimes(),
+		m_droppedValues(),
+		m_archivedTimes(),
+		m_archivedValues(),
+		m_heldTimes(),
+		m_heldValues(),
+		m_upperSlopes(),
+		m_lowerSlopes(),
+		m_archived(),
+		m_samples(0),
+		m_points(0),
+		m_totalSamples(0),
+		m_totalPoints(0)
+	{
+
+	}
+
+	uint32_t OPCUA_Compressor::add(uint32_t handle, double exceptionDeviation, double compressionDeviation, double maxInterval)
+	{
+		uint32_t slot = (uint32_t) m_handles.size();
+
+		m_handles.emplace() = handle;
+		m_exceptionDeviations.emplace() = exceptionDeviation;
+		m_compressionDeviations.emplace() = std::max(compressionDeviation, 0.0);
+		m_maxIntervals.emplace() = (maxInterval > 0.0) ? (UA_DateTime)(maxInterval * UA_MSEC_TO_DATETIME) : std::numeric_limits<UA_DateTime>::max();
+		m_states.emplace() = 0;
+		m_passedTimes.emplace() = 0;
+		m_passedValues.emplace() = 0.0;
+		m_droppedTimes.emplace() = 0;
+		m_droppedValues.emplace() = 0.0;
+		m_archivedTimes.emplace() = 0;
+		m_archivedValues.emplace() = 0.0;
+		m_heldTimes.emplace() = 0;
+		m_heldValues.emplace() = 0.0;
+		m_upperSlopes.emplace() = 0.0;
+		m_lowerSlopes.emplace() = 0.0;
+
+		return slot;
+	}
+
+	void OPCUA_Compressor::push(uint32_t slot, UA_DateTime time, double value)
+	{
+		uint8_t & state = m_states[slot];
+		m_samples++;
+
+		// expire() stamps it with the gateway time
+		if (time > m_newestTime)
+		{
+			m_newestTime = time;
+			m_newestAt = 0;
+		}
+
+		// Exception stage, the last dropped sample is kept to close a flat stretch
+		bool exceeds = (state & STATE_PASSED) == 0 || std::fabs(value - m_passedValues[slot]) > m_exceptionDeviations[slot];
+		if (exceeds == false && time - m_passedTimes[slot] < m_maxIntervals[slot])
+		{
+			m_droppedTimes[slot] = time;
+			m_droppedValues[slot] = value;
+			state |= STATE_DROPPED;
+			return;
+		}
+
+		// A sample passing only for maxInterval continues the stretch, no end point is needed
+		if (state & STATE_DROPPED)
+		{
+			state &= ~STATE_DROPPED;
+			if (exceeds)
+				swing(slot, m_droppedTimes[slot], m_droppedValues[slot]);
+		}
+
+		m_passedTimes[slot] = time;
+		m_passedValues[slot] = value;
+		state |= STATE_PASSED;
+
+		swing(slot, time, value);
+	}
+
+	void OPCUA_Compressor::swing(uint32_t slot, UA_DateTime time, double value)
+	{
+		uint8_t & state = m_states[slot];
+
+		if ((state & STATE_ARCHIVED) == 0)
+		{
+			archive(slot, time, value);
+			return;
+		}
+
+		// A point is archived at least every maxInterval
+		if ((state & STATE_HELD) && time - m_archivedTimes[slot] >= m_maxIntervals[slot])
+			archiveHeld(slot);
+
+		if (time <= m_archivedTimes[slot])
+			return;
+
+		// Slopes of the door from the archived point to the sample widened by the deviation
+		double deviation = m_compressionDeviations[slot];
+		double dt = (double)(time - m_archivedTimes[slot]);
+		double upper = (value + deviation - m_archivedValues[slot]) / dt;
+		double lower = (value - deviation - m_archivedValues[slot]) / dt;
+
+		if (state & STATE_HELD)
+		{
+			upper = std::min(upper, m_upperSlopes[slot]);
+			lower = std::max(lower, m_lowerSlopes[slot]);
+
+			// The door closed, the held point ends the line and starts the next one
+			if (lower > upper)
+			{
+				archiveHeld(slot);
+
+				dt = (double)(time - m_archivedTimes[slot]);
+				upper = (value + deviation - m_archivedValues[slot]) / dt;
+				lower = (value - deviation - m_archivedValues[slot]) / dt;
+			}
+		}
+
+		m_upperSlopes[slot] = upper;
+		m_lowerSlopes[slot] = lower;
+		m_heldTimes[slot] = time;
+		m_heldValues[slot] = value;
+		state |= STATE_HELD;
+	}
+
+	void OPCUA_Compressor::archiveHeld(uint32_t slot)
+	{
+		// The line to the held sample itself can leave the corridor of an earlier
+		// one, the held point is moved onto the nearest slope inside all of them
+		double dt = (double)(m_heldTimes[slot] - m_archivedTimes[slot]);
+		double slope = (m_heldValues[slot] - m_archivedValues[slot]) / dt;
+		slope = std::min(std::max(slope, m_lowerSlopes[slot]), m_upperSlopes[slot]);
+
+		archive(slot, m_heldTimes[slot], m_archivedValues[slot] + slope * dt);
+	}
+
+	void OPCUA_Compressor::archive(uint32_t slot, UA_DateTime time, double value)
+	{
+		m_archived.push_back({ m_handles[slot], time, value });
+		m_archivedTimes[slot] = time;
+		m_archivedValues[slot] = value;
+		m_states[slot] = (m_states[slot] | STATE_ARCHIVED) & ~STATE_HELD;
+		m_points++;
+	}
+
+	void OPCUA_Compressor::expire(UA_DateTime now)
+	{
+		// Tags that stopped changing are looked at once per second
+		if (now < m_expiredAt + UA_SEC_TO_DATETIME)
+			return;
+		m_expiredAt = now;
+
+		// Source time now, the newest sample time plus the gateway time since it arrived
+		if (m_newestAt == 0)
+			m_newestAt = now;
+		UA_DateTime sourceNow = m_newestTime + (now - m_newestAt);
+
+		for (uint32_t slot = 0; slot < (uint32_t) m_handles.size(); slot++)
+		{
+			uint8_t & state = m_states[slot];
+
+			if ((state & (STATE_DROPPED | STATE_HELD)) == 0 || sourceNow - m_archivedTimes[slot] < m_maxIntervals[slot])
+				continue;
+
+			if (state & STATE_DROPPED)
+			{
+				state &= ~STATE_DROPPED;
+				swing(slot, m_droppedTimes[slot], m_droppedValues[slot]);
+			}
+
+			if (state & STATE_HELD)
+				archiveHeld(slot);
+		}
+	}
+
+	std::vector<OPCUA_ArchivedPoint_t> & OPCUA_Compressor::getArchived()
+	{
+		return m_archived;
+	}
+
+	size_t OPCUA_Compressor::size() const
+	{
+		return m_handles.size();
+	}
+
+	size_t OPCUA_Compressor::getMemoryUsage() const
+	{
+		return m_handles.getMemoryUsage() + m_exceptionDeviations.getMemoryUsage() + m_compressionDeviations.getMemoryUsage() + m_maxIntervals.getMemoryUsage() +
+			m_states.getMemoryUsage() + m_passedTimes.getMemoryUsage() + m_passedValues.getMemoryUsage() + m_droppedTimes.getMemoryUsage() +
+			m_droppedValues.getMemoryUsage() + m_archivedTimes.getMemoryUsage() + m_archivedValues.getMemoryUsage() + m_heldTimes.getMemoryUsage() +
+			m_heldValues.getMemoryUsage() + m_upperSlopes.getMemoryUsage() + m_lowerSlopes.getMemoryUsage() + m_archived.capacity() * sizeof(OPCUA_ArchivedPoint_t);
+	}
+
+	void OPCUA_Compressor::reportMetrics(int32_t serverId)
+	{
+		m_totalSamples += m_samples;
+		m_totalPoints += m_points;
+
+		Metrics::instance().add(metricname("opcua", serverId, "compression_samples"), (double) m_samples);
+		Metrics::instance().add(metricname("opcua", serverId, "compression_points"), (double) m_points);
+		Metrics::instance().set(metricname("opcua", serverId, "compression_ratio"), (m_totalPoints > 0) ? (double) m_totalSamples / m_totalPoints : 0.0);
+		Metrics::instance().set(metricname("opcua", serverId, "compression_tags"), (double) m_handles.size());
+		Metrics::instance().set(metricname("opcua", serverId, "compression_bytes"), (double) getMemoryUsage());
+
+		m_samples = 0;
+		m_points = 0;
+	}
+
+}
\ No newline at end of file
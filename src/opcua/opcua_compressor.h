@@ -0,0 +1,82 @@
+#ifndef COMPRESSOR_H
+#define COMPRESSOR_H
+
+#include <cstdint>
+#include <vector>
+#include <open62541.h>
+#include "opcua_tagstore.h"
+
+namespace gateway
+{
+
+	// A point of a tag kept by the compression, sent and stored in place of
+	// the raw samples it stands for
+	struct OPCUA_ArchivedPoint_t
+	{
+		uint32_t handle;
+		UA_DateTime time;
+		double value;
+	};
+
+	// Historian style compression of the numeric tags that have compression
+	// settings, in two stages per sample:
+	//  - Exception: a sample within exceptionDeviation of the last passed one
+	//    is dropped. Once a sample passes, the last dropped one passes first,
+	//    so a flat stretch keeps its end point.
+	//  - Swinging door: passed samples are held while they all lie within
+	//    compressionDeviation of a line from the last archived point. The held
+	//    one is archived once a sample breaks out of that corridor.
+	// Samples reaching the door stay within compressionDeviation of the line
+	// between the archived points around them, the ones dropped as exceptions
+	// within twice exceptionDeviation more. A negative exceptionDeviation
+	// passes every sample. The held point, or the last dropped one, is also
+	// archived maxInterval ms after the last archived point, by a newer
+	// sample or by expire(), which follows the source clock from the newest
+	// sample time seen on, like the sample times themselves. Samples not
+	// newer than the last archived point are dropped. Each tag owns a slot of
+	// fixed size state in structure-of-arrays form, a sample costs O(1).
+	// Archived points wait in getArchived() until the caller sends them.
+	class OPCUA_Compressor
+	{
+	public:
+		OPCUA_Compressor();
+		uint32_t add(uint32_t handle, double exceptionDeviation, double compressionDeviation, double maxInterval);
+		void push(uint32_t slot, UA_DateTime time, double value);
+		void expire(UA_DateTime now);
+		std::vector<OPCUA_ArchivedPoint_t> & getArchived();
+		size_t size() const;
+		size_t getMemoryUsage() const;
+		void reportMetrics(int32_t serverId);
+		static const uint32_t npos = 0xFFFFFFFF;
+	private:
+		void swing(uint32_t slot, UA_DateTime time, double value);
+		void archiveHeld(uint32_t slot);
+		void archive(uint32_t slot, UA_DateTime time, double value);
+		UA_DateTime m_expiredAt;
+		UA_DateTime m_newestTime;
+		UA_DateTime m_newestAt;
+		OPCUA_Column<uint32_t> m_handles;
+		OPCUA_Column<double> m_exceptionDeviations;
+		OPCUA_Column<double> m_compressionDeviations;
+		OPCUA_Column<UA_DateTime> m_maxIntervals;
+		OPCUA_Column<uint8_t> m_states;
+		OPCUA_Column<UA_DateTime> m_passedTimes;
+		OPCUA_Column<double> m_passedValues;
+		OPCUA_Column<UA_DateTime> m_droppedTimes;
+		OPCUA_Column<double> m_droppedValues;
+		OPCUA_Column<UA_DateTime> m_archivedTimes;
+		OPCUA_Column<double> m_archivedValues;
+		OPCUA_Column<UA_DateTime> m_heldTimes;
+		OPCUA_Column<double> m_heldValues;
+		OPCUA_Column<double> m_upperSlopes;
+		OPCUA_Column<double> m_lowerSlopes;
+		std::vector<OPCUA_ArchivedPoint_t> m_archived;
+		uint64_t m_samples;
+		uint64_t m_points;
+		uint64_t m_totalSamples;
+		uint64_t m_totalPoints;
+	};
+
+}
+
+#endif // COMPRESSOR_H
\ No newline at end of file
@@ -0,0 +1,208 @@
+#include "opcua_group.h"
+#include <algorithm>
+#include "../util/strutils.h"
+
+// For convenience
+using json = nlohmann::json;
+
+namespace gateway
+{
+
+	OPCUA_Group::OPCUA_Group(
+		const json & jsonConfig
+	) :
+		m_isFolder(false),
+		m_isPolled(false),
+		m_pollInterval(1000.0),
+		m_nsIndex(0),
+		m_identifiers(),
+		m_settings(),
+		m_rules(),
+		m_aggregateRules(),
+		m_compressionRules()
+	{
+		// Fetch group configuration
+		m_isFolder = jsonConfig["isFolder"].get<bool>();
+		m_nsIndex = jsonConfig["nsIndex"].get<uint16_t>();
+		m_identifiers = jsonConfig["identifiers"].get<std::vector<std::string>>();
+
+		// Nodes of a polled group are read periodically instead of subscribed to
+		m_isPolled = jsonConfig.value("mode", std::string("subscribe")) == "poll";
+		m_pollInterval = jsonConfig.value("pollInterval", m_pollInterval);
+
+		// Item settings of the group, a negative sampling interval samples at the publishing interval
+		OPCUA_ItemSettings_t defaults = { OPCUA_DEADBAND_NONE, 0.0, -1.0, 1, true, SINK_PRIORITY_NORMAL, 0.0, 0, false, false, 0.0, 0.0, 0.0 };
+		m_settings = parseItemSettings(jsonConfig, defaults);
+
+		// Identifier pattern rules, the first matching rule wins. "deadbands" is their former key
+		const char * rulesKey = (jsonConfig.find("rules") != jsonConfig.end()) ? "rules" : "deadbands";
+		if (jsonConfig.find(rulesKey) != jsonConfig.end())
+		{
+			for (const json & jsonRule : jsonConfig[rulesKey])
+			{
+				OPCUA_ItemRule_t rule;
+				rule.pattern = jsonRule["pattern"].get<std::string>();
+				rule.settings = parseItemSettings(jsonRule, m_settings);
+				m_rules.push_back(rule);
+			}
+		}
+
+		// Aggregation pattern rules, only their aggregate settings are used
+		if (jsonConfig.find("aggregates") != jsonConfig.end())
+		{
+			for (const json & jsonRule : jsonConfig["aggregates"])
+			{
+				OPCUA_ItemRule_t rule;
+				rule.pattern = jsonRule["pattern"].get<std::string>();
+				rule.settings = parseAggregate(jsonRule, defaults);
+				m_aggregateRules.push_back(rule);
+			}
+		}
+
+		// Compression pattern rules, only their compression settings are used
+		if (jsonConfig.find("compression") != jsonConfig.end())
+		{
+			for (const json & jsonRule : jsonConfig["compression"])
+			{
+				OPCUA_ItemRule_t rule;
+				rule.pattern = jsonRule["pattern"].get<std::string>();
+				rule.settings = parseCompression(jsonRule, defaults);
+				m_compressionRules.push_back(rule);
+			}
+		}
+	}
+
+	OPCUA_ItemSettings_t OPCUA_Group::getItemSettings(const std::string & identifier) const
+	{
+		OPCUA_ItemSettings_t settings = m_settings;
+
+		for (const OPCUA_ItemRule_t & rule : m_rules)
+		{
+			if (strglob(rule.pattern.c_str(), identifier.c_str()))
+			{
+				settings = rule.settings;
+				break;
+			}
+		}
+
+		for (const OPCUA_ItemRule_t & rule : m_aggregateRules)
+		{
+			if (strglob(rule.pattern.c_str(), identifier.c_str()))
+			{
+				settings.aggregateWindow = rule.settings.aggregateWindow;
+				settings.aggregates = rule.settings.aggregates;
+				settings.aggregateRaw = rule.settings.aggregateRaw;
+				break;
+			}
+		}
+
+		for (const OPCUA_ItemRule_t & rule : m_compressionRules)
+		{
+			if (strglob(rule.pattern.c_str(), identifier.c_str()))
+			{
+				settings.compress = rule.settings.compress;
+				settings.exceptionDeviation = rule.settings.exceptionDeviation;
+				settings.compressionDeviation = rule.settings.compressionDeviation;
+				settings.compressionMaxInterval = rule.settings.compressionMaxInterval;
+				break;
+			}
+		}
+
+		return settings;
+	}
+
+	bool OPCUA_Group::isFolder() const
+	{
+		return m_isFolder;
+	}
+
+	bool OPCUA_Group::isPolled() const
+	{
+		return m_isPolled;
+	}
+
+	double OPCUA_Group::getPollInterval() const
+	{
+		return m_pollInterval;
+	}
+
+	uint16_t OPCUA_Group::getNsIndex() const
+	{
+		return m_nsIndex;
+	}
+
+	const std::vector<std::string> & OPCUA_Group::getIdentifiers() const
+	{
+		return m_identifiers;
+	}
+
+	OPCUA_ItemSettings_t OPCUA_Group::parseItemSettings(const json & jsonConfig, const OPCUA_ItemSettings_t & defaults)
+	{
+		OPCUA_ItemSettings_t settings = defaults;
+
+		std::string deadbandType = jsonConfig.value("deadbandType", std::string());
+		if (deadbandType == "absolute")
+			settings.deadbandType = OPCUA_DEADBAND_ABSOLUTE;
+		else if (deadbandType == "percent")
+			settings.deadbandType = OPCUA_DEADBAND_PERCENT;
+		else if (deadbandType == "none")
+			settings.deadbandType = OPCUA_DEADBAND_NONE;
+
+		settings.deadbandValue = jsonConfig.value("deadbandValue", settings.deadbandValue);
+		settings.samplingInterval = jsonConfig.value("samplingInterval", settings.samplingInterval);
+		settings.queueSize = jsonConfig.value("queueSize", settings.queueSize);
+		settings.discardOldest = jsonConfig.value("discardOldest", settings.discardOldest);
+
+		if (jsonConfig.find("priority") != jsonConfig.end())
+			settings.priority = SINK_ParsePriority(jsonConfig["priority"].get<std::string>());
+
+		return settings;
+	}
+
+	OPCUA_ItemSettings_t OPCUA_Group::parseAggregate(const json & jsonConfig, const OPCUA_ItemSettings_t & defaults)
+	{
+		OPCUA_ItemSettings_t settings = defaults;
+
+		// Window in milliseconds, 0 leaves the tags unaggregated
+		settings.aggregateWindow = std::max(jsonConfig.value("window", 0.0), 0.0);
+		settings.aggregateRaw = jsonConfig.value("raw", false);
+		settings.aggregates = OPCUA_AGGREGATE_ALL;
+
+		if (jsonConfig.find("functions") != jsonConfig.end())
+		{
+			settings.aggregates = 0;
+			for (const json & jsonFunction : jsonConfig["functions"])
+			{
+				std::string function = jsonFunction.get<std::string>();
+				if (function == "min")
+					settings.aggregates |= OPCUA_AGGREGATE_MIN;
+				else if (function == "max")
+					settings.aggregates |= OPCUA_AGGREGATE_MAX;
+				else if (function == "avg")
+					settings.aggregates |= OPCUA_AGGREGATE_AVG;
+				else if (function == "count")
+					settings.aggregates |= OPCUA_AGGREGATE_COUNT;
+				else if (function == "last")
+					settings.aggregates |= OPCUA_AGGREGATE_LAST;
+			}
+		}
+
+		return settings;
+	}
+
+	OPCUA_ItemSettings_t OPCUA_Group::parseCompression(const json & jsonConfig, const OPCUA_ItemSettings_t & defaults)
+	{
+		OPCUA_ItemSettings_t settings = defaults;
+
+		// Deviations in engineering units, a negative exception deviation passes every sample
+		settings.compress = jsonConfig.value("enabled", true);
+		settings.exceptionDeviation = jsonConfig.value("exceptionDeviation", 0.0);
+		settings.compressionDeviation = std::max(jsonConfig.value("compressionDeviation", 0.0), 0.0);
+
+		// Longest gap in milliseconds between two archived points, 0 has no limit
+		settings.compressionMaxInterval = std::max(jsonConfig.value("maxInterval", 600000.0), 0.0);
+
+		return settings;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,91 @@
+#ifndef GROUP_H
+#define GROUP_H
+
+#include <string>
+#include <cstdint>
+#include <vector>
+#include "../3rdparty/json.hpp"
+#include "../sink/sink_sink.h"
+
+namespace gateway
+{
+
+	// Values match UA_DeadbandType
+	enum OPCUA_Deadband_t
+	{
+		OPCUA_DEADBAND_NONE = 0,
+		OPCUA_DEADBAND_ABSOLUTE = 1,
+		OPCUA_DEADBAND_PERCENT = 2
+	};
+
+	// Bits of the aggregate functions sent per window, values match the
+	// function bits of the binary format
+	enum OPCUA_Aggregate_t
+	{
+		OPCUA_AGGREGATE_MIN = 1,
+		OPCUA_AGGREGATE_MAX = 2,
+		OPCUA_AGGREGATE_AVG = 4,
+		OPCUA_AGGREGATE_COUNT = 8,
+		OPCUA_AGGREGATE_LAST = 16,
+		OPCUA_AGGREGATE_ALL = 31
+	};
+
+	struct OPCUA_ItemSettings_t
+	{
+		OPCUA_Deadband_t deadbandType;
+		double deadbandValue;
+		double samplingInterval;
+		uint32_t queueSize;
+		bool discardOldest;
+		SINK_Priority_t priority;
+		double aggregateWindow;
+		uint8_t aggregates;
+		bool aggregateRaw;
+		bool compress;
+		double exceptionDeviation;
+		double compressionDeviation;
+		double compressionMaxInterval;
+	};
+
+	struct OPCUA_ItemRule_t
+	{
+		std::string pattern;
+		OPCUA_ItemSettings_t settings;
+	};
+
+	// A single entry of the "subscriptions" array in ua_client_config. Holds
+	// the monitored item settings of the entry and the identifier pattern
+	// "rules" that override them: deadband, sampling, queue and priority.
+	// Rules of "aggregates" set the aggregation window, functions and raw
+	// pass-through on top of them,
+	// rules of "compression" the exception and swinging door deviations.
+	class OPCUA_Group
+	{
+	public:
+		OPCUA_Group(
+			const nlohmann::json & jsonConfig
+		);
+		OPCUA_ItemSettings_t getItemSettings(const std::string & identifier) const;
+		bool isFolder() const;
+		bool isPolled() const;
+		double getPollInterval() const;
+		uint16_t getNsIndex() const;
+		const std::vector<std::string> & getIdentifiers() const;
+	private:
+		static OPCUA_ItemSettings_t parseItemSettings(const nlohmann::json & jsonConfig, const OPCUA_ItemSettings_t & defaults);
+		static OPCUA_ItemSettings_t parseAggregate(const nlohmann::json & jsonConfig, const OPCUA_ItemSettings_t & defaults);
+		static OPCUA_ItemSettings_t parseCompression(const nlohmann::json & jsonConfig, const OPCUA_ItemSettings_t & defaults);
+		bool m_isFolder;
+		bool m_isPolled;
+		double m_pollInterval;
+		uint16_t m_nsIndex;
+		std::vector<std::string> m_identifiers;
+		OPCUA_ItemSettings_t m_settings;
+		std::vector<OPCUA_ItemRule_t> m_rules;
+		std::vector<OPCUA_ItemRule_t> m_aggregateRules;
+		std::vector<OPCUA_ItemRule_t> m_compressionRules;
+	};
+
+}
+
+#endif // GROUP_H
\ No newline at end of file
@@ -0,0 +1,217 @@
+#include "opcua_nodetable.h"
+#include <cstdio>
+#include <cstring>
+#include "../util/strutils.h"
+
+namespace gateway
+{
+
+	const uint32_t OPCUA_NodeTable::npos;
+
+	OPCUA_NodeTable::OPCUA_NodeTable() :
+		m_entries(),
+		m_arena(),
+		m_slots(1024, npos)
+	{
+
+	}
+
+	uint32_t OPCUA_NodeTable::intern(const UA_NodeId & nodeId)
+	{
+		const uint8_t * data;
+		uint32_t length, numeric;
+		key(nodeId, data, length, numeric);
+
+		uint8_t type = (uint8_t) nodeId.identifierType;
+		uint32_t h = hash(nodeId.namespaceIndex, type, data, length, numeric);
+		size_t mask = m_slots.size() - 1;
+
+		for (size_t i = h & mask;; i = (i + 1) & mask)
+		{
+			uint32_t handle = m_slots[i];
+
+			if (handle == npos)
+			{
+				OPCUA_NodeEntry_t entry = { h, numeric, length, nodeId.namespaceIndex, type };
+
+				if (length > 0)
+				{
+					entry.offset = (uint32_t) m_arena.size();
+					m_arena.insert(m_arena.end(), data, data + length);
+				}
+
+				handle = (uint32_t) m_entries.size();
+				m_entries.push_back(entry);
+				m_slots[i] = handle;
+
+				// Keep the load factor below one half
+				if (m_entries.size() * 2 > m_slots.size())
+					grow();
+
+				return handle;
+			}
+
+			if (equals(m_entries[handle], nodeId.namespaceIndex, type, data, length, numeric))
+				return handle;
+		}
+	}
+
+	uint32_t OPCUA_NodeTable::find(const UA_NodeId & nodeId) const
+	{
+		const uint8_t * data;
+		uint32_t length, numeric;
+		key(nodeId, data, length, numeric);
+
+		uint8_t type = (uint8_t) nodeId.identifierType;
+		size_t mask = m_slots.size() - 1;
+
+		for (size_t i = hash(nodeId.namespaceIndex, type, data, length, numeric) & mask;; i = (i + 1) & mask)
+		{
+			uint32_t handle = m_slots[i];
+
+			if (handle == npos || equals(m_entries[handle], nodeId.namespaceIndex, type, data, length, numeric))
+				return handle;
+		}
+	}
+
+	UA_NodeId OPCUA_NodeTable::getNodeId(uint32_t handle) const
+	{
+		const OPCUA_NodeEntry_t & entry = m_entries[handle];
+
+		// The identifier points into the arena, the view is valid until the next intern()
+		UA_NodeId nodeId;
+		UA_NodeId_init(&nodeId);
+		nodeId.namespaceIndex = entry.nsIndex;
+		nodeId.identifierType = (UA_NodeIdType) entry.type;
+
+		switch (entry.type)
+		{
+		case UA_NODEIDTYPE_NUMERIC:
+			nodeId.identifier.numeric = entry.offset;
+			break;
+		case UA_NODEIDTYPE_GUID:
+			std::memcpy(&nodeId.identifier.guid, &m_arena[entry.offset], sizeof(UA_Guid));
+			break;
+		default:
+			nodeId.identifier.string.length = entry.length;
+			nodeId.identifier.string.data = (entry.length > 0) ? (UA_Byte *) &m_arena[entry.offset] : NULL;
+			break;
+		}
+
+		return nodeId;
+	}
+
+	std::string OPCUA_NodeTable::getIdentifier(uint32_t handle) const
+	{
+		const OPCUA_NodeEntry_t & entry = m_entries[handle];
+
+		switch (entry.type)
+		{
+		case UA_NODEIDTYPE_NUMERIC:
+			return std::to_string(entry.offset);
+		case UA_NODEIDTYPE_GUID:
+		{
+			UA_Guid guid;
+			std::memcpy(&guid, &m_arena[entry.offset], sizeof(UA_Guid));
+
+			char buffer[40];
+			std::snprintf(buffer, sizeof(buffer), "%08X-%04X-%04X-%02X%02X-%02X%02X%02X%02X%02X%02X",
+				guid.data1, guid.data2, guid.data3, guid.data4[0], guid.data4[1],
+				guid.data4[2], guid.data4[3], guid.data4[4], guid.data4[5], guid.data4[6], guid.data4[7]
+			);
+			return std::string(buffer);
+		}
+		case UA_NODEIDTYPE_BYTESTRING:
+			return (entry.length > 0) ? base64encode(&m_arena[entry.offset], entry.length) : std::string();
+		default:
+			return (entry.length > 0) ? std::string(m_arena.begin() + entry.offset, m_arena.begin() + entry.offset + entry.length) : std::string();
+		}
+	}
+
+	uint16_t OPCUA_NodeTable::getNsIndex(uint32_t handle) const
+	{
+		return m_entries[handle].nsIndex;
+	}
+
+	uint32_t OPCUA_NodeTable::getHash(uint32_t handle) const
+	{
+		return m_entries[handle].hash;
+	}
+
+	size_t OPCUA_NodeTable::size() const
+	{
+		return m_entries.size();
+	}
+
+	size_t OPCUA_NodeTable::getMemoryUsage() const
+	{
+		return m_entries.capacity() * sizeof(OPCUA_NodeEntry_t) + m_arena.capacity() + m_slots.capacity() * sizeof(uint32_t);
+	}
+
+	void OPCUA_NodeTable::key(const UA_NodeId & nodeId, const uint8_t * & data, uint32_t & length, uint32_t & numeric)
+	{
+		data = NULL;
+		length = 0;
+		numeric = 0;
+
+		switch (nodeId.identifierType)
+		{
+		case UA_NODEIDTYPE_NUMERIC:
+			numeric = nodeId.identifier.numeric;
+			break;
+		case UA_NODEIDTYPE_GUID:
+			data = (const uint8_t *) &nodeId.identifier.guid;
+			length = sizeof(UA_Guid);
+			break;
+		default:
+			data = nodeId.identifier.string.data;
+			length = (uint32_t) nodeId.identifier.string.length;
+			break;
+		}
+	}
+
+	uint32_t OPCUA_NodeTable::hash(uint16_t nsIndex, uint8_t type, const uint8_t * data, uint32_t length, uint32_t numeric)
+	{
+		// FNV-1a, stable across runs unlike std::hash
+		uint32_t h = 2166136261u;
+		uint8_t head[7] = { (uint8_t) nsIndex, (uint8_t)(nsIndex >> 8), type, (uint8_t) numeric, (uint8_t)(numeric >> 8), (uint8_t)(numeric >> 16), (uint8_t)(numeric >> 24) };
+
+		for (size_t i = 0; i < sizeof(head); i++)
+			h = (h ^ head[i]) * 16777619u;
+
+		for (uint32_t i = 0; i < length; i++)
+			h = (h ^ data[i]) * 16777619u;
+
+		return h;
+	}
+
+	bool OPCUA_NodeTable::equals(const OPCUA_NodeEntry_t & entry, uint16_t nsIndex, uint8_t type, const uint8_t * data, uint32_t length, uint32_t numeric) const
+	{
+		if (entry.nsIndex != nsIndex || entry.type != type || entry.length != length)
+			return false;
+
+		if (length == 0)
+			return type != UA_NODEIDTYPE_NUMERIC || entry.offset == numeric;
+
+		return std::memcmp(&m_arena[entry.offset], data, length) == 0;
+	}
+
+	void OPCUA_NodeTable::grow()
+	{
+		std::vector<uint32_t> slots(m_slots.size() * 2, npos);
+		size_t mask = slots.size() - 1;
+
+		for (uint32_t handle = 0; handle < m_entries.size(); handle++)
+		{
+			size_t i = m_entries[handle].hash & mask;
+
+			while (slots[i] != npos)
+				i = (i + 1) & mask;
+
+			slots[i] = handle;
+		}
+
+		m_slots.swap(slots);
+	}
+
+}
\ No newline at end of file
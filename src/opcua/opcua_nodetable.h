@@ -0,0 +1,51 @@
+#ifndef NODETABLE_H
+#define NODETABLE_H
+
+#include <string>
+#include <cstdint>
+#include <vector>
+#include <open62541.h>
+
+namespace gateway
+{
+
+	// An interned NodeId, the identifier bytes of string, GUID and opaque ids
+	// live in the arena at [offset, offset + length), numeric ids in offset
+	struct OPCUA_NodeEntry_t
+	{
+		uint32_t hash;
+		uint32_t offset;
+		uint32_t length;
+		uint16_t nsIndex;
+		uint8_t type;
+	};
+
+	// Interns the NodeIds of a client into one arena and hands out dense
+	// 32-bit handles, equal NodeIds share a handle. Handles index the entries
+	// directly, lookups by NodeId go through an open addressing hash table.
+	class OPCUA_NodeTable
+	{
+	public:
+		OPCUA_NodeTable();
+		uint32_t intern(const UA_NodeId & nodeId);
+		uint32_t find(const UA_NodeId & nodeId) const;
+		UA_NodeId getNodeId(uint32_t handle) const;
+		std::string getIdentifier(uint32_t handle) const;
+		uint16_t getNsIndex(uint32_t handle) const;
+		uint32_t getHash(uint32_t handle) const;
+		size_t size() const;
+		size_t getMemoryUsage() const;
+		static const uint32_t npos = 0xFFFFFFFF;
+	private:
+		static void key(const UA_NodeId & nodeId, const uint8_t * & data, uint32_t & length, uint32_t & numeric);
+		static uint32_t hash(uint16_t nsIndex, uint8_t type, const uint8_t * data, uint32_t length, uint32_t numeric);
+		bool equals(const OPCUA_NodeEntry_t & entry, uint16_t nsIndex, uint8_t type, const uint8_t * data, uint32_t length, uint32_t numeric) const;
+		void grow();
+		std::vector<OPCUA_NodeEntry_t> m_entries;
+		std::vector<uint8_t> m_arena;
+		std::vector<uint32_t> m_slots;
+	};
+
+}
+
+#endif // NODETABLE_H
\ No newline at end of file
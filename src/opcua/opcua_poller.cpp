@@ -0,0 +1,449 @@
+#include "opcua_poller.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <chrono>
+#include "../macros.h"
+#include "opcua_client.h"
+#include "opcua_subscription.h"
+#include "opcua_group.h"
+#include "opcua_nodetable.h"
+#include "opcua_tagstore.h"
+#include "../util/metrics.h"
+#include "../util/arena.h"
+
+namespace gateway
+{
+
+	// Compares the parts of two data values a subscription would report on
+	bool UADataValueChanged(const UA_DataValue & a, const UA_DataValue & b)
+	{
+		if (a.hasValue != b.hasValue || a.hasStatus != b.hasStatus || a.status != b.status)
+			return true;
+
+		const UA_Variant & va = a.value;
+		const UA_Variant & vb = b.value;
+
+		if (va.type != vb.type || va.arrayLength != vb.arrayLength || (va.data == NULL) != (vb.data == NULL))
+			return true;
+
+		if (va.type == NULL || va.data == NULL || va.data == UA_EMPTY_ARRAY_SENTINEL)
+			return false;
+
+		// Plain data, compare the memory of the scalar or the whole array
+		if (va.type->fixedSize)
+			return memcmp(va.data, vb.data, va.type->memSize * std::max<size_t>(va.arrayLength, 1)) != 0;
+
+		// Scalar strings
+		if (UA_Variant_isScalar(&va) && (va.type->typeIndex == UA_TYPES_STRING || va.type->typeIndex == UA_TYPES_BYTESTRING))
+		{
+			const UA_String * sa = (const UA_String *) va.data;
+			const UA_String * sb = (const UA_String *) vb.data;
+			return sa->length != sb->length || memcmp(sa->data, sb->data, sa->length) != 0;
+		}
+
+		// Anything else, rely on the source timestamp
+		return a.sourceTimestamp != b.sourceTimestamp;
+	}
+
+	// Statuses of a service call after which the session or connection is gone, others fail the request only
+	bool UAStatusIsConnectionLost(UA_Client * client, UA_StatusCode status)
+	{
+		if (UA_Client_getState(client) != UA_CLIENTSTATE_CONNECTED)
+			return true;
+
+		switch (status)
+		{
+		case UA_STATUSCODE_BADCONNECTIONCLOSED:
+		case UA_STATUSCODE_BADDISCONNECT:
+		case UA_STATUSCODE_BADCOMMUNICATIONERROR:
+		case UA_STATUSCODE_BADSERVERNOTCONNECTED:
+		case UA_STATUSCODE_BADSECURECHANNELCLOSED:
+		case UA_STATUSCODE_BADSECURECHANNELIDINVALID:
+		case UA_STATUSCODE_BADSESSIONIDINVALID:
+		case UA_STATUSCODE_BADSESSIONCLOSED:
+		case UA_STATUSCODE_BADSESSIONNOTACTIVATED:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	OPCUA_Poller::OPCUA_Poller(
+		OPCUA_Client * const client
+	) :
+		m_client(client),
+		m_uaClient(NULL),
+		m_items(),
+		m_buckets(),
+		m_wheel(512),
+		m_cursor(0),
+		m_tick(10.0),
+		m_tickAt(0),
+		m_chunk(1000),
+		m_responses(),
+		m_maxResponses(64),
+		m_records(),
+		m_status(UA_STATUSCODE_GOOD),
+		m_mutex(),
+		m_condition(),
+		m_running(false),
+		m_thread()
+	{
+		m_uaClient = UA_Client_new(UA_ClientConfig_standard);
+	}
+
+	OPCUA_Poller::~OPCUA_Poller()
+	{
+		join();
+
+		for (OPCUA_PollResponse_t & queued : m_responses)
+			UA_ReadResponse_delete(queued.response);
+
+		for (OPCUA_PollItem_t & item : m_items)
+		{
+			UA_NodeId_deleteMembers(&item.nodeId);
+			UA_DataValue_deleteMembers(&item.last);
+		}
+
+		for (OPCUA_PollBucket_t * bucket : m_buckets)
+			delete bucket;
+
+		UA_Client_disconnect(m_uaClient);
+		UA_Client_delete(m_uaClient);
+	}
+
+	UA_StatusCode OPCUA_Poller::add(size_t first)
+	{
+		OPCUA_TagStore * tags = m_client->getTagStore();
+		size_t first_item = m_items.size();
+
+		// The thread owns the wheel while it runs, OPCUA_Client starts it again with the sessions
+		join();
+
+		for (uint32_t i = (uint32_t) first; i < tags->size(); i++)
+		{
+			OPCUA_Group * group = tags->getGroup(i);
+
+			if (group == NULL || group->isPolled() == false)
+				continue;
+
+			OPCUA_PollItem_t item;
+			item.handle = i;
+			UA_NodeId_init(&item.nodeId);
+			UA_DataValue_init(&item.last);
+			item.hasLast = false;
+			m_items.push_back(item);
+
+			// Find or create the bucket of this poll rate
+			double interval = group->getPollInterval();
+			auto it = std::find_if(m_buckets.begin(), m_buckets.end(), [interval](OPCUA_PollBucket_t * b) { return b->interval == interval; });
+
+			if (it == m_buckets.end())
+			{
+				OPCUA_PollBucket_t * bucket = new OPCUA_PollBucket_t();
+				bucket->interval = interval;
+				bucket->rounds = 0;
+				m_buckets.push_back(bucket);
+				schedule(bucket, 0.0);
+				it = m_buckets.end() - 1;
+			}
+
+			(*it)->items.push_back((uint32_t)(m_items.size() - 1));
+		}
+
+		if (first_item == m_items.size())
+			return UA_STATUSCODE_GOOD;
+
+		LOG("OPCUA_Poller serverId(%d) polling %u nodes in %u buckets\n", UA_DateTime_now(), m_client->getServerId(), (unsigned int) m_items.size(), (unsigned int) m_buckets.size());
+
+		return registerNodes(first_item);
+	}
+
+	UA_StatusCode OPCUA_Poller::registerNodes(size_t first)
+	{
+		OPCUA_TagStore * tags = m_client->getTagStore();
+		OPCUA_NodeTable * table = m_client->getNodeTable();
+
+		if (first >= m_items.size())
+			return UA_STATUSCODE_GOOD;
+
+		// Servers without polled groups get no session for it
+		if (UA_Client_getState(m_uaClient) != UA_CLIENTSTATE_CONNECTED)
+		{
+			UA_StatusCode status = m_client->connect(m_uaClient);
+			if (status != UA_STATUSCODE_GOOD)
+				return status;
+		}
+
+		// Servers limit the amount of nodes per call, send in chunks
+		const size_t n_chunk = 1000;
+
+		for (size_t i = first; i < m_items.size(); i += n_chunk)
+		{
+			size_t n_nodes = std::min(n_chunk, m_items.size() - i);
+			std::vector<UA_NodeId> nodes(n_nodes);
+
+			for (size_t j = 0; j < n_nodes; j++)
+			{
+				nodes[j] = table->getNodeId(tags->getNode(m_items[i + j].handle));
+				UA_NodeId_deleteMembers(&m_items[i + j].nodeId);
+			}
+
+			UA_RegisterNodesRequest request;
+			UA_RegisterNodesRequest_init(&request);
+			request.nodesToRegisterSize = n_nodes;
+			request.nodesToRegister = nodes.data();
+
+			UA_RegisterNodesResponse response = UA_Client_Service_registerNodes(m_uaClient, request);
+			bool registered = response.responseHeader.serviceResult == UA_STATUSCODE_GOOD && response.registeredNodeIdsSize == n_nodes;
+
+			// Servers without RegisterNodes support are read with the plain NodeIds
+			for (size_t j = 0; j < n_nodes; j++)
+				UA_NodeId_copy(registered ? &response.registeredNodeIds[j] : &nodes[j], &m_items[i + j].nodeId);
+
+			if (registered == false)
+				WRN("OPCUA_Poller serverId(%d) RegisterNodes failed, status: 0x%08x, reading unregistered\n", UA_DateTime_now(), m_client->getServerId(), response.responseHeader.serviceResult);
+
+			UA_RegisterNodesResponse_deleteMembers(&response);
+		}
+
+		return UA_STATUSCODE_GOOD;
+	}
+
+	void OPCUA_Poller::reset()
+	{
+		join();
+
+		// Drop the old session and secure channel, registerNodes() connects again
+		UA_Client_reset(m_uaClient);
+		m_status = UA_STATUSCODE_GOOD;
+	}
+
+	void OPCUA_Poller::start()
+	{
+		if (m_running || m_buckets.empty())
+			return;
+
+		// A thread stopped without waiting has returned by now, reset() joined it
+		if (m_thread.joinable())
+			m_thread.join();
+
+		m_status = UA_STATUSCODE_GOOD;
+		m_running = true;
+		m_thread = std::thread(&OPCUA_Poller::run, this);
+	}
+
+	void OPCUA_Poller::stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_running = false;
+		}
+		m_condition.notify_all();
+
+		// An outstanding read returns within the client timeout, the thread ends then without blocking the caller
+	}
+
+	void OPCUA_Poller::join()
+	{
+		stop();
+
+		if (m_thread.joinable())
+			m_thread.join();
+	}
+
+	void OPCUA_Poller::run()
+	{
+		std::vector<OPCUA_PollBucket_t *> due;
+
+		while (m_running)
+		{
+			// Sleep until the next tick, then wait while the main thread is behind on dispatching
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				double wait = (double)(m_tickAt - UA_DateTime_now()) / UA_MSEC_TO_DATETIME;
+				if (wait > 0.0)
+					m_condition.wait_for(lock, std::chrono::duration<double, std::milli>(wait), [this] { return m_running == false; });
+				m_condition.wait(lock, [this] { return m_running == false || m_responses.size() < m_maxResponses; });
+
+				if (m_running == false)
+					break;
+			}
+
+			// Every due bucket goes back on the wheel first, a failed read must not take the later ones off it
+			due.clear();
+			advance(UA_DateTime_now(), due);
+			for (OPCUA_PollBucket_t * bucket : due)
+				schedule(bucket, bucket->interval);
+
+			for (OPCUA_PollBucket_t * bucket : due)
+			{
+				UA_StatusCode status = read(bucket);
+
+				// Lost the session or connection, OPCUA_Client picks the status up in dispatch()
+				if (status != UA_STATUSCODE_GOOD)
+				{
+					m_status = status;
+					m_running = false;
+					break;
+				}
+			}
+		}
+	}
+
+	void OPCUA_Poller::advance(UA_DateTime now, std::vector<OPCUA_PollBucket_t *> & due)
+	{
+		// Start ticking, or skip ahead after being stalled for more than a revolution
+		if (m_tickAt == 0 || now - m_tickAt > (UA_DateTime)(m_tick * m_wheel.size() * UA_MSEC_TO_DATETIME))
+			m_tickAt = now;
+
+		// Advance the wheel, collect every bucket that became due on the way
+		while (now >= m_tickAt)
+		{
+			m_cursor = (m_cursor + 1) % m_wheel.size();
+			m_tickAt += (UA_DateTime)(m_tick * UA_MSEC_TO_DATETIME);
+
+			std::vector<OPCUA_PollBucket_t *> & slot = m_wheel[m_cursor];
+			for (size_t i = 0; i < slot.size();)
+			{
+				if (slot[i]->rounds > 0)
+				{
+					slot[i]->rounds--;
+					i++;
+				}
+				else
+				{
+					due.push_back(slot[i]);
+					slot[i] = slot.back();
+					slot.pop_back();
+				}
+			}
+		}
+	}
+
+	UA_StatusCode OPCUA_Poller::dispatch()
+	{
+		std::deque<OPCUA_PollResponse_t> responses;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			responses.swap(m_responses);
+		}
+		m_condition.notify_all();
+
+		size_t n_reads = 0;
+		size_t n_changed = 0;
+
+		for (OPCUA_PollResponse_t & queued : responses)
+		{
+			UA_ReadResponse * response = queued.response;
+			n_reads += response->resultsSize;
+
+			// Only changed values go to the egress path
+			for (size_t j = 0; j < response->resultsSize; j++)
+			{
+				OPCUA_PollItem_t & item = m_items[queued.bucket->items[queued.first + j]];
+				UA_DataValue & value = response->results[j];
+
+				if (item.hasLast && UADataValueChanged(item.last, value) == false)
+					continue;
+
+				UA_DataValue_deleteMembers(&item.last);
+				UA_DataValue_copy(&value, &item.last);
+				item.hasLast = true;
+
+				m_records.push_back({ item.handle, &value });
+			}
+
+			if (m_records.empty() == false)
+			{
+				OPCUA_Callback_DataChanges(m_client, m_records.data(), m_records.size());
+				n_changed += m_records.size();
+				m_records.clear();
+			}
+
+			// Everything built for this response has been handed off
+			m_client->getArena().reset();
+			UA_ReadResponse_delete(response);
+		}
+
+		if (n_reads > 0)
+		{
+			Metrics::instance().add(metricname("opcua", m_client->getServerId(), "poll_reads"), (double) n_reads);
+			Metrics::instance().add(metricname("opcua", m_client->getServerId(), "poll_changes"), (double) n_changed);
+		}
+
+		return m_status;
+	}
+
+	size_t OPCUA_Poller::getItemCount() const
+	{
+		return m_items.size();
+	}
+
+	void OPCUA_Poller::schedule(OPCUA_PollBucket_t * bucket, double delay)
+	{
+		size_t ticks = std::max<size_t>(1, (size_t) std::ceil(delay / m_tick));
+
+		bucket->rounds = (uint32_t)((ticks - 1) / m_wheel.size());
+		m_wheel[(m_cursor + ticks) % m_wheel.size()].push_back(bucket);
+	}
+
+	UA_StatusCode OPCUA_Poller::read(OPCUA_PollBucket_t * bucket)
+	{
+		size_t n_nodes = 0;
+
+		// Servers limit the amount of nodes per call, send in chunks
+		for (size_t i = 0; i < bucket->items.size() && m_running; i += n_nodes)
+		{
+			n_nodes = std::min(m_chunk, bucket->items.size() - i);
+			std::vector<UA_ReadValueId> nodes(n_nodes);
+
+			for (size_t j = 0; j < n_nodes; j++)
+			{
+				UA_ReadValueId_init(&nodes[j]);
+				nodes[j].nodeId = m_items[bucket->items[i + j]].nodeId;
+				nodes[j].attributeId = UA_ATTRIBUTEID_VALUE;
+			}
+
+			UA_ReadRequest request;
+			UA_ReadRequest_init(&request);
+			request.maxAge = 0.0;
+			request.timestampsToReturn = UA_TIMESTAMPSTORETURN_BOTH;
+			request.nodesToReadSize = n_nodes;
+			request.nodesToRead = nodes.data();
+
+			UA_ReadResponse * response = UA_ReadResponse_new();
+			*response = UA_Client_Service_read(m_uaClient, request);
+			UA_StatusCode status = response->responseHeader.serviceResult;
+
+			if (status == UA_STATUSCODE_GOOD && response->resultsSize != n_nodes)
+				status = UA_STATUSCODE_BADUNEXPECTEDERROR;
+
+			if (status != UA_STATUSCODE_GOOD)
+			{
+				UA_ReadResponse_delete(response);
+
+				if (UAStatusIsConnectionLost(m_uaClient, status))
+					return status;
+
+				// A service error only costs the bucket this round, an oversized request is split from now on
+				if (status == UA_STATUSCODE_BADTOOMANYOPERATIONS && m_chunk > 1)
+					m_chunk /= 2;
+
+				Metrics::instance().add(metricname("opcua", m_client->getServerId(), "poll_errors"));
+				WRN("OPCUA_Poller serverId(%d) read of %u nodes every %.0f ms failed, status: 0x%08x\n", UA_DateTime_now(), m_client->getServerId(), (unsigned int) n_nodes, bucket->interval, status);
+
+				return UA_STATUSCODE_GOOD;
+			}
+
+			// Waits while dispatch() is behind, on stop the destructor frees what is queued
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_condition.wait(lock, [this] { return m_running == false || m_responses.size() < m_maxResponses; });
+			m_responses.push_back({ bucket, i, response });
+		}
+
+		return UA_STATUSCODE_GOOD;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,92 @@
+#ifndef POLLER_H
+#define POLLER_H
+
+#include <string>
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <open62541.h>
+#include "opcua_subscription.h"
+
+namespace gateway
+{
+
+	class OPCUA_Client;
+
+	struct OPCUA_PollItem_t
+	{
+		uint32_t handle;
+		UA_NodeId nodeId;
+		UA_DataValue last;
+		bool hasLast;
+	};
+
+	struct OPCUA_PollBucket_t
+	{
+		double interval;
+		uint32_t rounds;
+		std::vector<uint32_t> items;
+	};
+
+	// One Read response for the items of a bucket from index first on
+	struct OPCUA_PollResponse_t
+	{
+		OPCUA_PollBucket_t * bucket;
+		size_t first;
+		UA_ReadResponse * response;
+	};
+
+	// Reads the items of polled subscription groups with batched Read calls.
+	// Items with the same poll interval share a bucket, buckets are scheduled
+	// on a hashed timer wheel so each round only touches the due ones. Like
+	// an OPCUA_Session it reads over a UA_Client of its own on a thread of its
+	// own, connected on demand once there are items, and dispatch() hands the
+	// changed values to the callbacks on the main thread. A service error of
+	// a read only skips that bucket for the round, BadTooManyOperations also
+	// halves the nodes per request; only a lost connection ends the thread.
+	class OPCUA_Poller
+	{
+	public:
+		OPCUA_Poller(
+			OPCUA_Client * const client
+		);
+		~OPCUA_Poller();
+		UA_StatusCode add(size_t first);
+		UA_StatusCode registerNodes(size_t first = 0);
+		void reset();
+		void start();
+		void stop();
+		UA_StatusCode dispatch();
+		size_t getItemCount() const;
+	private:
+		void join();
+		void run();
+		void advance(UA_DateTime now, std::vector<OPCUA_PollBucket_t *> & due);
+		void schedule(OPCUA_PollBucket_t * bucket, double delay);
+		UA_StatusCode read(OPCUA_PollBucket_t * bucket);
+		OPCUA_Client * m_client;
+		UA_Client * m_uaClient;
+		std::vector<OPCUA_PollItem_t> m_items;
+		std::vector<OPCUA_PollBucket_t *> m_buckets;
+		std::vector<std::vector<OPCUA_PollBucket_t *>> m_wheel;
+		size_t m_cursor;
+		double m_tick;
+		UA_DateTime m_tickAt;
+		size_t m_chunk;
+		std::deque<OPCUA_PollResponse_t> m_responses;
+		size_t m_maxResponses;
+		std::vector<OPCUA_Record_t> m_records;
+		std::atomic<UA_StatusCode> m_status;
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		std::atomic<bool> m_running;
+		std::thread m_thread;
+	};
+
+}
+
+#endif // POLLER_H
\ No newline at end of file
@@ -0,0 +1,632 @@
+#include "opcua_session.h"
+#include <algorithm>
+#include "../macros.h"
+#include "opcua_client.h"
+#include "opcua_subscription.h"
+#include "opcua_group.h"
+#include "opcua_nodetable.h"
+#include "opcua_tagstore.h"
+#include "../sink/sink_fanout.h"
+#include "../util/metrics.h"
+#include "../util/arena.h"
+
+namespace gateway
+{
+
+	OPCUA_Session::OPCUA_Session(
+		OPCUA_Client * const client,
+		uint32_t index
+	) :
+		m_client(client),
+		m_index(index),
+		m_uaClient(NULL),
+		m_subscriptionId(0),
+		m_tuning(),
+		m_requested(),
+		m_reason(),
+		m_retune(false),
+		m_acks(),
+		m_lastSequence(0),
+		m_maxRepublish(256),
+		m_stats(),
+		m_handles(),
+		m_status(UA_STATUSCODE_GOOD),
+		m_responses(),
+		m_records(),
+		m_maxResponses(64),
+		m_mutex(),
+		m_condition(),
+		m_running(false),
+		m_thread()
+	{
+		m_uaClient = UA_Client_new(UA_ClientConfig_standard);
+
+		// Start from the configured values, the tuner may adjust them later on
+		m_tuning.publishInterval = m_client->getSubPublishInterval();
+		m_tuning.maxNotificationsPerPublish = m_client->getSubMaxNotificationsPerPublish();
+	}
+
+	OPCUA_Session::~OPCUA_Session()
+	{
+		join();
+
+		for (UA_PublishResponse * response : m_responses)
+			UA_PublishResponse_delete(response);
+
+		// Remove the UA_Subscription along with its monitored items
+		if (m_subscriptionId != 0 && UA_Client_getState(m_uaClient) == UA_CLIENTSTATE_CONNECTED)
+		{
+			UA_DeleteSubscriptionsRequest request;
+			UA_DeleteSubscriptionsRequest_init(&request);
+			request.subscriptionIdsSize = 1;
+			request.subscriptionIds = &m_subscriptionId;
+
+			UA_DeleteSubscriptionsResponse response = UA_Client_Service_deleteSubscriptions(m_uaClient, request);
+			UA_DeleteSubscriptionsResponse_deleteMembers(&response);
+		}
+
+		UA_Client_disconnect(m_uaClient);
+		UA_Client_delete(m_uaClient);
+	}
+
+	UA_StatusCode OPCUA_Session::connect()
+	{
+		m_status = m_client->connect(m_uaClient);
+		return m_status;
+	}
+
+	void OPCUA_Session::reset()
+	{
+		join();
+
+		// Drop the old session and secure channel, the subscription and its retransmission queue die with them
+		UA_Client_reset(m_uaClient);
+		m_subscriptionId = 0;
+		m_acks.clear();
+		m_lastSequence = 0;
+		m_retune = false;
+		m_status = UA_STATUSCODE_GOOD;
+	}
+
+	UA_StatusCode OPCUA_Session::createSubscription()
+	{
+		UA_CreateSubscriptionRequest request;
+		UA_CreateSubscriptionRequest_init(&request);
+		request.requestedPublishingInterval = m_tuning.publishInterval;
+		request.requestedLifetimeCount = m_client->getSubLifetimeCount();
+		request.requestedMaxKeepAliveCount = m_client->getSubMaxKeepAliveCount();
+		request.maxNotificationsPerPublish = m_tuning.maxNotificationsPerPublish;
+		request.publishingEnabled = m_client->isSubPublishEnabled();
+		request.priority = m_client->getSubPublishPriority();
+
+		UA_CreateSubscriptionResponse response = UA_Client_Service_createSubscription(m_uaClient, request);
+		UA_StatusCode status = response.responseHeader.serviceResult;
+
+		if (status == UA_STATUSCODE_GOOD)
+		{
+			m_subscriptionId = response.subscriptionId;
+			m_tuning.publishInterval = response.revisedPublishingInterval;
+			m_lastSequence = 0;
+		}
+
+		UA_CreateSubscriptionResponse_deleteMembers(&response);
+
+		return status;
+	}
+
+	UA_StatusCode OPCUA_Session::modifySubscription(const OPCUA_Tuning_t & tuning)
+	{
+		// Called by the publish thread while it runs, it must not share the UA_Client with another service call
+		UA_ModifySubscriptionRequest request;
+		UA_ModifySubscriptionRequest_init(&request);
+		request.subscriptionId = m_subscriptionId;
+		request.requestedPublishingInterval = tuning.publishInterval;
+		request.requestedLifetimeCount = m_client->getSubLifetimeCount();
+		request.requestedMaxKeepAliveCount = m_client->getSubMaxKeepAliveCount();
+		request.maxNotificationsPerPublish = tuning.maxNotificationsPerPublish;
+		request.priority = m_client->getSubPublishPriority();
+
+		UA_ModifySubscriptionResponse response = UA_Client_Service_modifySubscription(m_uaClient, request);
+		UA_StatusCode status = response.responseHeader.serviceResult;
+
+		if (status == UA_STATUSCODE_GOOD)
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_tuning.publishInterval = response.revisedPublishingInterval;
+			m_tuning.maxNotificationsPerPublish = tuning.maxNotificationsPerPublish;
+		}
+
+		UA_ModifySubscriptionResponse_deleteMembers(&response);
+
+		return status;
+	}
+
+	void OPCUA_Session::tune(const OPCUA_Tuner & tuner)
+	{
+		OPCUA_SessionStats_t stats = takeStats();
+		OPCUA_Tuning_t tuning;
+		std::string reason;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			tuning = m_tuning;
+		}
+
+		// Fill of the dispatch queue or the egress queues, whichever is further behind
+		double backlog = std::max((double) stats.maxQueued / m_maxResponses, m_client->getSinks()->getLoad());
+
+		if (tuner.evaluate(stats, backlog, tuning, reason) == false)
+		{
+			LOG("OPCUA_Session serverId(%d) session(%u) tuning kept interval %.0f ms, %u per publish: %s\n", UA_DateTime_now(), m_client->getServerId(), m_index, tuning.publishInterval, tuning.maxNotificationsPerPublish, reason.c_str());
+			return;
+		}
+
+		// The publish thread applies the change before its next publish request, a later evaluation replaces a pending one
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_requested = tuning;
+			m_reason = reason;
+			m_retune = true;
+		}
+		m_condition.notify_all();
+	}
+
+	void OPCUA_Session::retune(const OPCUA_Tuning_t & tuning, const std::string & reason)
+	{
+		OPCUA_Tuning_t previous = m_tuning;
+		UA_StatusCode status = modifySubscription(tuning);
+
+		if (status != UA_STATUSCODE_GOOD)
+		{
+			WRN("OPCUA_Session serverId(%d) session(%u) tuning failed to modify subscription, status: 0x%08x\n", UA_DateTime_now(), m_client->getServerId(), m_index, status);
+			return;
+		}
+
+		Metrics::instance().add(metricname("opcua", m_client->getServerId(), "tunings"));
+
+		LOG("OPCUA_Session serverId(%d) session(%u) tuning changed interval %.0f -> %.0f ms, %u -> %u per publish: %s\n", UA_DateTime_now(), m_client->getServerId(), m_index,
+			previous.publishInterval, m_tuning.publishInterval, previous.maxNotificationsPerPublish, m_tuning.maxNotificationsPerPublish, reason.c_str());
+	}
+
+	OPCUA_SessionStats_t OPCUA_Session::takeStats()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		OPCUA_SessionStats_t stats = m_stats;
+		m_stats = OPCUA_SessionStats_t();
+		return stats;
+	}
+
+	UA_StatusCode OPCUA_Session::add(const std::vector<uint32_t> & handles)
+	{
+		m_handles.insert(m_handles.end(), handles.begin(), handles.end());
+
+		// The publish thread must not share the UA_Client with the service calls
+		bool running = m_running;
+		join();
+
+		UA_StatusCode status = link(handles);
+
+		if (running && status == UA_STATUSCODE_GOOD)
+			start();
+
+		return status;
+	}
+
+	UA_StatusCode OPCUA_Session::relink()
+	{
+		return link(m_handles);
+	}
+
+	UA_StatusCode OPCUA_Session::link(const std::vector<uint32_t> & handles)
+	{
+		OPCUA_TagStore * tags = m_client->getTagStore();
+		OPCUA_NodeTable * nodes = m_client->getNodeTable();
+
+		// Servers limit the amount of items per call, send in chunks
+		const size_t n_chunk = 1000;
+
+		// Items whose deadband filter got rejected are retried without one
+		std::vector<uint32_t> retry;
+
+		for (size_t i = 0; i < handles.size(); i += n_chunk)
+		{
+			size_t n_items = std::min(n_chunk, handles.size() - i);
+			std::vector<UA_MonitoredItemCreateRequest> items(n_items);
+			std::vector<UA_DataChangeFilter> filters(n_items);
+
+			for (size_t j = 0; j < n_items; j++)
+			{
+				uint32_t handle = handles[i + j];
+				const OPCUA_ItemSettings_t & settings = tags->getItemSettings(handle);
+
+				UA_MonitoredItemCreateRequest & item = items[j];
+				UA_MonitoredItemCreateRequest_init(&item);
+				item.itemToMonitor.nodeId = nodes->getNodeId(tags->getNode(handle));
+				item.itemToMonitor.attributeId = UA_ATTRIBUTEID_VALUE;
+				item.monitoringMode = UA_MONITORINGMODE_REPORTING;
+				item.requestedParameters.clientHandle = handle;
+				item.requestedParameters.samplingInterval = (settings.samplingInterval < 0.0) ? m_client->getSubPublishInterval() : settings.samplingInterval;
+				item.requestedParameters.discardOldest = settings.discardOldest;
+				item.requestedParameters.queueSize = settings.queueSize;
+
+				// Server side deadband, only report changes that exceed it
+				if (settings.deadbandType != OPCUA_DEADBAND_NONE)
+				{
+					UA_DataChangeFilter & filter = filters[j];
+					UA_DataChangeFilter_init(&filter);
+					filter.trigger = UA_DATACHANGETRIGGER_STATUSVALUE;
+					filter.deadbandType = (UA_UInt32) settings.deadbandType;
+					filter.deadbandValue = settings.deadbandValue;
+
+					item.requestedParameters.filter.encoding = UA_ExtensionObject::UA_EXTENSIONOBJECT_DECODED_NODELETE;
+					item.requestedParameters.filter.content.decoded.type = &UA_TYPES[UA_TYPES_DATACHANGEFILTER];
+					item.requestedParameters.filter.content.decoded.data = &filter;
+				}
+			}
+
+			UA_CreateMonitoredItemsRequest request;
+			UA_CreateMonitoredItemsRequest_init(&request);
+			request.subscriptionId = m_subscriptionId;
+			request.timestampsToReturn = UA_TIMESTAMPSTORETURN_BOTH;
+			request.itemsToCreateSize = n_items;
+			request.itemsToCreate = items.data();
+
+			UA_CreateMonitoredItemsResponse response = UA_Client_Service_createMonitoredItems(m_uaClient, request);
+			UA_StatusCode status = response.responseHeader.serviceResult;
+
+			if (status == UA_STATUSCODE_GOOD && response.resultsSize != n_items)
+				status = UA_STATUSCODE_BADUNEXPECTEDERROR;
+
+			if (status != UA_STATUSCODE_GOOD)
+			{
+				UA_CreateMonitoredItemsResponse_deleteMembers(&response);
+				return status;
+			}
+
+			// Store the links, failing items are logged and left unlinked
+			for (size_t j = 0; j < n_items; j++)
+			{
+				uint32_t handle = handles[i + j];
+				UA_MonitoredItemCreateResult & result = response.results[j];
+
+				if (result.statusCode == UA_STATUSCODE_GOOD)
+				{
+					tags->setLink(handle, m_subscriptionId, result.monitoredItemId);
+				}
+				else if (tags->getItemSettings(handle).deadbandType != OPCUA_DEADBAND_NONE && (
+					result.statusCode == UA_STATUSCODE_BADFILTERNOTALLOWED ||
+					result.statusCode == UA_STATUSCODE_BADMONITOREDITEMFILTERUNSUPPORTED ||
+					result.statusCode == UA_STATUSCODE_BADMONITOREDITEMFILTERINVALID ||
+					result.statusCode == UA_STATUSCODE_BADDEADBANDFILTERINVALID))
+				{
+					// Eg. a percent deadband on a node without EURange or a non-numeric node
+					WRN("OPCUA_Session serverId(%d) session(%u) deadband rejected for %s, status: 0x%08x, linking without it\n", UA_DateTime_now(), m_client->getServerId(), m_index, nodes->getIdentifier(tags->getNode(handle)).c_str(), result.statusCode);
+					tags->dropDeadband(handle);
+					retry.push_back(handle);
+				}
+				else
+				{
+					WRN("OPCUA_Session serverId(%d) session(%u) could not link %s, status: 0x%08x\n", UA_DateTime_now(), m_client->getServerId(), m_index, nodes->getIdentifier(tags->getNode(handle)).c_str(), result.statusCode);
+				}
+			}
+
+			UA_CreateMonitoredItemsResponse_deleteMembers(&response);
+		}
+
+		if (retry.empty() == false)
+			return link(retry);
+
+		return UA_STATUSCODE_GOOD;
+	}
+
+	void OPCUA_Session::start()
+	{
+		if (m_running || m_handles.empty())
+			return;
+
+		// A thread stopped without waiting has returned by now, reset() joined it
+		if (m_thread.joinable())
+			m_thread.join();
+
+		m_status = UA_STATUSCODE_GOOD;
+		m_running = true;
+		m_thread = std::thread(&OPCUA_Session::run, this);
+	}
+
+	void OPCUA_Session::stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_running = false;
+		}
+		m_condition.notify_all();
+
+		// An outstanding publish request returns within the client timeout, the thread ends then without blocking the caller
+	}
+
+	void OPCUA_Session::join()
+	{
+		stop();
+
+		if (m_thread.joinable())
+			m_thread.join();
+	}
+
+	void OPCUA_Session::run()
+	{
+		bool more = false;
+
+		while (m_running)
+		{
+			OPCUA_Tuning_t tuning;
+			std::string reason;
+			bool retuning = false;
+
+			// Stop publishing while the main thread is behind on dispatching
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_condition.wait(lock, [this] { return m_running == false || m_responses.size() < m_maxResponses; });
+
+				if (m_running == false)
+					break;
+
+				// The server has more notifications queued, the next publish request goes out right away
+				if (m_retune && more == false)
+				{
+					tuning = m_requested;
+					reason.swap(m_reason);
+					retuning = true;
+					m_retune = false;
+				}
+			}
+
+			if (retuning)
+				retune(tuning, reason);
+
+			// Acknowledge everything received with the previous response
+			UA_PublishRequest request;
+			UA_PublishRequest_init(&request);
+			request.subscriptionAcknowledgementsSize = m_acks.size();
+			request.subscriptionAcknowledgements = m_acks.empty() ? NULL : m_acks.data();
+
+			UA_PublishResponse * response = UA_PublishResponse_new();
+			*response = UA_Client_Service_publish(m_uaClient, request);
+			m_acks.clear();
+
+			UA_StatusCode status = response->responseHeader.serviceResult;
+
+			// Lost the session or connection, OPCUA_Client picks the status up in dispatch()
+			if (status != UA_STATUSCODE_GOOD || UA_Client_getState(m_uaClient) == UA_CLIENTSTATE_ERRORED)
+			{
+				m_status = (status != UA_STATUSCODE_GOOD) ? status : UA_STATUSCODE_BADCONNECTIONCLOSED;
+				m_running = false;
+				UA_PublishResponse_delete(response);
+				break;
+			}
+
+			UA_NotificationMessage & message = response->notificationMessage;
+			bool keepAlive = (message.notificationDataSize == 0);
+			more = response->moreNotifications;
+
+			// A keep-alive carries the next sequence number, a data message its own one. Anything
+			// between the last one seen and this is missing, numbers wrap around to 1 after 2^32 - 1
+			if (m_lastSequence != 0 && message.sequenceNumber != 0)
+			{
+				uint32_t expected = (m_lastSequence == UINT32_MAX) ? 1 : m_lastSequence + 1;
+				uint32_t missing = message.sequenceNumber - expected;
+
+				if (message.sequenceNumber < expected)
+					missing--;
+
+				// Older or repeated numbers are not a gap
+				if (missing > 0 && missing < 0x80000000)
+					recover(response->subscriptionId, expected, missing);
+			}
+
+			if (message.sequenceNumber != 0)
+				m_lastSequence = keepAlive ? message.sequenceNumber - 1 : message.sequenceNumber;
+
+			// Keep-alive messages carry no sequence number to acknowledge nor data to dispatch
+			if (keepAlive)
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stats.publishes++;
+				UA_PublishResponse_delete(response);
+				continue;
+			}
+
+			m_acks.push_back({ response->subscriptionId, message.sequenceNumber });
+
+			// Delivery lag, how long the values waited in the server before this response. Both
+			// timestamps come from the server clock, unlike the round trip it does not grow while
+			// the server holds the request back for lack of data
+			size_t n_notifications = 0;
+			size_t n_lagged = 0;
+			double lag = 0.0;
+			UA_DateTime respondedAt = response->responseHeader.timestamp;
+			for (size_t i = 0; i < message.notificationDataSize; i++)
+			{
+				UA_ExtensionObject & data = message.notificationData[i];
+
+				if (data.encoding != UA_ExtensionObject::UA_EXTENSIONOBJECT_DECODED || data.content.decoded.type != &UA_TYPES[UA_TYPES_DATACHANGENOTIFICATION])
+					continue;
+
+				UA_DataChangeNotification * dataChange = (UA_DataChangeNotification *) data.content.decoded.data;
+				n_notifications += dataChange->monitoredItemsSize;
+
+				for (size_t j = 0; j < dataChange->monitoredItemsSize && respondedAt != 0; j++)
+				{
+					const UA_DataValue & value = dataChange->monitoredItems[j].value;
+
+					if (value.hasServerTimestamp && value.serverTimestamp <= respondedAt)
+					{
+						lag += (double)(respondedAt - value.serverTimestamp) / UA_MSEC_TO_DATETIME;
+						n_lagged++;
+					}
+				}
+			}
+
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_stats.publishes++;
+			m_stats.dataPublishes++;
+			m_stats.notifications += n_notifications;
+			m_stats.moreNotifications += response->moreNotifications ? 1 : 0;
+			if (n_lagged > 0)
+			{
+				m_stats.lag += lag / n_lagged;
+				m_stats.laggedPublishes++;
+			}
+			queue(lock, response);
+		}
+	}
+
+	void OPCUA_Session::queue(std::unique_lock<std::mutex> & lock, UA_PublishResponse * response)
+	{
+		// Holds the publish thread until dispatch() made room, on stop the destructor frees what is queued
+		m_condition.wait(lock, [this] { return m_running == false || m_responses.size() < m_maxResponses; });
+		m_responses.push_back(response);
+		m_stats.maxQueued = std::max(m_stats.maxQueued, m_responses.size());
+	}
+
+	void OPCUA_Session::recover(uint32_t subscriptionId, uint32_t first, uint32_t count)
+	{
+		uint32_t n_recovered = 0;
+		uint32_t sequence = first;
+
+		// Fetch the missing messages one by one from the retransmission queue of the server
+		for (uint32_t i = 0; i < count && i < m_maxRepublish && m_running; i++)
+		{
+			UA_RepublishRequest request;
+			UA_RepublishRequest_init(&request);
+			request.subscriptionId = subscriptionId;
+			request.retransmitSequenceNumber = sequence;
+
+			UA_RepublishResponse response;
+			__UA_Client_Service(m_uaClient, &request, &UA_TYPES[UA_TYPES_REPUBLISHREQUEST], &response, &UA_TYPES[UA_TYPES_REPUBLISHRESPONSE]);
+
+			// Wrap the message like a publish response, so dispatch() handles both alike
+			if (response.responseHeader.serviceResult == UA_STATUSCODE_GOOD)
+			{
+				UA_PublishResponse * republished = UA_PublishResponse_new();
+				republished->subscriptionId = subscriptionId;
+				republished->notificationMessage = response.notificationMessage;
+				UA_NotificationMessage_init(&response.notificationMessage);
+
+				// Queued ahead of the response that revealed the gap, within the bound of the queue
+				{
+					std::unique_lock<std::mutex> lock(m_mutex);
+					queue(lock, republished);
+				}
+				m_acks.push_back({ subscriptionId, sequence });
+				n_recovered++;
+			}
+
+			UA_RepublishResponse_deleteMembers(&response);
+			sequence = (sequence == UINT32_MAX) ? 1 : sequence + 1;
+		}
+
+		Metrics::instance().add(metricname("opcua", m_client->getServerId(), "sequence_gaps"));
+		Metrics::instance().add(metricname("opcua", m_client->getServerId(), "sequences_missed"), (double) count);
+		Metrics::instance().add(metricname("opcua", m_client->getServerId(), "sequences_recovered"), (double) n_recovered);
+
+		if (n_recovered < count)
+			WRN("OPCUA_Session serverId(%d) session(%u) lost %u of %u notification messages from sequence number %u\n", UA_DateTime_now(), m_client->getServerId(), m_index, count - n_recovered, count, first);
+		else
+			LOG("OPCUA_Session serverId(%d) session(%u) recovered %u notification messages from sequence number %u\n", UA_DateTime_now(), m_client->getServerId(), m_index, count, first);
+	}
+
+	UA_StatusCode OPCUA_Session::dispatch()
+	{
+		std::deque<UA_PublishResponse *> responses;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			responses.swap(m_responses);
+		}
+		m_condition.notify_all();
+
+		size_t n_tags = m_client->getTagStore()->size();
+		size_t n_notifications = 0;
+
+		for (UA_PublishResponse * response : responses)
+		{
+			UA_NotificationMessage & message = response->notificationMessage;
+
+			for (size_t i = 0; i < message.notificationDataSize; i++)
+			{
+				UA_ExtensionObject & data = message.notificationData[i];
+
+				if (data.encoding != UA_ExtensionObject::UA_EXTENSIONOBJECT_DECODED || data.content.decoded.type != &UA_TYPES[UA_TYPES_DATACHANGENOTIFICATION])
+					continue;
+
+				UA_DataChangeNotification * dataChange = (UA_DataChangeNotification *) data.content.decoded.data;
+
+				for (size_t j = 0; j < dataChange->monitoredItemsSize; j++)
+				{
+					UA_MonitoredItemNotification & item = dataChange->monitoredItems[j];
+
+					if (item.clientHandle >= n_tags)
+						continue;
+
+					m_records.push_back({ item.clientHandle, &item.value });
+				}
+			}
+
+			// The whole response is handed off as one batch
+			if (m_records.empty() == false)
+			{
+				OPCUA_Callback_DataChanges(m_client, m_records.data(), m_records.size());
+				n_notifications += m_records.size();
+				m_records.clear();
+			}
+
+			// Everything built for this response has been handed off
+			m_client->getArena().reset();
+			UA_PublishResponse_delete(response);
+		}
+
+		if (n_notifications > 0)
+			Metrics::instance().add(metricname("opcua", m_client->getServerId(), "notifications"), (double) n_notifications);
+
+		return m_status;
+	}
+
+	OPCUA_Client * OPCUA_Session::getClient()
+	{
+		return m_client;
+	}
+
+	UA_Client * OPCUA_Session::getUaClient()
+	{
+		return m_uaClient;
+	}
+
+	uint32_t OPCUA_Session::getIndex() const
+	{
+		return m_index;
+	}
+
+	uint32_t OPCUA_Session::getSubscriptionId() const
+	{
+		return m_subscriptionId;
+	}
+
+	const OPCUA_Tuning_t & OPCUA_Session::getTuning() const
+	{
+		return m_tuning;
+	}
+
+	const std::vector<uint32_t> & OPCUA_Session::getHandles() const
+	{
+		return m_handles;
+	}
+
+	UA_StatusCode OPCUA_Session::getStatus() const
+	{
+		return m_status;
+	}
+
+	bool OPCUA_Session::isRunning() const
+	{
+		return m_running;
+	}
+
+}
\ No newline at end of file
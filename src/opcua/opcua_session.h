@@ -0,0 +1,90 @@
+#ifndef SESSION_H
+#define SESSION_H
+
+#include <string>
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <open62541.h>
+#include "opcua_tuner.h"
+#include "opcua_subscription.h"
+
+namespace gateway
+{
+
+	class OPCUA_Client;
+
+	// A data session of an OPCUA_Client: its own UA_Client connection with one
+	// UA subscription holding a shard of the monitored items. The publish loop
+	// runs on a thread of its own, received responses are queued and handed to
+	// the callbacks by dispatch() on the main thread. Sequence numbers skipped
+	// by the server are fetched again with the Republish service, only within
+	// a session: reset() closes the session and its subscription with it, so
+	// what the server had not delivered before a reconnect cannot be asked
+	// for again and the numbering starts over. While the
+	// thread runs it owns the UA_Client, tuning changes are applied by it
+	// between two publish requests and stop() does not wait for it.
+	class OPCUA_Session
+	{
+	public:
+		OPCUA_Session(
+			OPCUA_Client * const client,
+			uint32_t index
+		);
+		~OPCUA_Session();
+		UA_StatusCode connect();
+		void reset();
+		UA_StatusCode createSubscription();
+		UA_StatusCode modifySubscription(const OPCUA_Tuning_t & tuning);
+		void tune(const OPCUA_Tuner & tuner);
+		OPCUA_SessionStats_t takeStats();
+		UA_StatusCode add(const std::vector<uint32_t> & handles);
+		UA_StatusCode relink();
+		void start();
+		void stop();
+		UA_StatusCode dispatch();
+		OPCUA_Client * getClient();
+		UA_Client * getUaClient();
+		uint32_t getIndex() const;
+		uint32_t getSubscriptionId() const;
+		const OPCUA_Tuning_t & getTuning() const;
+		const std::vector<uint32_t> & getHandles() const;
+		UA_StatusCode getStatus() const;
+		bool isRunning() const;
+	private:
+		UA_StatusCode link(const std::vector<uint32_t> & handles);
+		void retune(const OPCUA_Tuning_t & tuning, const std::string & reason);
+		void join();
+		void run();
+		void recover(uint32_t subscriptionId, uint32_t first, uint32_t count);
+		void queue(std::unique_lock<std::mutex> & lock, UA_PublishResponse * response);
+		OPCUA_Client * m_client;
+		uint32_t m_index;
+		UA_Client * m_uaClient;
+		uint32_t m_subscriptionId;
+		OPCUA_Tuning_t m_tuning;
+		OPCUA_Tuning_t m_requested;
+		std::string m_reason;
+		bool m_retune;
+		std::vector<UA_SubscriptionAcknowledgement> m_acks;
+		uint32_t m_lastSequence;
+		uint32_t m_maxRepublish;
+		OPCUA_SessionStats_t m_stats;
+		std::vector<uint32_t> m_handles;
+		std::atomic<UA_StatusCode> m_status;
+		std::deque<UA_PublishResponse *> m_responses;
+		std::vector<OPCUA_Record_t> m_records;
+		size_t m_maxResponses;
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		std::atomic<bool> m_running;
+		std::thread m_thread;
+	};
+
+}
+
+#endif // SESSION_H
\ No newline at end of file
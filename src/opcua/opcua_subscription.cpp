@@ -1,8 +1,23 @@
 #include "opcua_subscription.h"
+#include <algorithm>
+#include <cmath>
 #include <open62541.h>
 #include "../macros.h"
 #include "opcua_client.h"
+#include "opcua_nodetable.h"
+#include "opcua_tagstore.h"
+#include "opcua_aggregator.h"
+#include "opcua_compressor.h"
 #include "../http/http_client.h"
+#include "../http/http_registrar.h"
+#include "../sink/sink_fanout.h"
+#include "../sink/sink_dictionary.h"
+#include "../codec/codec_binary.h"
+#include "../store/store_timeseries.h"
+#include "../util/strutils.h"
+#include "../util/arena.h"
+#include "../util/payload.h"
+#include "../util/jsonwriter.h"
 #include "../3rdparty/json.hpp"
 
 // For convenience
@@ -11,241 +26,744 @@ using json = nlohmann::json;
 namespace gateway
 {
 
-	// UA_DateTime -> JSON ISO 8601 DateTime conversion
-	std::string UADateTimeToJSONDateTime(UA_DateTime datetime = UA_DateTime_now())
+	// UA_DateTime -> JSON ISO 8601 DateTime conversion, returns the length written to buffer
+	int UADateTimeToJSONDateTime(UA_DateTime datetime, char * buffer, size_t size)
 	{
 		// Convert datetime to struct
 		UA_DateTimeStruct datetime_struct = UA_DateTime_toStruct(datetime);
 
 		// Print to char buffer
-		char buffer[255];
-		snprintf(buffer, 255, "%04u-%02u-%02uT%02u:%02u:%02u.%03uZ",
+		return snprintf(buffer, size, "%04u-%02u-%02uT%02u:%02u:%02u.%03uZ",
 			datetime_struct.year, datetime_struct.month, datetime_struct.day,
 			datetime_struct.hour, datetime_struct.min, datetime_struct.sec,
 			datetime_struct.milliSec
 		);
+	}
+
+	// UA_Variant array -> JSON conversion, the whole array is converted in one pass
+	template<typename T>
+	void UAArrayToJSON(JsonWriter<ArenaString> & writer, const UA_Variant & variant, const char * type, OPCUA_ArrayEncoding_t encoding)
+	{
+		const T * data = (const T *) variant.data;
+		size_t length = variant.arrayLength;
+
+		writer.key("value");
+
+		// Raw little-endian element bytes, base64 encoded
+		if (encoding == OPCUA_ARRAY_BINARY)
+		{
+			std::string encoded = base64encode((const uint8_t *) data, length * sizeof(T));
+			writer.string(encoded.data(), encoded.size());
+			writer.key("encoding").string("base64");
+		}
+		else
+		{
+			writer.beginArray();
+			for (size_t i = 0; i < length; i++)
+				writer.value(data[i]);
+			writer.endArray();
+		}
+
+		char array_type[32];
+		writer.key("type").string(array_type, snprintf(array_type, sizeof(array_type), "%s[]", type));
 
-		return std::string(buffer);
+		// Matrices keep their dimensions, the data itself is flattened in row-major order
+		if (variant.arrayDimensionsSize > 1)
+		{
+			writer.key("dimensions").beginArray();
+			for (size_t i = 0; i < variant.arrayDimensionsSize; i++)
+				writer.value(variant.arrayDimensions[i]);
+			writer.endArray();
+		}
 	}
 
-	void OPCUA_Callback_MonitoredItem(
-		UA_UInt32 monId,
-		UA_DataValue * value,
-		void * context
-	)
+	// UA_Variant numeric scalar -> double, for the last value of a tag
+	bool UAScalarToDouble(const UA_Variant & variant, double & result)
 	{
-		// Get the subscription instance
-		OPCUA_Subscription * sub = (OPCUA_Subscription *)context;
+		switch (variant.type->typeIndex)
+		{
+		case UA_TYPES_BOOLEAN: result = *(UA_Boolean *) variant.data ? 1.0 : 0.0; return true;
+		case UA_TYPES_SBYTE: result = *(UA_SByte *) variant.data; return true;
+		case UA_TYPES_INT16: result = *(UA_Int16 *) variant.data; return true;
+		case UA_TYPES_INT32: result = *(UA_Int32 *) variant.data; return true;
+		case UA_TYPES_INT64: result = (double) *(UA_Int64 *) variant.data; return true;
+		case UA_TYPES_BYTE: result = *(UA_Byte *) variant.data; return true;
+		case UA_TYPES_UINT16: result = *(UA_UInt16 *) variant.data; return true;
+		case UA_TYPES_UINT32: result = *(UA_UInt32 *) variant.data; return true;
+		case UA_TYPES_UINT64: result = (double) *(UA_UInt64 *) variant.data; return true;
+		case UA_TYPES_FLOAT: result = *(UA_Float *) variant.data; return true;
+		case UA_TYPES_DOUBLE: result = *(UA_Double *) variant.data; return true;
+		default: return false;
+		}
+	}
 
-		// Build the JSON object
-		json jsonThis;
-		jsonThis["identifier"] = sub->getIdentifier();
-		jsonThis["nsIndex"] = sub->getNsIndex();
-		jsonThis["serverId"] = sub->getClient()->getServerId();
-		jsonThis["serverTimeStamp"] = UADateTimeToJSONDateTime(value->sourceTimestamp);
+	// A point archived by the compressor as a data value of the type of its tag
+	struct OPCUA_ArchivedValue_t
+	{
+		UA_DataValue value;
+		union
+		{
+			UA_Boolean b;
+			UA_SByte i8;
+			UA_Int16 i16;
+			UA_Int32 i32;
+			UA_Int64 i64;
+			UA_Byte u8;
+			UA_UInt16 u16;
+			UA_UInt32 u32;
+			UA_UInt64 u64;
+			UA_Float f;
+			UA_Double d;
+		} data;
+	};
 
-		if (value->hasValue)
+	// double -> UA_Variant numeric scalar of the given type, the inverse of UAScalarToDouble, unknown types stay double
+	void UADoubleToScalar(double value, uint16_t type, OPCUA_ArchivedValue_t & archived)
+	{
+		switch (type)
 		{
+		case UA_TYPES_BOOLEAN: archived.data.b = value >= 0.5; break;
+		case UA_TYPES_SBYTE: archived.data.i8 = (UA_SByte) std::llround(value); break;
+		case UA_TYPES_INT16: archived.data.i16 = (UA_Int16) std::llround(value); break;
+		case UA_TYPES_INT32: archived.data.i32 = (UA_Int32) std::llround(value); break;
+		case UA_TYPES_INT64: archived.data.i64 = (UA_Int64) std::llround(value); break;
+		case UA_TYPES_BYTE: archived.data.u8 = (UA_Byte) std::llround(std::max(value, 0.0)); break;
+		case UA_TYPES_UINT16: archived.data.u16 = (UA_UInt16) std::llround(std::max(value, 0.0)); break;
+		case UA_TYPES_UINT32: archived.data.u32 = (UA_UInt32) std::llround(std::max(value, 0.0)); break;
+		case UA_TYPES_UINT64: archived.data.u64 = (UA_UInt64) std::llround(std::max(value, 0.0)); break;
+		case UA_TYPES_FLOAT: archived.data.f = (UA_Float) value; break;
+		default: type = UA_TYPES_DOUBLE; archived.data.d = value; break;
+		}
+
+		UA_Variant_setScalar(&archived.value.value, &archived.data, &UA_TYPES[type]);
+	}
+
+	// Appends the JSON object of one value to the writer, returns false for types without a JSON mapping
+	bool UADataValueToJSON(OPCUA_Client * const client, uint32_t node, const UA_DataValue * value, JsonWriter<ArenaString> & writer)
+	{
+		OPCUA_NodeTable * nodes = client->getNodeTable();
+		char buffer[64];
+
+		writer.beginObject();
+
+		UA_NodeId nodeId = nodes->getNodeId(node);
+		if (nodeId.identifierType == UA_NODEIDTYPE_STRING)
+		{
+			writer.key("identifier").string((const char *) nodeId.identifier.string.data, nodeId.identifier.string.length);
+		}
+		else
+		{
+			std::string identifier = nodes->getIdentifier(node);
+			writer.key("identifier").string(identifier.data(), identifier.size());
+		}
+
+		writer.key("nsIndex").value((uint32_t) nodeId.namespaceIndex);
+		writer.key("serverId").value((int32_t) client->getServerId());
+		writer.key("serverTimeStamp").string(buffer, UADateTimeToJSONDateTime(value->sourceTimestamp, buffer, sizeof(buffer)));
+
+		if (UA_Variant_isScalar(&value->value))
+		{
+			writer.key("value");
+
 			switch (value->value.type->typeIndex)
 			{
 			case UA_TYPES_STRING:
-			{
-				UA_String value_str = *(UA_String *)value->value.data;
-				jsonThis["value"] = std::string(value_str.data, value_str.data + value_str.length);
-				jsonThis["type"] = "string";
-			} break;
 			case UA_TYPES_BYTESTRING:
 			{
-				UA_ByteString value_str = *(UA_ByteString *)value->value.data;
-				jsonThis["value"] = std::string(value_str.data, value_str.data + value_str.length);
-				jsonThis["type"] = "string";
+				UA_String value_str = *(UA_String *)value->value.data;
+				writer.string((const char *) value_str.data, value_str.length).key("type").string("string");
 			} break;
 			case UA_TYPES_LOCALIZEDTEXT:
 			{
 				UA_String value_str = (*(UA_LocalizedText *)value->value.data).text;
-				jsonThis["value"] = std::string(value_str.data, value_str.data + value_str.length);
-				jsonThis["type"] = "string";
+				writer.string((const char *) value_str.data, value_str.length).key("type").string("string");
 			} break;
 			case UA_TYPES_DATETIME:
 			{
-				jsonThis["value"] = UADateTimeToJSONDateTime(*(UA_DateTime *)value->value.data);
-				jsonThis["type"] = "datetime";
-			} break;
-			case UA_TYPES_BOOLEAN:
-			{
-				jsonThis["value"] = *(UA_Boolean *)value->value.data == UA_TRUE ? true : false;
-				jsonThis["type"] = "bool";
-			} break;
-			case UA_TYPES_STATUSCODE:
-			{
-				jsonThis["value"] = *(UA_UInt32 *)value->value.data;
-				jsonThis["type"] = "uint32_t";
-			} break;
-			case UA_TYPES_SBYTE:
-			{
-				jsonThis["value"] = *(UA_SByte *)value->value.data;
-				jsonThis["type"] = "int8_t";
-			} break;
-			case UA_TYPES_INT16:
-			{
-				jsonThis["value"] = *(UA_Int16 *)value->value.data;
-				jsonThis["type"] = "int16_t";
-			} break;
-			case UA_TYPES_INT32:
-			{
-				jsonThis["value"] = *(UA_Int32 *)value->value.data;
-				jsonThis["type"] = "int32_t";
-			} break;
-			case UA_TYPES_INT64:
-			{
-				jsonThis["value"] = *(UA_Int64 *)value->value.data;
-				jsonThis["type"] = "int64_t";
+				writer.string(buffer, UADateTimeToJSONDateTime(*(UA_DateTime *)value->value.data, buffer, sizeof(buffer))).key("type").string("datetime");
 			} break;
-			case UA_TYPES_BYTE:
-			{
-				jsonThis["value"] = *(UA_Byte *)value->value.data;
-				jsonThis["type"] = "uint8_t";
-			} break;
-			case UA_TYPES_UINT16:
-			{
-				jsonThis["value"] = *(UA_UInt16 *)value->value.data;
-				jsonThis["type"] = "uint16_t";
-			} break;
-			case UA_TYPES_UINT32:
+			case UA_TYPES_BOOLEAN: writer.value(*(UA_Boolean *)value->value.data == UA_TRUE).key("type").string("bool"); break;
+			case UA_TYPES_STATUSCODE: writer.value(*(UA_UInt32 *)value->value.data).key("type").string("uint32_t"); break;
+			case UA_TYPES_SBYTE: writer.value((int32_t) *(UA_SByte *)value->value.data).key("type").string("int8_t"); break;
+			case UA_TYPES_INT16: writer.value((int32_t) *(UA_Int16 *)value->value.data).key("type").string("int16_t"); break;
+			case UA_TYPES_INT32: writer.value(*(UA_Int32 *)value->value.data).key("type").string("int32_t"); break;
+			case UA_TYPES_INT64: writer.value((int64_t) *(UA_Int64 *)value->value.data).key("type").string("int64_t"); break;
+			case UA_TYPES_BYTE: writer.value((uint32_t) *(UA_Byte *)value->value.data).key("type").string("uint8_t"); break;
+			case UA_TYPES_UINT16: writer.value((uint32_t) *(UA_UInt16 *)value->value.data).key("type").string("uint16_t"); break;
+			case UA_TYPES_UINT32: writer.value(*(UA_UInt32 *)value->value.data).key("type").string("uint32_t"); break;
+			case UA_TYPES_UINT64: writer.value((uint64_t) *(UA_UInt64 *)value->value.data).key("type").string("uint64_t"); break;
+			case UA_TYPES_FLOAT: writer.value(*(UA_Float *)value->value.data).key("type").string("float"); break;
+			case UA_TYPES_DOUBLE: writer.value(*(UA_Double *)value->value.data).key("type").string("double"); break;
+			default: return false;
+			}
+		}
+		else
+		{
+			OPCUA_ArrayEncoding_t encoding = client->getArrayEncoding();
+
+			switch (value->value.type->typeIndex)
 			{
-				jsonThis["value"] = *(UA_UInt32 *)value->value.data;
-				jsonThis["type"] = "uint32_t";
-			} break;
-			case UA_TYPES_UINT64:
+			case UA_TYPES_BOOLEAN: UAArrayToJSON<UA_Boolean>(writer, value->value, "bool", encoding); break;
+			case UA_TYPES_SBYTE: UAArrayToJSON<UA_SByte>(writer, value->value, "int8_t", encoding); break;
+			case UA_TYPES_INT16: UAArrayToJSON<UA_Int16>(writer, value->value, "int16_t", encoding); break;
+			case UA_TYPES_INT32: UAArrayToJSON<UA_Int32>(writer, value->value, "int32_t", encoding); break;
+			case UA_TYPES_INT64: UAArrayToJSON<UA_Int64>(writer, value->value, "int64_t", encoding); break;
+			case UA_TYPES_BYTE: UAArrayToJSON<UA_Byte>(writer, value->value, "uint8_t", encoding); break;
+			case UA_TYPES_UINT16: UAArrayToJSON<UA_UInt16>(writer, value->value, "uint16_t", encoding); break;
+			case UA_TYPES_UINT32: UAArrayToJSON<UA_UInt32>(writer, value->value, "uint32_t", encoding); break;
+			case UA_TYPES_UINT64: UAArrayToJSON<UA_UInt64>(writer, value->value, "uint64_t", encoding); break;
+			case UA_TYPES_FLOAT: UAArrayToJSON<UA_Float>(writer, value->value, "float", encoding); break;
+			case UA_TYPES_DOUBLE: UAArrayToJSON<UA_Double>(writer, value->value, "double", encoding); break;
+			default: return false;
+			}
+		}
+
+		writer.endObject();
+		return true;
+	}
+
+	// Binary format element writers, see codec_binary.h
+	inline void UAElementToBinary(ArenaString & out, UA_Boolean x) { out += (char)(x ? 1 : 0); }
+	inline void UAElementToBinary(ArenaString & out, UA_SByte x) { codec_putvarint(out, codec_zigzag(x)); }
+	inline void UAElementToBinary(ArenaString & out, UA_Int16 x) { codec_putvarint(out, codec_zigzag(x)); }
+	inline void UAElementToBinary(ArenaString & out, UA_Int32 x) { codec_putvarint(out, codec_zigzag(x)); }
+	inline void UAElementToBinary(ArenaString & out, UA_Int64 x) { codec_putvarint(out, codec_zigzag(x)); }
+	inline void UAElementToBinary(ArenaString & out, UA_Byte x) { codec_putvarint(out, x); }
+	inline void UAElementToBinary(ArenaString & out, UA_UInt16 x) { codec_putvarint(out, x); }
+	inline void UAElementToBinary(ArenaString & out, UA_UInt32 x) { codec_putvarint(out, x); }
+	inline void UAElementToBinary(ArenaString & out, UA_UInt64 x) { codec_putvarint(out, x); }
+	inline void UAElementToBinary(ArenaString & out, UA_Float x) { codec_putraw(out, x); }
+	inline void UAElementToBinary(ArenaString & out, UA_Double x) { codec_putraw(out, x); }
+
+	// UA_Variant array -> binary elements, preceded by the dimensions
+	template<typename T>
+	void UAArrayToBinary(ArenaString & out, const UA_Variant & variant, CODEC_Type_t type)
+	{
+		const T * data = (const T *) variant.data;
+
+		out += (char)(uint8_t)(type | CODEC_ARRAY);
+
+		if (variant.arrayDimensionsSize > 1)
+		{
+			codec_putvarint(out, variant.arrayDimensionsSize);
+			for (size_t i = 0; i < variant.arrayDimensionsSize; i++)
+				codec_putvarint(out, variant.arrayDimensions[i]);
+		}
+		else
+		{
+			codec_putvarint(out, 1);
+			codec_putvarint(out, variant.arrayLength);
+		}
+
+		for (size_t i = 0; i < variant.arrayLength; i++)
+			UAElementToBinary(out, data[i]);
+	}
+
+	// Prefixes the binary record written from start on with its length, the record moves by the few bytes of the varint
+	void UABinaryPrefixLength(ArenaString & out, size_t start)
+	{
+		char prefix[10];
+		size_t length = out.size() - start;
+		size_t n_prefix = 0;
+		for (uint64_t x = length; ; x >>= 7)
+		{
+			prefix[n_prefix++] = (char)(uint8_t)((x >= 0x80) ? (x | 0x80) : x);
+			if (x < 0x80)
+				break;
+		}
+		out.insert(start, prefix, n_prefix);
+	}
+
+	// Appends the length prefixed binary value record of one value, returns false for unsupported types
+	bool UADataValueToBinary(uint32_t dictId, const UA_DataValue * value, ArenaString & out)
+	{
+		size_t start = out.size();
+
+		out += (char) CODEC_KIND_VALUE;
+		codec_putvarint(out, dictId);
+		codec_putvarint(out, codec_zigzag(value->sourceTimestamp));
+
+		const UA_Variant & variant = value->value;
+
+		if (UA_Variant_isScalar(&variant))
+		{
+			switch (variant.type->typeIndex)
 			{
-				jsonThis["value"] = *(UA_UInt64 *)value->value.data;
-				jsonThis["type"] = "uint64_t";
-			} break;
-			case UA_TYPES_FLOAT:
+			case UA_TYPES_STRING:
+			case UA_TYPES_BYTESTRING:
+			case UA_TYPES_LOCALIZEDTEXT:
 			{
-				jsonThis["value"] = *(UA_Float *)value->value.data;
-				jsonThis["type"] = "float";
+				UA_String value_str = (variant.type->typeIndex == UA_TYPES_LOCALIZEDTEXT) ? (*(UA_LocalizedText *) variant.data).text : *(UA_String *) variant.data;
+				out += (char) CODEC_TYPE_STRING;
+				codec_putvarint(out, value_str.length);
+				out.append((const char *) value_str.data, value_str.length);
 			} break;
-			case UA_TYPES_DOUBLE:
+			case UA_TYPES_DATETIME: out += (char) CODEC_TYPE_DATETIME; codec_putvarint(out, codec_zigzag(*(UA_DateTime *) variant.data)); break;
+			case UA_TYPES_STATUSCODE: out += (char) CODEC_TYPE_UINT32; UAElementToBinary(out, *(UA_UInt32 *) variant.data); break;
+			case UA_TYPES_BOOLEAN: out += (char) CODEC_TYPE_BOOL; UAElementToBinary(out, *(UA_Boolean *) variant.data); break;
+			case UA_TYPES_SBYTE: out += (char) CODEC_TYPE_INT8; UAElementToBinary(out, *(UA_SByte *) variant.data); break;
+			case UA_TYPES_INT16: out += (char) CODEC_TYPE_INT16; UAElementToBinary(out, *(UA_Int16 *) variant.data); break;
+			case UA_TYPES_INT32: out += (char) CODEC_TYPE_INT32; UAElementToBinary(out, *(UA_Int32 *) variant.data); break;
+			case UA_TYPES_INT64: out += (char) CODEC_TYPE_INT64; UAElementToBinary(out, *(UA_Int64 *) variant.data); break;
+			case UA_TYPES_BYTE: out += (char) CODEC_TYPE_UINT8; UAElementToBinary(out, *(UA_Byte *) variant.data); break;
+			case UA_TYPES_UINT16: out += (char) CODEC_TYPE_UINT16; UAElementToBinary(out, *(UA_UInt16 *) variant.data); break;
+			case UA_TYPES_UINT32: out += (char) CODEC_TYPE_UINT32; UAElementToBinary(out, *(UA_UInt32 *) variant.data); break;
+			case UA_TYPES_UINT64: out += (char) CODEC_TYPE_UINT64; UAElementToBinary(out, *(UA_UInt64 *) variant.data); break;
+			case UA_TYPES_FLOAT: out += (char) CODEC_TYPE_FLOAT; UAElementToBinary(out, *(UA_Float *) variant.data); break;
+			case UA_TYPES_DOUBLE: out += (char) CODEC_TYPE_DOUBLE; UAElementToBinary(out, *(UA_Double *) variant.data); break;
+			default: out.resize(start); return false;
+			}
+		}
+		else
+		{
+			switch (variant.type->typeIndex)
 			{
-				jsonThis["value"] = *(UA_Double *)value->value.data;
-				jsonThis["type"] = "double";
-			} break;
+			case UA_TYPES_BOOLEAN: UAArrayToBinary<UA_Boolean>(out, variant, CODEC_TYPE_BOOL); break;
+			case UA_TYPES_SBYTE: UAArrayToBinary<UA_SByte>(out, variant, CODEC_TYPE_INT8); break;
+			case UA_TYPES_INT16: UAArrayToBinary<UA_Int16>(out, variant, CODEC_TYPE_INT16); break;
+			case UA_TYPES_INT32: UAArrayToBinary<UA_Int32>(out, variant, CODEC_TYPE_INT32); break;
+			case UA_TYPES_INT64: UAArrayToBinary<UA_Int64>(out, variant, CODEC_TYPE_INT64); break;
+			case UA_TYPES_BYTE: UAArrayToBinary<UA_Byte>(out, variant, CODEC_TYPE_UINT8); break;
+			case UA_TYPES_UINT16: UAArrayToBinary<UA_UInt16>(out, variant, CODEC_TYPE_UINT16); break;
+			case UA_TYPES_UINT32: UAArrayToBinary<UA_UInt32>(out, variant, CODEC_TYPE_UINT32); break;
+			case UA_TYPES_UINT64: UAArrayToBinary<UA_UInt64>(out, variant, CODEC_TYPE_UINT64); break;
+			case UA_TYPES_FLOAT: UAArrayToBinary<UA_Float>(out, variant, CODEC_TYPE_FLOAT); break;
+			case UA_TYPES_DOUBLE: UAArrayToBinary<UA_Double>(out, variant, CODEC_TYPE_DOUBLE); break;
+			default: out.resize(start); return false;
 			}
 		}
 
-		// POST the variable to REST
-		if (jsonThis.find("value") != jsonThis.end())
-			sub->getClient()->getHttpClient()->sendJSON("/opcuavariables", HTTP_POST, jsonThis);
-
-		// Log the variable in verbose mode
-		if (sub->getClient()->getHttpClient()->isVerbose())
-			LOG("OPCUA_Variable: %s\n", UA_DateTime_now(), jsonThis.dump().c_str());
+		UABinaryPrefixLength(out, start);
+		return true;
 	}
 
-	OPCUA_Subscription::OPCUA_Subscription(
-		OPCUA_Client * const client,
-		UA_NodeId * const nodeId
-	) :
-		m_client(client),
-		m_nodeId(new UA_NodeId(*nodeId)),
-		m_identifier(nodeId->identifier.string.data, nodeId->identifier.string.data + nodeId->identifier.string.length),
-		m_nsIndex(nodeId->namespaceIndex),
-		m_id(0),
-		m_monitoredItemId(0)
-	{
-		// Get config strings as JSON objects
-		json jsonCfg = json::parse(m_client->getJsonConfig());
-		json jsonDbServersCfg = json::parse(m_client->getJsonDbServersConfig());
-		json jsonDbSubscriptionsCfg = json::parse(m_client->getJsonDbSubscriptionsConfig());
-
-		// Fetch subscription configuration
-		UA_SubscriptionSettings configuration =
-		{
-			m_client->getSubPublishInterval(),				// requestedPublishingInterval
-			m_client->getSubLifetimeCount(),				// requestedLifetimeCount
-			m_client->getSubMaxKeepAliveCount(),			// requestedMaxKeepAliveCount
-			m_client->getSubMaxNotificationsPerPublish(),	// maxNotificationsPerPublish
-			m_client->isSubPublishEnabled(),				// publishingEnabled
-			m_client->getSubPublishPriority()				// priority
-		};
-
-		// Create UA_Subscription instance
-		m_client->getStatus() = UA_Client_Subscriptions_new(m_client->getClient(), configuration, &m_id);
-
-		// Throw if creation failed
-		if (m_client->getStatus() != UA_STATUSCODE_GOOD)
-			throw std::exception("OPCUA_Subscription something went wrong while creating the UA_Subscription instance.");
-
-		// Create the subscription request
-		m_client->getStatus() = UA_Client_Subscriptions_addMonitoredItem(m_client->getClient(), m_id, *m_nodeId, UA_ATTRIBUTEID_VALUE, &OPCUA_Callback_MonitoredItem, (void *) this, &m_monitoredItemId);
-
-		// Throw if subscription failed
-		if (m_client->getStatus() != UA_STATUSCODE_GOOD)
-			throw std::exception("OPCUA_Subscription something went wrong while creating the subscription link.");
-
-		LOG("OPCUA_Subscription serverId(%d) was linked successfully, id: %d\n", UA_DateTime_now(), m_client->getServerId(), m_identifier.c_str(), m_id);
+	// Appends the JSON object of one aggregation window to the writer, the timestamp is the window start
+	void UAAggregateToJSON(OPCUA_Client * const client, uint32_t node, const OPCUA_AggregateRow_t & row, uint8_t functions, JsonWriter<ArenaString> & writer)
+	{
+		OPCUA_NodeTable * nodes = client->getNodeTable();
+		std::string identifier = nodes->getIdentifier(node);
+		char buffer[64];
 
-		// Create a JSON instance
-		json jsonThis;
-		jsonThis["identifier"] = m_identifier;
-		jsonThis["nsIndex"] = m_nsIndex;
-		jsonThis["type"] = "NOT_IMPLEMENTED";
-		jsonThis["serverId"] = m_client->getServerId();
+		writer.beginObject();
+		writer.key("identifier").string(identifier.data(), identifier.size());
+		writer.key("nsIndex").value((uint32_t) nodes->getNsIndex(node));
+		writer.key("serverId").value((int32_t) client->getServerId());
+		writer.key("serverTimeStamp").string(buffer, UADateTimeToJSONDateTime(row.start, buffer, sizeof(buffer)));
+		writer.key("window").value((double) row.window / UA_MSEC_TO_DATETIME);
+
+		if (functions & OPCUA_AGGREGATE_MIN)
+			writer.key("min").value(row.min);
+		if (functions & OPCUA_AGGREGATE_MAX)
+			writer.key("max").value(row.max);
+		if (functions & OPCUA_AGGREGATE_AVG)
+			writer.key("avg").value(row.sum / row.count);
+		if (functions & OPCUA_AGGREGATE_COUNT)
+			writer.key("count").value(row.count);
+		if (functions & OPCUA_AGGREGATE_LAST)
+			writer.key("last").value(row.last);
 
-		// GET target subscription from REST
-		json jsonDbSubscription = m_client->getHttpClient()->getJSON("/opcuasubscriptions/" + std::to_string(m_nsIndex) + "/?identifier=" + m_identifier + "&serverId=" + std::to_string(m_client->getServerId()));
+		writer.key("type").string("aggregate");
+		writer.endObject();
+	}
 
-		// POST or PUT target subscription to REST
-		HTTP_Request_t http_req = (jsonDbSubscription.empty() == false) ? HTTP_PUT : HTTP_POST;
-		m_client->getHttpClient()->sendJSON("/opcuasubscriptions", http_req, jsonThis);
+	// Appends the length prefixed binary aggregate record of one window
+	void UAAggregateToBinary(uint32_t dictId, const OPCUA_AggregateRow_t & row, uint8_t functions, ArenaString & out)
+	{
+		size_t start = out.size();
 
-		LOG("OPCUA_Subscription serverId(%d) was initialized successfully, identifier: %s\n", UA_DateTime_now(), m_client->getServerId(), m_identifier.c_str());
+		out += (char) CODEC_KIND_AGGREGATE;
+		codec_putvarint(out, dictId);
+		codec_putvarint(out, codec_zigzag(row.start));
+		codec_putvarint(out, (uint64_t) row.window);
+		out += (char) functions;
 
+		if (functions & OPCUA_AGGREGATE_MIN)
+			codec_putraw(out, row.min);
+		if (functions & OPCUA_AGGREGATE_MAX)
+			codec_putraw(out, row.max);
+		if (functions & OPCUA_AGGREGATE_AVG)
+			codec_putraw(out, row.sum / row.count);
+		if (functions & OPCUA_AGGREGATE_COUNT)
+			codec_putvarint(out, row.count);
+		if (functions & OPCUA_AGGREGATE_LAST)
+			codec_putraw(out, row.last);
+
+		UABinaryPrefixLength(out, start);
 	}
 
-	OPCUA_Subscription::~OPCUA_Subscription()
+	// Dictionary id of the identifier of a tag for binary records, interned on first use
+	uint32_t UADictId(OPCUA_Client * const client, uint32_t handle)
 	{
-		if (m_client != NULL)
-		{
-			UA_Client_Subscriptions_remove(m_client->getClient(), m_id);
+		OPCUA_TagStore * tags = client->getTagStore();
+		uint32_t dictId = tags->getDictId(handle);
 
-			LOG("OPCUA_Subscription id(%d) serverId(%d) was destroyed.\n", UA_DateTime_now(), m_id, m_client->getServerId());
-		}
-		else
+		if (dictId == SINK_Dictionary::npos)
 		{
-			WRN("OPCUA_Subscription id(%d) serverId(%d) was destroyed, m_client was NULL!\n", UA_DateTime_now(), m_id, m_client->getServerId());
+			OPCUA_NodeTable * nodes = client->getNodeTable();
+			uint32_t node = tags->getNode(handle);
+			std::string identifier = nodes->getIdentifier(node);
+			dictId = SINK_Dictionary::instance().intern(((uint64_t)(uint32_t) client->getServerId() << 32) | node, client->getServerId(), nodes->getNsIndex(node), identifier.data(), identifier.size());
+			tags->setDictId(handle, dictId);
 		}
+
+		return dictId;
 	}
 
-	OPCUA_Client * OPCUA_Subscription::getClient()
+	// Offsets of one serialized record per format, a length of 0 means not serialized
+	struct OPCUA_Serialized_t
 	{
-		return m_client;
-	}
+		uint32_t handle;
+		uint32_t offsets[SINK_FORMAT_COUNT];
+		uint32_t lengths[SINK_FORMAT_COUNT];
+	};
 
-	UA_NodeId * OPCUA_Subscription::getNodeId()
+	// Stores, aggregates and sends the values of one batch. Archived values come
+	// from the compressor, they leave the last value of their tags untouched
+	// and are stored and sent as they are.
+	void UADataChanges(OPCUA_Client * const client, const OPCUA_Record_t * records, size_t count, bool archived)
 	{
-		return m_nodeId;
+		OPCUA_TagStore * tags = client->getTagStore();
+		OPCUA_NodeTable * nodes = client->getNodeTable();
+		SINK_Fanout * sinks = client->getSinks();
+		STORE_TimeSeries * history = client->getHistory();
+		OPCUA_Aggregator * aggregator = client->getAggregator();
+		OPCUA_Compressor * compressor = client->getCompressor();
+		Arena & arena = client->getArena();
+		bool verbose = client->getHttpClient()->isVerbose();
+
+		// Every wire format some sink uses is written once per batch, into one arena string each
+		bool formats[SINK_FORMAT_COUNT];
+		ArenaString texts[SINK_FORMAT_COUNT] = { ArenaString(ArenaAllocator<char>(&arena)), ArenaString(ArenaAllocator<char>(&arena)) };
+		for (int f = 0; f < SINK_FORMAT_COUNT; f++)
+		{
+			formats[f] = sinks->usesFormat((SINK_Format_t) f);
+			if (formats[f])
+				texts[f].reserve(count * ((f == SINK_FORMAT_JSON) ? 192 : 32));
+		}
+
+		ArenaString & text = texts[SINK_FORMAT_JSON];
+		JsonWriter<ArenaString> writer(text);
+
+		std::vector<OPCUA_Serialized_t, ArenaAllocator<OPCUA_Serialized_t>> serialized = std::vector<OPCUA_Serialized_t, ArenaAllocator<OPCUA_Serialized_t>>(ArenaAllocator<OPCUA_Serialized_t>(&arena));
+		serialized.reserve(count);
+
+		std::vector<STORE_Point_t, ArenaAllocator<STORE_Point_t>> points = std::vector<STORE_Point_t, ArenaAllocator<STORE_Point_t>>(ArenaAllocator<STORE_Point_t>(&arena));
+		if (history != NULL)
+			points.reserve(count);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			uint32_t handle = records[i].handle;
+			const UA_DataValue * value = records[i].value;
+			uint32_t node = tags->getNode(handle);
+			const OPCUA_ItemSettings_t & settings = tags->getItemSettings(handle);
+
+			// Keep the last value and count of the tag
+			double last = 0.0;
+			bool numeric = value->hasValue && value->value.type != NULL && value->value.data != NULL && UA_Variant_isScalar(&value->value) && UAScalarToDouble(value->value, last);
+
+			// Samples without a source timestamp are placed at their arrival
+			UA_DateTime sourceTime = value->hasSourceTimestamp ? value->sourceTimestamp : UA_DateTime_now();
+			if (archived == false)
+				tags->update(handle, (value->hasValue && value->value.type != NULL) ? (uint16_t) value->value.type->typeIndex : OPCUA_TagStore::npos, last, sourceTime);
+
+			// Numeric scalars of compressed tags go through the compressor, only the points it archives are stored and sent
+			bool compressed = numeric && settings.compress && archived == false;
+			if (compressed)
+			{
+				uint32_t slot = tags->getCompressorSlot(handle);
+				if (slot == OPCUA_Compressor::npos)
+				{
+					slot = compressor->add(handle, settings.exceptionDeviation, settings.compressionDeviation, settings.compressionMaxInterval);
+					tags->setCompressorSlot(handle, slot);
+				}
+
+				compressor->push(slot, sourceTime, last);
+			}
+
+			// Numeric scalars go into the local history, the tag is interned on its first sample
+			if (history != NULL && numeric && compressed == false)
+			{
+				uint32_t historyId = tags->getHistoryId(handle);
+				if (historyId == STORE_TimeSeries::npos)
+				{
+					historyId = history->intern(client->getServerId(), nodes->getNsIndex(node), nodes->getIdentifier(node));
+					tags->setHistoryId(handle, historyId);
+				}
+
+				points.push_back({ historyId, sourceTime, last });
+			}
+
+			// Numeric scalars of aggregated tags go into their window, the raw value is only sent with pass-through
+			if (numeric && settings.aggregateWindow > 0.0)
+			{
+				if (archived == false)
+				{
+					uint32_t slot = tags->getAggregateSlot(handle);
+					if (slot == OPCUA_Aggregator::npos)
+					{
+						slot = aggregator->add(handle, settings.aggregateWindow);
+						tags->setAggregateSlot(handle, slot);
+					}
+
+					aggregator->push(slot, sourceTime, last);
+				}
+
+				if (settings.aggregateRaw == false)
+					continue;
+			}
+
+			if (compressed)
+				continue;
+
+			if (value->hasValue == false || value->value.type == NULL || value->value.data == NULL)
+				continue;
+
+			OPCUA_Serialized_t record = { handle, { 0 }, { 0 } };
+
+			// Types without a JSON mapping are not sent
+			if (formats[SINK_FORMAT_JSON])
+			{
+				size_t start = text.size();
+				if (UADataValueToJSON(client, node, value, writer))
+				{
+					record.offsets[SINK_FORMAT_JSON] = (uint32_t) start;
+					record.lengths[SINK_FORMAT_JSON] = (uint32_t)(text.size() - start);
+
+					// Log the variable in verbose mode
+					if (verbose)
+						LOG("OPCUA_Variable: %.*s\n", UA_DateTime_now(), (int)(text.size() - start), text.data() + start);
+				}
+				else
+				{
+					text.resize(start);
+				}
+
+				// Records are written back to back, not as one JSON array
+				writer.reset();
+			}
+
+			// Binary records refer to the identifier by its dictionary id
+			if (formats[SINK_FORMAT_BINARY])
+			{
+				ArenaString & binary = texts[SINK_FORMAT_BINARY];
+				size_t start = binary.size();
+				if (UADataValueToBinary(UADictId(client, handle), value, binary))
+				{
+					record.offsets[SINK_FORMAT_BINARY] = (uint32_t) start;
+					record.lengths[SINK_FORMAT_BINARY] = (uint32_t)(binary.size() - start);
+				}
+			}
+
+			serialized.push_back(record);
+		}
+
+		if (points.empty() == false)
+			history->append(points.data(), points.size());
+
+		// Windows closed by a sample of a later window
+		if (aggregator->getClosed().empty() == false)
+			OPCUA_Callback_Aggregates(client);
+
+		if (serialized.empty())
+			return;
+
+		uint64_t serverKey = (uint64_t)(uint32_t) client->getServerId() << 32;
+
+		for (int f = 0; f < SINK_FORMAT_COUNT; f++)
+		{
+			if (formats[f] == false || texts[f].empty())
+				continue;
+
+			// The batch leaves the arena in a single payload shared by all sinks of the format, records are slices of it
+			PayloadRef payload = Payload::create(texts[f].data(), texts[f].size());
+
+			std::vector<SINK_Item_t, ArenaAllocator<SINK_Item_t>> items = std::vector<SINK_Item_t, ArenaAllocator<SINK_Item_t>>(ArenaAllocator<SINK_Item_t>(&arena));
+			items.reserve(serialized.size());
+
+			for (const OPCUA_Serialized_t & record : serialized)
+			{
+				if (record.lengths[f] == 0)
+					continue;
+
+				SINK_Item_t item = {
+					{ payload, record.offsets[f], record.lengths[f] },
+					serverKey | tags->getNode(record.handle),
+					tags->getItemSettings(record.handle).priority,
+					(f == SINK_FORMAT_BINARY) ? tags->getDictId(record.handle) : SINK_Dictionary::npos
+				};
+
+				// Held back until the subscription is registered, the slice keeps the payload alive
+				if (tags->isRegistered(record.handle))
+					items.push_back(item);
+				else
+					tags->holdBack(record.handle, "/opcuavariables", (SINK_Format_t) f, item);
+			}
+
+			if (items.empty() == false)
+				sinks->push("/opcuavariables", (SINK_Format_t) f, items.data(), items.size());
+		}
 	}
 
-	std::string OPCUA_Subscription::getIdentifier() const
+	void OPCUA_Callback_DataChanges(
+		OPCUA_Client * const client,
+		const OPCUA_Record_t * records,
+		size_t count
+	)
 	{
-		return m_identifier;
+		UADataChanges(client, records, count, false);
+
+		// Points archived by the samples of this batch
+		if (client->getCompressor()->getArchived().empty() == false)
+			OPCUA_Callback_Compressed(client);
 	}
 
-	uint16_t OPCUA_Subscription::getNsIndex() const
+	void OPCUA_Callback_Compressed(
+		OPCUA_Client * const client
+	)
 	{
-		return m_nsIndex;
+		OPCUA_TagStore * tags = client->getTagStore();
+		Arena & arena = client->getArena();
+		std::vector<OPCUA_ArchivedPoint_t> & points = client->getCompressor()->getArchived();
+
+		// The values live in the arena next to the batch, records point into them
+		std::vector<OPCUA_ArchivedValue_t, ArenaAllocator<OPCUA_ArchivedValue_t>> values = std::vector<OPCUA_ArchivedValue_t, ArenaAllocator<OPCUA_ArchivedValue_t>>(ArenaAllocator<OPCUA_ArchivedValue_t>(&arena));
+		values.resize(points.size());
+
+		std::vector<OPCUA_Record_t, ArenaAllocator<OPCUA_Record_t>> records = std::vector<OPCUA_Record_t, ArenaAllocator<OPCUA_Record_t>>(ArenaAllocator<OPCUA_Record_t>(&arena));
+		records.reserve(points.size());
+
+		for (size_t i = 0; i < points.size(); i++)
+		{
+			OPCUA_ArchivedValue_t & archived = values[i];
+			UA_DataValue_init(&archived.value);
+			archived.value.hasValue = true;
+			archived.value.hasSourceTimestamp = true;
+			archived.value.sourceTimestamp = points[i].time;
+			UADoubleToScalar(points[i].value, tags->getType(points[i].handle), archived);
+
+			records.push_back({ points[i].handle, &archived.value });
+		}
+
+		UADataChanges(client, records.data(), records.size(), true);
+		points.clear();
 	}
 
-	uint32_t OPCUA_Subscription::getId() const
+	void OPCUA_Callback_Aggregates(
+		OPCUA_Client * const client
+	)
 	{
-		return m_id;
+		OPCUA_TagStore * tags = client->getTagStore();
+		SINK_Fanout * sinks = client->getSinks();
+		Arena & arena = client->getArena();
+		std::vector<OPCUA_AggregateRow_t> & rows = client->getAggregator()->getClosed();
+		uint64_t serverKey = (uint64_t)(uint32_t) client->getServerId() << 32;
+
+		for (int f = 0; f < SINK_FORMAT_COUNT; f++)
+		{
+			if (sinks->usesFormat((SINK_Format_t) f) == false)
+				continue;
+
+			ArenaString text = ArenaString(ArenaAllocator<char>(&arena));
+			text.reserve(rows.size() * ((f == SINK_FORMAT_JSON) ? 224 : 48));
+			JsonWriter<ArenaString> writer(text);
+
+			std::vector<OPCUA_Serialized_t, ArenaAllocator<OPCUA_Serialized_t>> serialized = std::vector<OPCUA_Serialized_t, ArenaAllocator<OPCUA_Serialized_t>>(ArenaAllocator<OPCUA_Serialized_t>(&arena));
+			serialized.reserve(rows.size());
+
+			for (const OPCUA_AggregateRow_t & row : rows)
+			{
+				uint8_t functions = tags->getItemSettings(row.handle).aggregates;
+				size_t start = text.size();
+
+				if (f == SINK_FORMAT_JSON)
+				{
+					UAAggregateToJSON(client, tags->getNode(row.handle), row, functions, writer);
+					writer.reset();
+				}
+				else
+				{
+					UAAggregateToBinary(UADictId(client, row.handle), row, functions, text);
+				}
+
+				OPCUA_Serialized_t record = { row.handle, { 0 }, { 0 } };
+				record.offsets[f] = (uint32_t) start;
+				record.lengths[f] = (uint32_t)(text.size() - start);
+				serialized.push_back(record);
+			}
+
+			PayloadRef payload = Payload::create(text.data(), text.size());
+
+			std::vector<SINK_Item_t, ArenaAllocator<SINK_Item_t>> items = std::vector<SINK_Item_t, ArenaAllocator<SINK_Item_t>>(ArenaAllocator<SINK_Item_t>(&arena));
+			items.reserve(serialized.size());
+
+			for (const OPCUA_Serialized_t & record : serialized)
+			{
+				SINK_Item_t item = {
+					{ payload, record.offsets[f], record.lengths[f] },
+					serverKey | tags->getNode(record.handle),
+					tags->getItemSettings(record.handle).priority,
+					(f == SINK_FORMAT_BINARY) ? tags->getDictId(record.handle) : SINK_Dictionary::npos
+				};
+
+				if (tags->isRegistered(record.handle))
+					items.push_back(item);
+				else
+					tags->holdBack(record.handle, "/opcuaaggregates", (SINK_Format_t) f, item);
+			}
+
+			if (items.empty() == false)
+				sinks->push("/opcuaaggregates", (SINK_Format_t) f, items.data(), items.size());
+		}
+
+		rows.clear();
 	}
 
-	uint32_t OPCUA_Subscription::getMonitoredItemId() const
+	uint32_t OPCUA_Subscription_Create(
+		OPCUA_Client * const client,
+		const UA_NodeId & nodeId,
+		OPCUA_Group * const group
+	)
 	{
-		return m_monitoredItemId;
+		// The NodeId is interned by the client, the given one may point to memory owned by the browse callback
+		uint32_t node = client->getNodeTable()->intern(nodeId);
+		std::string identifier = client->getNodeTable()->getIdentifier(node);
+
+		// Resolve the monitored item settings of this identifier
+		OPCUA_ItemSettings_t settings = { OPCUA_DEADBAND_NONE, 0.0, -1.0, 1, true, SINK_PRIORITY_NORMAL, 0.0, 0, false, false, 0.0, 0.0, 0.0 };
+		if (group != NULL)
+			settings = group->getItemSettings(identifier);
+
+		uint32_t handle = client->getTagStore()->add(node, group, settings);
+
+		// Create a JSON instance
+		json jsonThis;
+		jsonThis["identifier"] = identifier;
+		jsonThis["nsIndex"] = nodeId.namespaceIndex;
+		jsonThis["type"] = "NOT_IMPLEMENTED";
+		jsonThis["serverId"] = client->getServerId();
+
+		// GET / POST or PUT target subscription to REST in the background, the flag stays in place while the store grows
+		std::string path = "/opcuasubscriptions/" + std::to_string(nodeId.namespaceIndex) + "/?identifier=" + identifier + "&serverId=" + std::to_string(client->getServerId());
+		std::atomic<bool> * registered = &client->getTagStore()->getRegistered(handle);
+		client->getHttpRegistrar()->push([jsonThis, path, registered](HTTP_Client * const httpClient) mutable
+		{
+			// GET target subscription from REST
+			json jsonDbSubscription = httpClient->getJSON(path);
+
+			// POST or PUT target subscription to REST
+			HTTP_Request_t http_req = (jsonDbSubscription.empty() == false) ? HTTP_PUT : HTTP_POST;
+			if (httpClient->sendJSON("/opcuasubscriptions", http_req, jsonThis) == false)
+				return false;
+
+			// Variables of this subscription may be sent from now on
+			*registered = true;
+			return true;
+		});
+
+		LOG("OPCUA_Subscription serverId(%d) was initialized successfully, identifier: %s\n", UA_DateTime_now(), client->getServerId(), identifier.c_str());
+
+		return handle;
 	}
 
 }
\ No newline at end of file
@@ -3,43 +3,49 @@
 
 #include <string>
 #include <cstdint>
-
-struct UA_Client;
-struct _UA_NodeId;
-typedef _UA_NodeId UA_NodeId;
-typedef uint32_t UA_StatusCode;
-struct _UA_SubscriptionSettings;
-typedef _UA_SubscriptionSettings UA_SubscriptionSettings;
+#include <open62541.h>
 
 namespace gateway
 {
 
-	extern UA_SubscriptionSettings * OPCUA_SubscriptionSettings;
 	class OPCUA_Client;
+	class OPCUA_Group;
+
+	// Adds a tag for the given NodeId to the OPCUA_TagStore of the client and
+	// registers it to REST in the background, returns the handle of the tag
+	uint32_t OPCUA_Subscription_Create(
+		OPCUA_Client * const client,
+		const UA_NodeId & nodeId,
+		OPCUA_Group * const group = NULL
+	);
 
-	class OPCUA_Subscription
+	// A received or polled value of a tag, the value is owned by the caller
+	struct OPCUA_Record_t
 	{
-	public:
-		OPCUA_Subscription(
-			OPCUA_Client * const client,
-			UA_NodeId * const nodeId
-		);
-		~OPCUA_Subscription();
-		OPCUA_Client * getClient();
-		UA_NodeId * getNodeId();
-		std::string getIdentifier() const;
-		uint16_t getNsIndex() const;
-		uint32_t getId() const;
-		uint32_t getMonitoredItemId() const;
-	private:
-		OPCUA_Client * m_client;
-		UA_NodeId * m_nodeId;
-		std::string m_identifier;
-		uint16_t m_nsIndex;
-		uint32_t m_id;
-		uint32_t m_monitoredItemId;
+		uint32_t handle;
+		const UA_DataValue * value;
 	};
 
+	// Converts all values of one publish or read response to JSON in a single
+	// pass and queues them for REST in one call
+	void OPCUA_Callback_DataChanges(
+		OPCUA_Client * const client,
+		const OPCUA_Record_t * records,
+		size_t count
+	);
+
+	// Sends the windows closed by the aggregator of the client to the
+	// "/opcuaaggregates" path of every sink in one pass and clears them
+	void OPCUA_Callback_Aggregates(
+		OPCUA_Client * const client
+	);
+
+	// Stores and sends the points archived by the compressor of the client in
+	// place of the raw samples of compressed tags, in one pass, and clears them
+	void OPCUA_Callback_Compressed(
+		OPCUA_Client * const client
+	);
+
 }
 
 #endif // SUBSCRIPTION_H
\ No newline at end of file
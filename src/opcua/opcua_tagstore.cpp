@@ -0,0 +1,260 @@
+#include "opcua_tagstore.h"
+#include <algorithm>
+#include "../sink/sink_dictionary.h"
+#include "../store/store_timeseries.h"
+#include "opcua_aggregator.h"
+#include "opcua_compressor.h"
+#include "../util/metrics.h"
+
+namespace gateway
+{
+
+	const uint16_t OPCUA_TagStore::npos;
+
+	OPCUA_TagStore::OPCUA_TagStore(
+		size_t heldBackLimit
+	) :
+		m_groupPool(),
+		m_settingsPool(),
+		m_nodes(),
+		m_groups(),
+		m_settings(),
+		m_subscriptionIds(),
+		m_monitoredItemIds(),
+		m_registered(),
+		m_types(),
+		m_lastValues(),
+		m_lastTimes(),
+		m_counts(),
+		m_dictIds(),
+		m_historyIds(),
+		m_aggregateSlots(),
+		m_compressorSlots(),
+		m_heldBack(),
+		m_heldBackLimit(std::max<size_t>(heldBackLimit, 1)),
+		m_heldBackDropped(0)
+	{
+
+	}
+
+	uint32_t OPCUA_TagStore::add(uint32_t node, OPCUA_Group * const group, const OPCUA_ItemSettings_t & settings)
+	{
+		uint32_t handle = (uint32_t) m_nodes.size();
+
+		m_nodes.emplace() = node;
+		m_groups.emplace() = internGroup(group);
+		m_settings.emplace() = internSettings(settings);
+		m_subscriptionIds.emplace() = 0;
+		m_monitoredItemIds.emplace() = 0;
+		m_registered.emplace() = false;
+		m_types.emplace() = npos;
+		m_lastValues.emplace() = 0.0;
+		m_lastTimes.emplace() = 0;
+		m_counts.emplace() = 0;
+		m_dictIds.emplace() = SINK_Dictionary::npos;
+		m_historyIds.emplace() = STORE_TimeSeries::npos;
+		m_aggregateSlots.emplace() = OPCUA_Aggregator::npos;
+		m_compressorSlots.emplace() = OPCUA_Compressor::npos;
+
+		return handle;
+	}
+
+	size_t OPCUA_TagStore::size() const
+	{
+		return m_nodes.size();
+	}
+
+	uint32_t OPCUA_TagStore::getNode(uint32_t handle) const
+	{
+		return m_nodes[handle];
+	}
+
+	OPCUA_Group * OPCUA_TagStore::getGroup(uint32_t handle) const
+	{
+		uint16_t group = m_groups[handle];
+		return (group == npos) ? NULL : m_groupPool[group];
+	}
+
+	const OPCUA_ItemSettings_t & OPCUA_TagStore::getItemSettings(uint32_t handle) const
+	{
+		return m_settingsPool[m_settings[handle]];
+	}
+
+	void OPCUA_TagStore::setItemSettings(uint32_t handle, const OPCUA_ItemSettings_t & settings)
+	{
+		m_settings[handle] = internSettings(settings);
+	}
+
+	void OPCUA_TagStore::dropDeadband(uint32_t handle)
+	{
+		OPCUA_ItemSettings_t settings = getItemSettings(handle);
+		settings.deadbandType = OPCUA_DEADBAND_NONE;
+		settings.deadbandValue = 0.0;
+		setItemSettings(handle, settings);
+	}
+
+	uint32_t OPCUA_TagStore::getSubscriptionId(uint32_t handle) const
+	{
+		return m_subscriptionIds[handle];
+	}
+
+	uint32_t OPCUA_TagStore::getMonitoredItemId(uint32_t handle) const
+	{
+		return m_monitoredItemIds[handle];
+	}
+
+	void OPCUA_TagStore::setLink(uint32_t handle, uint32_t subscriptionId, uint32_t monitoredItemId)
+	{
+		m_subscriptionIds[handle] = subscriptionId;
+		m_monitoredItemIds[handle] = monitoredItemId;
+	}
+
+	std::atomic<bool> & OPCUA_TagStore::getRegistered(uint32_t handle)
+	{
+		return m_registered[handle];
+	}
+
+	bool OPCUA_TagStore::isRegistered(uint32_t handle) const
+	{
+		return m_registered[handle];
+	}
+
+	void OPCUA_TagStore::update(uint32_t handle, uint16_t type, double value, UA_DateTime time)
+	{
+		m_types[handle] = type;
+		m_lastValues[handle] = value;
+		m_lastTimes[handle] = time;
+		m_counts[handle]++;
+	}
+
+	uint16_t OPCUA_TagStore::getType(uint32_t handle) const
+	{
+		return m_types[handle];
+	}
+
+	double OPCUA_TagStore::getLastValue(uint32_t handle) const
+	{
+		return m_lastValues[handle];
+	}
+
+	UA_DateTime OPCUA_TagStore::getLastTime(uint32_t handle) const
+	{
+		return m_lastTimes[handle];
+	}
+
+	uint32_t OPCUA_TagStore::getCount(uint32_t handle) const
+	{
+		return m_counts[handle];
+	}
+
+	uint32_t OPCUA_TagStore::getDictId(uint32_t handle) const
+	{
+		return m_dictIds[handle];
+	}
+
+	void OPCUA_TagStore::setDictId(uint32_t handle, uint32_t dictId)
+	{
+		m_dictIds[handle] = dictId;
+	}
+
+	uint32_t OPCUA_TagStore::getHistoryId(uint32_t handle) const
+	{
+		return m_historyIds[handle];
+	}
+
+	void OPCUA_TagStore::setHistoryId(uint32_t handle, uint32_t historyId)
+	{
+		m_historyIds[handle] = historyId;
+	}
+
+	uint32_t OPCUA_TagStore::getAggregateSlot(uint32_t handle) const
+	{
+		return m_aggregateSlots[handle];
+	}
+
+	void OPCUA_TagStore::setAggregateSlot(uint32_t handle, uint32_t slot)
+	{
+		m_aggregateSlots[handle] = slot;
+	}
+
+	uint32_t OPCUA_TagStore::getCompressorSlot(uint32_t handle) const
+	{
+		return m_compressorSlots[handle];
+	}
+
+	void OPCUA_TagStore::setCompressorSlot(uint32_t handle, uint32_t slot)
+	{
+		m_compressorSlots[handle] = slot;
+	}
+
+	void OPCUA_TagStore::holdBack(uint32_t handle, const char * path, SINK_Format_t format, const SINK_Item_t & item)
+	{
+		std::deque<OPCUA_HeldBack_t> & held = m_heldBack[handle];
+
+		// Registration keeps failing, the oldest records go first
+		if (held.size() >= m_heldBackLimit)
+		{
+			held.pop_front();
+			m_heldBackDropped++;
+		}
+
+		held.push_back({ path, format, item });
+	}
+
+	std::unordered_map<uint32_t, std::deque<OPCUA_HeldBack_t>> & OPCUA_TagStore::getHeldBack()
+	{
+		return m_heldBack;
+	}
+
+	size_t OPCUA_TagStore::getMemoryUsage() const
+	{
+		return m_groupPool.capacity() * sizeof(OPCUA_Group *) + m_settingsPool.capacity() * sizeof(OPCUA_ItemSettings_t) +
+			m_nodes.getMemoryUsage() + m_groups.getMemoryUsage() + m_settings.getMemoryUsage() +
+			m_subscriptionIds.getMemoryUsage() + m_monitoredItemIds.getMemoryUsage() + m_registered.getMemoryUsage() +
+			m_types.getMemoryUsage() + m_lastValues.getMemoryUsage() + m_lastTimes.getMemoryUsage() + m_counts.getMemoryUsage() + m_dictIds.getMemoryUsage() + m_historyIds.getMemoryUsage() +
+			m_aggregateSlots.getMemoryUsage() + m_compressorSlots.getMemoryUsage();
+	}
+
+	uint16_t OPCUA_TagStore::internGroup(OPCUA_Group * const group)
+	{
+		if (group == NULL)
+			return npos;
+
+		for (size_t i = 0; i < m_groupPool.size(); i++)
+		{
+			if (m_groupPool[i] == group)
+				return (uint16_t) i;
+		}
+
+		m_groupPool.push_back(group);
+		return (uint16_t)(m_groupPool.size() - 1);
+	}
+
+	uint16_t OPCUA_TagStore::internSettings(const OPCUA_ItemSettings_t & settings)
+	{
+		// Only a handful of distinct settings exist, one per group and pattern rule
+		for (size_t i = 0; i < m_settingsPool.size(); i++)
+		{
+			const OPCUA_ItemSettings_t & s = m_settingsPool[i];
+
+			if (s.deadbandType == settings.deadbandType && s.deadbandValue == settings.deadbandValue &&
+				s.samplingInterval == settings.samplingInterval && s.queueSize == settings.queueSize &&
+				s.discardOldest == settings.discardOldest && s.priority == settings.priority &&
+				s.aggregateWindow == settings.aggregateWindow && s.aggregates == settings.aggregates && s.aggregateRaw == settings.aggregateRaw &&
+				s.compress == settings.compress && s.exceptionDeviation == settings.exceptionDeviation &&
+				s.compressionDeviation == settings.compressionDeviation && s.compressionMaxInterval == settings.compressionMaxInterval)
+				return (uint16_t) i;
+		}
+
+		m_settingsPool.push_back(settings);
+		return (uint16_t)(m_settingsPool.size() - 1);
+	}
+
+	void OPCUA_TagStore::reportMetrics(int32_t serverId)
+	{
+		Metrics::instance().add(metricname("opcua", serverId, "heldback_dropped"), (double) m_heldBackDropped);
+
+		m_heldBackDropped = 0;
+	}
+
+}
\ No newline at end of file
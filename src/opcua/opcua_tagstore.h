@@ -0,0 +1,135 @@
+#ifndef TAGSTORE_H
+#define TAGSTORE_H
+
+#include <string>
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <deque>
+#include <unordered_map>
+#include <open62541.h>
+#include "opcua_group.h"
+
+namespace gateway
+{
+
+	// A column of per-tag values allocated in fixed size chunks, elements
+	// never move once added so references stay valid while the column grows
+	template<typename T>
+	class OPCUA_Column
+	{
+	public:
+		OPCUA_Column() :
+			m_chunks(),
+			m_size(0)
+		{
+
+		}
+		T & emplace()
+		{
+			if ((m_size & m_mask) == 0)
+				m_chunks.emplace_back(new T[m_chunk]());
+
+			return (*this)[(uint32_t)(m_size++)];
+		}
+		T & operator[](uint32_t index)
+		{
+			return m_chunks[index >> m_shift][index & m_mask];
+		}
+		const T & operator[](uint32_t index) const
+		{
+			return m_chunks[index >> m_shift][index & m_mask];
+		}
+		size_t size() const
+		{
+			return m_size;
+		}
+		size_t getMemoryUsage() const
+		{
+			return m_chunks.size() * m_chunk * sizeof(T) + m_chunks.capacity() * sizeof(std::unique_ptr<T[]>);
+		}
+	private:
+		static const uint32_t m_shift = 10;
+		static const uint32_t m_chunk = 1 << m_shift;
+		static const uint32_t m_mask = m_chunk - 1;
+		std::vector<std::unique_ptr<T[]>> m_chunks;
+		size_t m_size;
+	};
+
+	// A serialized record waiting for the REST registration of its tag
+	struct OPCUA_HeldBack_t
+	{
+		const char * path;
+		SINK_Format_t format;
+		SINK_Item_t item;
+	};
+
+	// Per-tag state of a client in structure-of-arrays form, indexed by the
+	// handle that is also used as the monitored item client handle. Groups
+	// and item settings are shared by many tags and stored once in pools.
+	// At most heldBackLimit records are held back per tag, the oldest ones
+	// are dropped first and counted.
+	class OPCUA_TagStore
+	{
+	public:
+		OPCUA_TagStore(
+			size_t heldBackLimit
+		);
+		uint32_t add(uint32_t node, OPCUA_Group * const group, const OPCUA_ItemSettings_t & settings);
+		size_t size() const;
+		uint32_t getNode(uint32_t handle) const;
+		OPCUA_Group * getGroup(uint32_t handle) const;
+		const OPCUA_ItemSettings_t & getItemSettings(uint32_t handle) const;
+		void setItemSettings(uint32_t handle, const OPCUA_ItemSettings_t & settings);
+		void dropDeadband(uint32_t handle);
+		uint32_t getSubscriptionId(uint32_t handle) const;
+		uint32_t getMonitoredItemId(uint32_t handle) const;
+		void setLink(uint32_t handle, uint32_t subscriptionId, uint32_t monitoredItemId);
+		std::atomic<bool> & getRegistered(uint32_t handle);
+		bool isRegistered(uint32_t handle) const;
+		void update(uint32_t handle, uint16_t type, double value, UA_DateTime time);
+		uint16_t getType(uint32_t handle) const;
+		double getLastValue(uint32_t handle) const;
+		UA_DateTime getLastTime(uint32_t handle) const;
+		uint32_t getCount(uint32_t handle) const;
+		uint32_t getDictId(uint32_t handle) const;
+		void setDictId(uint32_t handle, uint32_t dictId);
+		uint32_t getHistoryId(uint32_t handle) const;
+		void setHistoryId(uint32_t handle, uint32_t historyId);
+		uint32_t getAggregateSlot(uint32_t handle) const;
+		void setAggregateSlot(uint32_t handle, uint32_t slot);
+		uint32_t getCompressorSlot(uint32_t handle) const;
+		void setCompressorSlot(uint32_t handle, uint32_t slot);
+		void holdBack(uint32_t handle, const char * path, SINK_Format_t format, const SINK_Item_t & item);
+		std::unordered_map<uint32_t, std::deque<OPCUA_HeldBack_t>> & getHeldBack();
+		size_t getMemoryUsage() const;
+		void reportMetrics(int32_t serverId);
+		static const uint16_t npos = 0xFFFF;
+	private:
+		uint16_t internGroup(OPCUA_Group * const group);
+		uint16_t internSettings(const OPCUA_ItemSettings_t & settings);
+		std::vector<OPCUA_Group *> m_groupPool;
+		std::vector<OPCUA_ItemSettings_t> m_settingsPool;
+		OPCUA_Column<uint32_t> m_nodes;
+		OPCUA_Column<uint16_t> m_groups;
+		OPCUA_Column<uint16_t> m_settings;
+		OPCUA_Column<uint32_t> m_subscriptionIds;
+		OPCUA_Column<uint32_t> m_monitoredItemIds;
+		OPCUA_Column<std::atomic<bool>> m_registered;
+		OPCUA_Column<uint16_t> m_types;
+		OPCUA_Column<double> m_lastValues;
+		OPCUA_Column<UA_DateTime> m_lastTimes;
+		OPCUA_Column<uint32_t> m_counts;
+		OPCUA_Column<uint32_t> m_dictIds;
+		OPCUA_Column<uint32_t> m_historyIds;
+		OPCUA_Column<uint32_t> m_aggregateSlots;
+		OPCUA_Column<uint32_t> m_compressorSlots;
+		std::unordered_map<uint32_t, std::deque<OPCUA_HeldBack_t>> m_heldBack;
+		size_t m_heldBackLimit;
+		uint64_t m_heldBackDropped;
+	};
+
+}
+
+#endif // TAGSTORE_H
\ No newline at end of file
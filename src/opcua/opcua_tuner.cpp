@@ -0,0 +1,122 @@
+#include "opcua_tuner.h"
+#include <algorithm>
+#include <cstdio>
+#include <open62541.h>
+#include "../macros.h"
+
+// For convenience
+using json = nlohmann::json;
+
+namespace gateway
+{
+
+	OPCUA_Tuner::OPCUA_Tuner(
+		const json & jsonConfig,
+		const OPCUA_Tuning_t & initial,
+		uint32_t maxKeepAliveCount,
+		double timeout
+	) :
+		m_enabled(false),
+		m_period(30000.0),
+		m_minPublishInterval(initial.publishInterval),
+		m_maxPublishInterval(initial.publishInterval),
+		m_minNotificationsPerPublish(initial.maxNotificationsPerPublish),
+		m_maxNotificationsPerPublish(initial.maxNotificationsPerPublish),
+		m_backlogHigh(0.5),
+		m_lagFactor(4.0)
+	{
+		// Without bounds the configured values stay fixed
+		m_enabled = jsonConfig.value("enabled", m_enabled);
+		m_period = jsonConfig.value("period", m_period);
+		m_minPublishInterval = jsonConfig.value("minPublishInterval", m_minPublishInterval);
+		m_maxPublishInterval = jsonConfig.value("maxPublishInterval", m_maxPublishInterval);
+		m_minNotificationsPerPublish = jsonConfig.value("minNotificationsPerPublish", m_minNotificationsPerPublish);
+		m_maxNotificationsPerPublish = jsonConfig.value("maxNotificationsPerPublish", m_maxNotificationsPerPublish);
+		m_backlogHigh = jsonConfig.value("backlogHigh", m_backlogHigh);
+		m_lagFactor = jsonConfig.value("lagFactor", m_lagFactor);
+
+		if (m_minPublishInterval > m_maxPublishInterval)
+			std::swap(m_minPublishInterval, m_maxPublishInterval);
+
+		if (m_minNotificationsPerPublish > m_maxNotificationsPerPublish)
+			std::swap(m_minNotificationsPerPublish, m_maxNotificationsPerPublish);
+
+		// A publish times out once the keep-alive period gets near the client timeout, and that reads as a lost session
+		double keepAliveLimit = timeout * 0.5 / std::max<uint32_t>(1, maxKeepAliveCount);
+		if (m_enabled && m_maxPublishInterval > keepAliveLimit)
+		{
+			WRN("OPCUA_Tuner maxPublishInterval %.0f ms capped to %.0f ms, %u keep-alive intervals must stay within half the client timeout of %.0f ms\n", UA_DateTime_now(), m_maxPublishInterval, keepAliveLimit, maxKeepAliveCount, timeout);
+
+			m_maxPublishInterval = std::max(m_minPublishInterval, keepAliveLimit);
+		}
+	}
+
+	bool OPCUA_Tuner::evaluate(const OPCUA_SessionStats_t & stats, double backlog, OPCUA_Tuning_t & tuning, std::string & reason) const
+	{
+		char buffer[256];
+
+		if (stats.dataPublishes == 0)
+		{
+			reason = "no data received, keeping settings";
+			return false;
+		}
+
+		// A maxNotificationsPerPublish of 0 means unlimited, the batch size is never the bottleneck then
+		double perPublish = (double) stats.notifications / stats.dataPublishes;
+		double fill = (tuning.maxNotificationsPerPublish > 0) ? perPublish / tuning.maxNotificationsPerPublish : 0.0;
+		double moreRatio = (double) stats.moreNotifications / stats.dataPublishes;
+		double lag = (stats.laggedPublishes > 0) ? stats.lag / stats.laggedPublishes : 0.0;
+
+		OPCUA_Tuning_t next = tuning;
+
+		if (backlog >= m_backlogHigh)
+		{
+			// Egress falls behind, let the server queue and coalesce for longer
+			next.publishInterval = std::min(m_maxPublishInterval, tuning.publishInterval * 2.0);
+			std::snprintf(buffer, sizeof(buffer), "egress backlog %.0f%%", backlog * 100.0);
+		}
+		else if (moreRatio > 0.1 || fill >= 0.9)
+		{
+			// The server has more than fits in one response, send larger batches
+			if (tuning.maxNotificationsPerPublish > 0)
+				next.maxNotificationsPerPublish = std::min(m_maxNotificationsPerPublish, tuning.maxNotificationsPerPublish * 2);
+			std::snprintf(buffer, sizeof(buffer), "batches full, %.0f notifications per publish, %.0f%% more pending", perPublish, moreRatio * 100.0);
+		}
+		else if (fill < 0.25)
+		{
+			// Plenty of headroom, trade some throughput for lower latency
+			next.publishInterval = std::max(m_minPublishInterval, tuning.publishInterval * 0.5);
+			next.maxNotificationsPerPublish = std::max(m_minNotificationsPerPublish, std::min(m_maxNotificationsPerPublish, next.maxNotificationsPerPublish));
+			std::snprintf(buffer, sizeof(buffer), "headroom, %.0f notifications per publish", perPublish);
+		}
+		else if (lag > tuning.publishInterval * m_lagFactor)
+		{
+			// Values wait in the server far longer than the interval, the server or link is congested
+			next.publishInterval = std::min(m_maxPublishInterval, tuning.publishInterval * 2.0);
+			std::snprintf(buffer, sizeof(buffer), "delivery lag %.0f ms", lag);
+		}
+		else
+		{
+			std::snprintf(buffer, sizeof(buffer), "balanced, %.0f notifications per publish, lag %.0f ms", perPublish, lag);
+		}
+
+		reason = buffer;
+
+		if (next.publishInterval == tuning.publishInterval && next.maxNotificationsPerPublish == tuning.maxNotificationsPerPublish)
+			return false;
+
+		tuning = next;
+		return true;
+	}
+
+	bool OPCUA_Tuner::isEnabled() const
+	{
+		return m_enabled;
+	}
+
+	double OPCUA_Tuner::getPeriod() const
+	{
+		return m_period;
+	}
+
+}
\ No newline at end of file
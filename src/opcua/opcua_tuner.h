@@ -0,0 +1,63 @@
+#ifndef TUNER_H
+#define TUNER_H
+
+#include <string>
+#include <cstdint>
+#include "../3rdparty/json.hpp"
+
+namespace gateway
+{
+
+	// Load a session measured since the previous evaluation
+	struct OPCUA_SessionStats_t
+	{
+		uint64_t publishes;
+		uint64_t dataPublishes;
+		uint64_t notifications;
+		uint64_t moreNotifications;
+		uint64_t laggedPublishes;
+		double lag;
+		size_t maxQueued;
+	};
+
+	// Subscription parameters the tuner adjusts
+	struct OPCUA_Tuning_t
+	{
+		double publishInterval;
+		uint32_t maxNotificationsPerPublish;
+	};
+
+	// The "tuning" object of ua_client_config. Adjusts the publishing interval
+	// and notifications per publish of a session within configured bounds:
+	// larger batches while the server has more than fits in one response,
+	// shorter intervals while there is headroom and longer ones while egress
+	// falls behind or values wait in the server for over lagFactor intervals.
+	// An idle subscription answers a publish only after maxKeepAliveCount
+	// intervals, maxPublishInterval is capped so that keep-alive period stays
+	// within half the client timeout and an idle publish never times out.
+	class OPCUA_Tuner
+	{
+	public:
+		OPCUA_Tuner(
+			const nlohmann::json & jsonConfig,
+			const OPCUA_Tuning_t & initial,
+			uint32_t maxKeepAliveCount,
+			double timeout
+		);
+		bool evaluate(const OPCUA_SessionStats_t & stats, double backlog, OPCUA_Tuning_t & tuning, std::string & reason) const;
+		bool isEnabled() const;
+		double getPeriod() const;
+	private:
+		bool m_enabled;
+		double m_period;
+		double m_minPublishInterval;
+		double m_maxPublishInterval;
+		uint32_t m_minNotificationsPerPublish;
+		uint32_t m_maxNotificationsPerPublish;
+		double m_backlogHigh;
+		double m_lagFactor;
+	};
+
+}
+
+#endif // TUNER_H
\ No newline at end of file
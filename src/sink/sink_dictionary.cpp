@@ -0,0 +1,105 @@
+#include "sink_dictionary.h"
+#include <algorithm>
+#include "../codec/codec_binary.h"
+
+namespace gateway
+{
+
+	const uint32_t SINK_Dictionary::npos;
+
+	SINK_Dictionary::SINK_Dictionary() :
+		m_mutex(),
+		m_ids(),
+		m_entries()
+	{
+
+	}
+
+	SINK_Dictionary & SINK_Dictionary::instance()
+	{
+		static SINK_Dictionary dictionary;
+		return dictionary;
+	}
+
+	uint32_t SINK_Dictionary::intern(uint64_t key, int32_t serverId, uint16_t nsIndex, const char * identifier, size_t length)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		auto it = m_ids.find(key);
+		if (it != m_ids.end())
+			return it->second;
+
+		uint32_t id = (uint32_t) m_entries.size();
+
+		// Encode the entry record once, including its length prefix
+		std::string record;
+		record += (char) CODEC_KIND_ENTRY;
+		codec_putvarint(record, id);
+		codec_putvarint(record, codec_zigzag(serverId));
+		codec_putvarint(record, nsIndex);
+		codec_putvarint(record, length);
+		record.append(identifier, length);
+
+		std::string entry;
+		codec_putvarint(entry, record.size());
+		entry += record;
+
+		m_entries.push_back(std::move(entry));
+		m_ids[key] = id;
+
+		return id;
+	}
+
+	void SINK_Dictionary::appendEntry(uint32_t id, std::string & out)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		out += m_entries[id];
+	}
+
+	size_t SINK_Dictionary::size()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_entries.size();
+	}
+
+	SINK_DictionaryScope::SINK_DictionaryScope() :
+		m_sent()
+	{
+
+	}
+
+	void SINK_DictionaryScope::reset()
+	{
+		std::fill(m_sent.begin(), m_sent.end(), false);
+	}
+
+	bool SINK_DictionaryScope::define(uint32_t dictId, std::string & out)
+	{
+		if (dictId == SINK_Dictionary::npos)
+			return false;
+
+		if (dictId >= m_sent.size())
+			m_sent.resize(dictId + 1, false);
+
+		if (m_sent[dictId])
+			return false;
+
+		SINK_Dictionary::instance().appendEntry(dictId, out);
+		m_sent[dictId] = true;
+
+		return true;
+	}
+
+	void SINK_DictionaryScope::begin(std::string & out)
+	{
+		reset();
+		out.append(CODEC_MAGIC, sizeof(CODEC_MAGIC));
+	}
+
+	void SINK_DictionaryScope::append(const SINK_Message_t & message, std::string & out)
+	{
+		define(message.dictId, out);
+		out.append(message.body.data(), message.body.size());
+	}
+
+}
\ No newline at end of file
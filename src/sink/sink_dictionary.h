@@ -0,0 +1,51 @@
+#ifndef SINK_DICTIONARY_H
+#define SINK_DICTIONARY_H
+
+#include <string>
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include "sink_sink.h"
+
+namespace gateway
+{
+
+	// Process wide ids of the identifiers in the binary format. The serializer
+	// interns every tag once, sinks fetch the encoded entry of an id the first
+	// time it goes out on one of their streams.
+	class SINK_Dictionary
+	{
+	public:
+		static SINK_Dictionary & instance();
+		uint32_t intern(uint64_t key, int32_t serverId, uint16_t nsIndex, const char * identifier, size_t length);
+		void appendEntry(uint32_t id, std::string & out);
+		size_t size();
+		static const uint32_t npos = 0xFFFFFFFF;
+	private:
+		SINK_Dictionary();
+		std::mutex m_mutex;
+		std::unordered_map<uint64_t, uint32_t> m_ids;
+		std::vector<std::string> m_entries;
+	};
+
+	// The entries sent on one binary stream of a sink. begin() starts a new
+	// stream, eg. per POST body or datagram, append() writes a record and
+	// the dictionary entry it refers to if the stream has not seen it yet.
+	// reset() and define() do the same for sinks that place the magic and
+	// record bodies themselves.
+	class SINK_DictionaryScope
+	{
+	public:
+		SINK_DictionaryScope();
+		void reset();
+		bool define(uint32_t dictId, std::string & out);
+		void begin(std::string & out);
+		void append(const SINK_Message_t & message, std::string & out);
+	private:
+		std::vector<bool> m_sent;
+	};
+
+}
+
+#endif // SINK_DICTIONARY_H
\ No newline at end of file
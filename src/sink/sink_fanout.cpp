@@ -0,0 +1,130 @@
+#include "sink_fanout.h"
+#include <algorithm>
+#include <open62541.h>
+#include "../macros.h"
+#include "sink_rest.h"
+#include "sink_file.h"
+#include "sink_socket.h"
+#include "../util/metrics.h"
+#include "../3rdparty/json.hpp"
+
+// For convenience
+using json = nlohmann::json;
+
+namespace gateway
+{
+
+	SINK_Fanout::SINK_Fanout(
+		const std::string & jsonSinksConfig,
+		const std::string & jsonRestConfig
+	) :
+		m_sinks(),
+		m_backpressure(),
+		m_formats()
+	{
+		json jsonSinks = json::parse(jsonSinksConfig);
+		json jsonRest = json::parse(jsonRestConfig);
+
+		// Without a sinks list everything goes to REST as before
+		if (jsonSinks.is_array() == false)
+			jsonSinks = json::array({ { { "type", "rest" }, { "name", "rest" } } });
+
+		for (json & jsonSink : jsonSinks)
+		{
+			if (jsonSink.value("enabled", true) == false)
+				continue;
+
+			std::string type = jsonSink.value("type", std::string("rest"));
+			std::string name = jsonSink.value("name", type);
+			SINK_Sink * sink = NULL;
+
+			if (type == "rest")
+			{
+				// The REST connection settings come from ua_rest_config unless the sink overrides them
+				json jsonCfg = jsonRest;
+				for (json::iterator it = jsonSink.begin(); it != jsonSink.end(); ++it)
+					jsonCfg[it.key()] = it.value();
+
+				sink = new SINK_Rest(name, jsonCfg.dump());
+			}
+			else if (type == "file")
+				sink = new SINK_File(name, jsonSink.dump());
+			else if (type == "udp")
+				sink = new SINK_Socket(name, jsonSink.dump(), SINK_SOCKET_UDP);
+			else if (type == "unix")
+				sink = new SINK_Socket(name, jsonSink.dump(), SINK_SOCKET_UNIX);
+			else
+			{
+				ERR("SINK_Fanout unknown sink type %s for sink %s, skipped.\n", UA_DateTime_now(), type.c_str(), name.c_str());
+				continue;
+			}
+
+			sink->start();
+			m_sinks.push_back(sink);
+			m_backpressure.push_back(jsonSink.value("backpressure", type == "rest"));
+			m_formats[sink->getFormat()] = true;
+		}
+
+		LOG("SINK_Fanout initialized successfully, sinks: %u\n", UA_DateTime_now(), (unsigned int) m_sinks.size());
+	}
+
+	SINK_Fanout::~SINK_Fanout()
+	{
+		for (SINK_Sink * sink : m_sinks)
+			delete sink;
+	}
+
+	size_t SINK_Fanout::push(const std::string & path, SINK_Format_t format, const SINK_Item_t * items, size_t count)
+	{
+		size_t n_queued = 0;
+
+		// The sinks only take another reference to the payload, the bytes are never copied
+		for (SINK_Sink * sink : m_sinks)
+		{
+			if (sink->getFormat() == format)
+				n_queued = std::max(n_queued, sink->push(path, items, count));
+		}
+
+		return n_queued;
+	}
+
+	bool SINK_Fanout::usesFormat(SINK_Format_t format) const
+	{
+		return m_formats[format];
+	}
+
+	double SINK_Fanout::getLoad()
+	{
+		double load = 0.0;
+
+		// The fullest sink decides, the others are ahead of it
+		for (size_t i = 0; i < m_sinks.size(); i++)
+		{
+			if (m_backpressure[i])
+				load = std::max(load, m_sinks[i]->getLoad());
+		}
+
+		return load;
+	}
+
+	size_t SINK_Fanout::getSinkCount() const
+	{
+		return m_sinks.size();
+	}
+
+	SINK_Sink * SINK_Fanout::getSink(size_t index)
+	{
+		return m_sinks[index];
+	}
+
+	void SINK_Fanout::reportMetrics()
+	{
+		// Serialized batches still referenced by a queue or a write in progress
+		Metrics::instance().set("sink.payload_bytes", (double) Payload::getBytesInFlight());
+		Metrics::instance().set("sink.payloads", (double) Payload::getCountInFlight());
+
+		for (SINK_Sink * sink : m_sinks)
+			sink->reportMetrics();
+	}
+
+}
\ No newline at end of file
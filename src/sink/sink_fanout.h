@@ -0,0 +1,39 @@
+#ifndef SINK_FANOUT_H
+#define SINK_FANOUT_H
+
+#include <string>
+#include <vector>
+#include "sink_sink.h"
+
+namespace gateway
+{
+
+	// The configured sinks of the gateway. The caller serializes every batch
+	// once per wire format in use into a shared payload, all sinks of that
+	// format queue slices of the same bytes. Sinks write on their own threads,
+	// so a slow or failing one only sheds its own load.
+	// Only sinks with backpressure (REST by default) count towards the load
+	// the subscriptions are tuned by.
+	class SINK_Fanout
+	{
+	public:
+		SINK_Fanout(
+			const std::string & jsonSinksConfig,
+			const std::string & jsonRestConfig
+		);
+		~SINK_Fanout();
+		size_t push(const std::string & path, SINK_Format_t format, const SINK_Item_t * items, size_t count);
+		bool usesFormat(SINK_Format_t format) const;
+		double getLoad();
+		size_t getSinkCount() const;
+		SINK_Sink * getSink(size_t index);
+		void reportMetrics();
+	private:
+		std::vector<SINK_Sink *> m_sinks;
+		std::vector<bool> m_backpressure;
+		bool m_formats[SINK_FORMAT_COUNT];
+	};
+
+}
+
+#endif // SINK_FANOUT_H
\ No newline at end of file
@@ -0,0 +1,71 @@
+#include "sink_file.h"
+#include <open62541.h>
+#include "../macros.h"
+#include "../3rdparty/json.hpp"
+
+// For convenience
+using json = nlohmann::json;
+
+namespace gateway
+{
+
+	SINK_File::SINK_File(
+		const std::string & name,
+		const std::string & jsonConfig
+	) :
+		SINK_Sink(name, jsonConfig),
+		m_path(),
+		m_file(NULL),
+		m_buffer(),
+		m_scope()
+	{
+		json jsonCfg = json::parse(jsonConfig);
+		m_path = jsonCfg.value("path", std::string("./res/variables.ndjson"));
+
+		m_file = fopen(m_path.c_str(), "ab");
+
+		if (m_file == NULL)
+			ERR("SINK_File(%s) cannot open %s for appending.\n", UA_DateTime_now(), name.c_str(), m_path.c_str());
+		else if (getFormat() == SINK_FORMAT_BINARY)
+			m_scope.begin(m_buffer);
+	}
+
+	SINK_File::~SINK_File()
+	{
+		stop();
+
+		if (m_file != NULL)
+			fclose(m_file);
+	}
+
+	bool SINK_File::write(const std::vector<SINK_Message_t> & messages)
+	{
+		if (m_file == NULL)
+			return false;
+
+		if (getFormat() == SINK_FORMAT_BINARY)
+		{
+			for (const SINK_Message_t & message : messages)
+				m_scope.append(message, m_buffer);
+
+			bool ok = fwrite(m_buffer.data(), 1, m_buffer.size(), m_file) == m_buffer.size();
+			m_buffer.clear();
+
+			return ok;
+		}
+
+		for (const SINK_Message_t & message : messages)
+		{
+			if (fwrite(message.body.data(), 1, message.body.size(), m_file) != message.body.size() || fputc('\n', m_file) == EOF)
+				return false;
+		}
+
+		return true;
+	}
+
+	bool SINK_File::flush()
+	{
+		return m_file != NULL && fflush(m_file) == 0;
+	}
+
+}
\ No newline at end of file
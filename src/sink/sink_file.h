@@ -0,0 +1,36 @@
+#ifndef SINK_FILE_H
+#define SINK_FILE_H
+
+#include <string>
+#include <cstdio>
+#include "sink_sink.h"
+#include "sink_dictionary.h"
+
+namespace gateway
+{
+
+	// Appends variables to a local file, one JSON body per line (NDJSON) or
+	// in the binary format, where every time the file is opened starts a new
+	// stream. Data is written through the stdio buffer and flushed once the
+	// sink has nothing more due.
+	class SINK_File : public SINK_Sink
+	{
+	public:
+		SINK_File(
+			const std::string & name,
+			const std::string & jsonConfig
+		);
+		~SINK_File();
+	protected:
+		bool write(const std::vector<SINK_Message_t> & messages) override;
+		bool flush() override;
+	private:
+		std::string m_path;
+		FILE * m_file;
+		std::string m_buffer;
+		SINK_DictionaryScope m_scope;
+	};
+
+}
+
+#endif // SINK_FILE_H
\ No newline at end of file
@@ -0,0 +1,250 @@
+#include "sink_rest.h"
+#include <algorithm>
+#include <cstring>
+#include <open62541.h>
+#include "../macros.h"
+#include "../http/http_client.h"
+#include "../codec/codec_binary.h"
+
+// For convenience
+using json = nlohmann::json;
+
+namespace gateway
+{
+
+	SINK_Rest::SINK_Rest(
+		const std::string & name,
+		const std::string & jsonConfig
+	) :
+		SINK_Sink(name, jsonConfig),
+		m_httpClient(new HTTP_Client(jsonConfig)),
+		m_batchPost(true),
+		m_stream(false),
+		m_rotateInterval(60000.0),
+		m_rotateBytes(64 * 1024 * 1024),
+		m_streamIdle(5000.0),
+		m_streamPath(),
+		m_streamMessages(),
+		m_streamIndex(0),
+		m_streamOffset(0),
+		m_streamBytes(0),
+		m_streamStart(),
+		m_body(4 * 1024),
+		m_entry(),
+		m_scope()
+	{
+		json jsonCfg = json::parse(jsonConfig);
+		m_batchPost = jsonCfg.value("batchPost", m_batchPost);
+		m_stream = jsonCfg.value("stream", m_stream);
+		m_rotateInterval = jsonCfg.value("rotateInterval", m_rotateInterval);
+		m_rotateBytes = jsonCfg.value("rotateBytes", m_rotateBytes);
+		m_streamIdle = jsonCfg.value("streamIdle", m_streamIdle);
+
+		if (m_stream && getFormat() != SINK_FORMAT_JSON)
+		{
+			WRN("SINK_Rest(%s) streams NDJSON only, stream is ignored for this format\n", UA_DateTime_now(), name.c_str());
+			m_stream = false;
+		}
+	}
+
+	SINK_Rest::~SINK_Rest()
+	{
+		stop();
+		DELETES(m_httpClient);
+	}
+
+	void SINK_Rest::reportMetrics()
+	{
+		SINK_Sink::reportMetrics();
+		m_httpClient->reportMetrics();
+	}
+
+	bool SINK_Rest::write(const std::vector<SINK_Message_t> & messages)
+	{
+		if (m_stream)
+			return stream(messages);
+
+		if (getFormat() == SINK_FORMAT_BINARY)
+		{
+			// Records stay in their payloads, only the dictionary entries are copied into the body
+			m_body.clear();
+			m_scope.reset();
+			m_body.append(CODEC_MAGIC, sizeof(CODEC_MAGIC));
+			for (const SINK_Message_t & message : messages)
+			{
+				m_entry.clear();
+				if (m_scope.define(message.dictId, m_entry))
+					m_body.copy(m_entry.data(), m_entry.size());
+				m_body.append(message.body.data(), message.body.size());
+			}
+
+			return post(messages);
+		}
+
+		if (m_batchPost && messages.size() > 1)
+		{
+			// The bodies of the batch as one JSON array
+			m_body.clear();
+			m_body.reserve(2 * messages.size() + 1);
+			m_body.append("[", 1);
+			for (size_t i = 0; i < messages.size(); i++)
+			{
+				if (i > 0)
+					m_body.append(",", 1);
+				m_body.append(messages[i].body.data(), messages[i].body.size());
+			}
+			m_body.append("]", 1);
+
+			return post(messages);
+		}
+
+		// Only the bodies that did not get through are queued again
+		std::vector<SINK_Message_t> failed;
+		for (const SINK_Message_t & message : messages)
+		{
+			if (send(message.path, message.body.data(), message.body.size()) == false)
+				failed.push_back(message);
+		}
+
+		requeue(failed, 0);
+		return failed.empty();
+	}
+
+	bool SINK_Rest::post(const std::vector<SINK_Message_t> & messages)
+	{
+		// A batch that did not get through is queued again, like the messages of a failed stream
+		if (send(messages.front().path, m_body))
+			return true;
+
+		requeue(messages, 0);
+		return false;
+	}
+
+	bool SINK_Rest::flush()
+	{
+		// Every write is a complete request, nothing is buffered
+		return true;
+	}
+
+	bool SINK_Rest::stream(const std::vector<SINK_Message_t> & messages)
+	{
+		m_streamMessages = messages;
+		m_streamIndex = 0;
+		m_streamOffset = 0;
+
+		bool ok = true;
+
+		// A stream carries the messages of one path, a message of another path starts the next one
+		while (m_streamIndex < m_streamMessages.size())
+		{
+			size_t first = m_streamIndex;
+
+			m_streamPath = m_streamMessages[m_streamIndex].path;
+			m_streamStart = std::chrono::steady_clock::now();
+			m_streamBytes = 0;
+
+			ok = m_httpClient->streamBody(m_streamPath, HTTP_POST, &SINK_Rest::readStream, this);
+
+			// The messages of a failed request may not have arrived, they are queued again with the unsent ones
+			if (ok == false)
+			{
+				requeue(m_streamMessages, first);
+				break;
+			}
+		}
+
+		m_streamMessages.clear();
+		m_streamIndex = 0;
+		m_streamOffset = 0;
+		return ok;
+	}
+
+	size_t SINK_Rest::read(char * buffer, size_t size)
+	{
+		size_t n = 0;
+
+		while (n < size)
+		{
+			// The messages of the request are kept until it completed, pull() appends to them
+			if (m_streamIndex == m_streamMessages.size())
+			{
+				// Hand over what is buffered before waiting for more
+				if (n > 0)
+					break;
+
+				// Rotate the request at a record boundary
+				double elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_streamStart).count();
+				if (elapsed >= m_rotateInterval || m_streamBytes >= m_rotateBytes)
+					return 0;
+
+				// End the body when stopping or idle, the next message opens a new stream
+				if (pull(m_streamMessages, m_streamIdle) == false || m_streamMessages.empty())
+					return 0;
+
+				continue;
+			}
+
+			const SINK_Message_t & message = m_streamMessages[m_streamIndex];
+
+			if (message.path != m_streamPath)
+			{
+				if (n > 0)
+					break;
+				return 0;
+			}
+
+			// Copy the rest of the body and its newline, a body may span several calls
+			size_t total = message.body.size() + 1;
+			size_t count = std::min(size - n, total - m_streamOffset);
+			size_t fromBody = (m_streamOffset < message.body.size()) ? std::min(count, message.body.size() - m_streamOffset) : 0;
+
+			memcpy(buffer + n, message.body.data() + m_streamOffset, fromBody);
+			if (fromBody < count)
+				buffer[n + fromBody] = '\n';
+
+			n += count;
+			m_streamOffset += count;
+
+			if (m_streamOffset == total)
+			{
+				m_streamIndex++;
+				m_streamOffset = 0;
+			}
+		}
+
+		m_streamBytes += n;
+		return n;
+	}
+
+	size_t SINK_Rest::readStream(void * buffer, size_t size, size_t count, void * userdata)
+	{
+		return ((SINK_Rest *) userdata)->read((char *) buffer, size * count);
+	}
+
+	bool SINK_Rest::send(const std::string & path, HTTP_Body & body)
+	{
+		try
+		{
+			return m_httpClient->sendBody(path, HTTP_POST, body, (getFormat() == SINK_FORMAT_BINARY) ? "application/octet-stream" : "application/json");
+		}
+		catch (const std::exception & e)
+		{
+			ERR("SINK_Rest(%s) Exception: %s\n", UA_DateTime_now(), getName().c_str(), e.what());
+			return false;
+		}
+	}
+
+	bool SINK_Rest::send(const std::string & path, const char * data, size_t size)
+	{
+		try
+		{
+			return m_httpClient->sendBody(path, HTTP_POST, data, size, (getFormat() == SINK_FORMAT_BINARY) ? "application/octet-stream" : "application/json");
+		}
+		catch (const std::exception & e)
+		{
+			ERR("SINK_Rest(%s) Exception: %s\n", UA_DateTime_now(), getName().c_str(), e.what());
+			return false;
+		}
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#ifndef SINK_REST_H
+#define SINK_REST_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include "sink_sink.h"
+#include "sink_dictionary.h"
+#include "../http/http_body.h"
+
+namespace gateway
+{
+
+	class HTTP_Client;
+
+	// POSTs variables to REST with an HTTP_Client of its own. With batchPost,
+	// the default, a whole batch goes out as one JSON array, otherwise one
+	// POST per body.
+	// In the binary format every batch is one POST and a stream of its own.
+	// Batch bodies are segments over the queued payloads, never joined.
+	// Bodies are gzipped by the HTTP_Client when compression is configured.
+	// With stream, JSON bodies go out as NDJSON over one long-lived chunked
+	// POST instead: its read callback copies bodies straight from the queued
+	// payloads and pulls more off the queue, and the request is rotated every
+	// rotateInterval ms or rotateBytes, or closed after streamIdle ms idle.
+	// The messages of a streamed request are held until it completed and are
+	// queued again when it failed, as are the messages of a failed POST.
+	class SINK_Rest : public SINK_Sink
+	{
+	public:
+		SINK_Rest(
+			const std::string & name,
+			const std::string & jsonConfig
+		);
+		~SINK_Rest();
+		void reportMetrics() override;
+	protected:
+		bool write(const std::vector<SINK_Message_t> & messages) override;
+		bool flush() override;
+	private:
+		bool post(const std::vector<SINK_Message_t> & messages);
+		bool send(const std::string & path, const char * data, size_t size);
+		bool send(const std::string & path, HTTP_Body & body);
+		bool stream(const std::vector<SINK_Message_t> & messages);
+		size_t read(char * buffer, size_t size);
+		static size_t readStream(void * buffer, size_t size, size_t count, void * userdata);
+		HTTP_Client * m_httpClient;
+		bool m_batchPost;
+		bool m_stream;
+		double m_rotateInterval;
+		size_t m_rotateBytes;
+		double m_streamIdle;
+		std::string m_streamPath;
+		std::vector<SINK_Message_t> m_streamMessages;
+		size_t m_streamIndex;
+		size_t m_streamOffset;
+		size_t m_streamBytes;
+		std::chrono::steady_clock::time_point m_streamStart;
+		HTTP_Body m_body;
+		std::string m_entry;
+		SINK_DictionaryScope m_scope;
+	};
+
+}
+
+#endif // SINK_REST_H
\ No newline at end of file
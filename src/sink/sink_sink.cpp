@@ -0,0 +1,439 @@
+#include "sink_sink.h"
+#include <algorithm>
+#include <open62541.h>
+#include "../macros.h"
+#include "../util/metrics.h"
+#include "../3rdparty/json.hpp"
+
+// For convenience
+using json = nlohmann::json;
+
+namespace gateway
+{
+
+	SINK_Priority_t SINK_ParsePriority(const std::string & name)
+	{
+		if (name == "critical")
+			return SINK_PRIORITY_CRITICAL;
+		else if (name == "low")
+			return SINK_PRIORITY_LOW;
+		else
+			return SINK_PRIORITY_NORMAL;
+	}
+
+	const char * SINK_PriorityName(SINK_Priority_t priority)
+	{
+		switch (priority)
+		{
+		case SINK_PRIORITY_CRITICAL: return "critical";
+		case SINK_PRIORITY_LOW: return "low";
+		default: return "normal";
+		}
+	}
+
+	SINK_Format_t SINK_ParseFormat(const std::string & name)
+	{
+		if (name == "binary")
+			return SINK_FORMAT_BINARY;
+		else
+			return SINK_FORMAT_JSON;
+	}
+
+	SINK_Sink::SINK_Sink(
+		const std::string & name,
+		const std::string & jsonConfig
+	) :
+		m_name(name),
+		m_format(SINK_FORMAT_JSON),
+		m_queueLimit(10000),
+		m_coalesceAt(0.5),
+		m_dropAt(0.75),
+		m_batchInterval(50.0),
+		m_maxBatch(500),
+		m_drainTimeout(5000.0),
+		m_retryDelay(1000.0),
+		m_lanes(),
+		m_pending(0),
+		m_errors(0),
+		m_batchAt(),
+		m_retryAt(),
+		m_mutex(),
+		m_condition(),
+		m_running(false),
+		m_thread()
+	{
+		json jsonCfg = json::parse(jsonConfig);
+		m_format = SINK_ParseFormat(jsonCfg.value("format", std::string("json")));
+		m_queueLimit = jsonCfg.value("queueLimit", m_queueLimit);
+		m_coalesceAt = jsonCfg.value("coalesceAt", m_coalesceAt);
+		m_dropAt = jsonCfg.value("dropAt", m_dropAt);
+		m_batchInterval = jsonCfg.value("batchInterval", m_batchInterval);
+		m_maxBatch = std::max<size_t>(1, jsonCfg.value("maxBatch", m_maxBatch));
+		m_drainTimeout = jsonCfg.value("drainTimeout", m_drainTimeout);
+		m_retryDelay = jsonCfg.value("retryDelay", m_retryDelay);
+	}
+
+	SINK_Sink::~SINK_Sink()
+	{
+		stop();
+	}
+
+	void SINK_Sink::start()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (m_running)
+			return;
+
+		// Started by the owner once the derived sink is fully constructed
+		m_running = true;
+		m_thread = std::thread(&SINK_Sink::run, this);
+
+		LOG("SINK_Sink(%s) started, queue limit: %u\n", UA_DateTime_now(), m_name.c_str(), (unsigned int) m_queueLimit);
+	}
+
+	void SINK_Sink::stop()
+	{
+		// Stop the worker, it drains the queue before it returns
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_running = false;
+		}
+		m_condition.notify_all();
+
+		if (m_thread.joinable() == false)
+			return;
+
+		m_thread.join();
+
+		size_t n_dropped = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			n_dropped = m_pending;
+		}
+
+		if (n_dropped > 0)
+			WRN("SINK_Sink(%s) was stopped, %u pending messages were dropped after %.0f ms of draining.\n", UA_DateTime_now(), m_name.c_str(), (unsigned int) n_dropped, m_drainTimeout);
+	}
+
+	size_t SINK_Sink::push(const std::string & path, const SINK_Item_t * items, size_t count)
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+		bool wake = false;
+		size_t n_queued = 0;
+		{
+			// The whole batch is queued under one lock and wakes the worker at most once
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (size_t i = 0; i < count; i++)
+			{
+				if (enqueue(path, items[i], now, wake))
+					n_queued++;
+			}
+		}
+
+		if (wake)
+			m_condition.notify_one();
+
+		return n_queued;
+	}
+
+	bool SINK_Sink::enqueue(const std::string & path, const SINK_Item_t & item, std::chrono::steady_clock::time_point now, bool & wake)
+	{
+		SINK_Priority_t priority = item.priority;
+		SINK_Lane_t & lane = m_lanes[priority];
+		double load = (double) m_pending / m_queueLimit;
+
+		// Shed the lower classes first, critical messages are always queued
+		bool drop = (priority == SINK_PRIORITY_LOW && load >= m_dropAt) || (priority == SINK_PRIORITY_NORMAL && load >= 1.0);
+		bool coalesce = (priority == SINK_PRIORITY_LOW && load >= m_coalesceAt) || (priority == SINK_PRIORITY_NORMAL && load >= m_dropAt);
+
+		if (drop)
+		{
+			lane.dropped++;
+			return false;
+		}
+
+		// Replace the queued message of the same key, it keeps its place and queue time
+		if (coalesce)
+		{
+			auto it = lane.positions.find(item.key);
+
+			if (it != lane.positions.end())
+			{
+				SINK_Message_t & queued = lane.messages[it->second - lane.head];
+				queued.path = path;
+				queued.body = item.body;
+				queued.dictId = item.dictId;
+				lane.coalesced++;
+				return true;
+			}
+		}
+
+		// The first non-critical message of a round sets its deadline, critical messages skip the batch delay
+		if (priority == SINK_PRIORITY_CRITICAL)
+		{
+			wake = true;
+		}
+		else if (m_lanes[SINK_PRIORITY_NORMAL].messages.empty() && m_lanes[SINK_PRIORITY_LOW].messages.empty())
+		{
+			m_batchAt = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(m_batchInterval));
+			wake = true;
+		}
+
+		lane.positions[item.key] = lane.head + lane.messages.size();
+		lane.messages.push_back({ path, item.body, item.key, item.dictId, priority, now });
+		m_pending++;
+
+		return true;
+	}
+
+	SINK_Format_t SINK_Sink::getFormat() const
+	{
+		return m_format;
+	}
+
+	double SINK_Sink::getLoad()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return (double) m_pending / m_queueLimit;
+	}
+
+	size_t SINK_Sink::getPendingCount()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_pending;
+	}
+
+	size_t SINK_Sink::getQueueLimit() const
+	{
+		return m_queueLimit;
+	}
+
+	const std::string & SINK_Sink::getName() const
+	{
+		return m_name;
+	}
+
+	void SINK_Sink::reportMetrics()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::string prefix = "sink." + m_name + ".";
+
+		Metrics::instance().set(prefix + "pending", (double) m_pending);
+		Metrics::instance().add(prefix + "errors", (double) m_errors);
+		m_errors = 0;
+
+		for (int i = 0; i < SINK_PRIORITY_COUNT; i++)
+		{
+			SINK_Lane_t & lane = m_lanes[i];
+			std::string scope = prefix + SINK_PriorityName((SINK_Priority_t) i) + ".";
+
+			// Latency is averaged over the messages sent since the previous report
+			Metrics::instance().set(scope + "latency_ms", (lane.sent > 0) ? lane.latency / lane.sent : 0.0);
+			Metrics::instance().add(scope + "sent", (double) lane.sent);
+			Metrics::instance().add(scope + "coalesced", (double) lane.coalesced);
+			Metrics::instance().add(scope + "dropped", (double) lane.dropped);
+
+			lane.sent = 0;
+			lane.coalesced = 0;
+			lane.dropped = 0;
+			lane.latency = 0.0;
+		}
+	}
+
+	bool SINK_Sink::pop(std::vector<SINK_Message_t> & messages, SINK_Priority_t & priority)
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+		// After a failed write nothing goes out before the retry time, critical messages neither
+		if (now < m_retryAt)
+			return false;
+
+		// Critical messages always go first, the others once their round is due
+		bool due = now >= m_batchAt;
+
+		for (int i = 0; i < SINK_PRIORITY_COUNT; i++)
+		{
+			SINK_Lane_t & lane = m_lanes[i];
+
+			if (lane.messages.empty() || (i != SINK_PRIORITY_CRITICAL && due == false))
+				continue;
+
+			// Take a batch of consecutive messages of the same path off the lane
+			const std::string path = lane.messages.front().path;
+
+			while (lane.messages.empty() == false && messages.size() < m_maxBatch && lane.messages.front().path == path)
+			{
+				auto it = lane.positions.find(lane.messages.front().key);
+				if (it != lane.positions.end() && it->second == lane.head)
+					lane.positions.erase(it);
+
+				messages.push_back(std::move(lane.messages.front()));
+				lane.messages.pop_front();
+				lane.head++;
+				m_pending--;
+			}
+
+			priority = (SINK_Priority_t) i;
+			return true;
+		}
+
+		return false;
+	}
+
+	void SINK_Sink::requeue(const std::vector<SINK_Message_t> & messages, size_t first)
+	{
+		if (first >= messages.size())
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			// Back to front keeps their order. The newest message of a key is the one to coalesce into,
+			// unless a newer one of that key was queued meanwhile
+			for (size_t i = messages.size(); i > first; i--)
+			{
+				const SINK_Message_t & message = messages[i - 1];
+				SINK_Lane_t & lane = m_lanes[message.priority];
+				lane.messages.push_front(message);
+				lane.head--;
+				lane.positions.emplace(message.key, lane.head);
+				lane.sent -= std::min<uint64_t>(lane.sent, 1);
+				m_pending++;
+			}
+
+			// Retried after retryDelay for every lane, a sink that is down is not hammered
+			m_retryAt = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(m_retryDelay));
+		}
+
+		WRN("SINK_Sink(%s) queued %u messages again after a failed write\n", UA_DateTime_now(), m_name.c_str(), (unsigned int)(messages.size() - first));
+	}
+
+	bool SINK_Sink::pull(std::vector<SINK_Message_t> & messages, double timeout)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(timeout));
+
+		while (m_running)
+		{
+			SINK_Priority_t priority;
+			size_t first = messages.size();
+
+			if (pop(messages, priority))
+			{
+				// Pulled messages count as sent once handed over
+				std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+				for (size_t i = first; i < messages.size(); i++)
+					m_lanes[priority].latency += std::chrono::duration<double, std::milli>(now - messages[i].queuedAt).count();
+				m_lanes[priority].sent += messages.size() - first;
+
+				return true;
+			}
+
+			if (std::chrono::steady_clock::now() >= deadline)
+				return true;
+
+			// Wait for a critical message, the batch deadline, shutdown or the timeout
+			m_condition.wait_until(lock, (m_pending > 0) ? std::min(deadline, std::max(m_batchAt, m_retryAt)) : deadline);
+		}
+
+		return false;
+	}
+
+	void SINK_Sink::run()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		std::vector<SINK_Message_t> messages;
+		bool written = false;
+
+		while (m_running)
+		{
+			SINK_Priority_t priority;
+
+			messages.clear();
+			if (pop(messages, priority) == false)
+			{
+				// Out of due messages, push out whatever the sink still buffers
+				if (written)
+				{
+					lock.unlock();
+					bool flushed = flush();
+					lock.lock();
+
+					m_errors += flushed ? 0 : 1;
+					written = false;
+					continue;
+				}
+
+				// Wait for a critical message, the batch deadline or shutdown
+				if (m_pending > 0)
+					m_condition.wait_until(lock, std::max(m_batchAt, m_retryAt));
+				else
+					m_condition.wait(lock);
+
+				continue;
+			}
+
+			lock.unlock();
+
+			bool ok = write(messages);
+			written = true;
+
+			std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+			double latency = 0.0;
+			for (const SINK_Message_t & message : messages)
+				latency += std::chrono::duration<double, std::milli>(now - message.queuedAt).count();
+
+			lock.lock();
+			m_errors += ok ? 0 : 1;
+			m_lanes[priority].sent += messages.size();
+			m_lanes[priority].latency += latency;
+		}
+
+		drain(lock, written);
+
+		// Leave nothing behind in the buffers of the sink
+		lock.unlock();
+		if (written)
+			flush();
+	}
+
+	void SINK_Sink::drain(std::unique_lock<std::mutex> & lock, bool & written)
+	{
+		std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double, std::milli>(m_drainTimeout));
+		std::vector<SINK_Message_t> messages;
+		size_t n_drained = 0;
+
+		while (m_pending > 0 && std::chrono::steady_clock::now() < deadline)
+		{
+			SINK_Priority_t priority;
+
+			// Every round is due now, a late enqueue must not hold the rest back
+			m_batchAt = std::chrono::steady_clock::time_point();
+
+			messages.clear();
+			if (pop(messages, priority) == false)
+			{
+				// Waiting out a failed write, as long as the retry falls within the timeout
+				if (m_retryAt >= deadline)
+					break;
+
+				m_condition.wait_until(lock, m_retryAt);
+				continue;
+			}
+
+			lock.unlock();
+			bool ok = write(messages);
+			written = true;
+			lock.lock();
+
+			m_errors += ok ? 0 : 1;
+			m_lanes[priority].sent += messages.size();
+			n_drained += ok ? messages.size() : 0;
+		}
+
+		if (n_drained > 0)
+			LOG("SINK_Sink(%s) drained %u pending messages on stop.\n", UA_DateTime_now(), m_name.c_str(), (unsigned int) n_drained);
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,138 @@
+#ifndef SINK_H
+#define SINK_H
+
+#include <string>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "../util/payload.h"
+
+namespace gateway
+{
+
+	enum SINK_Priority_t
+	{
+		SINK_PRIORITY_CRITICAL,
+		SINK_PRIORITY_NORMAL,
+		SINK_PRIORITY_LOW,
+		SINK_PRIORITY_COUNT
+	};
+
+	// Wire formats of the serialized variables, each batch is serialized once
+	// per format some sink uses
+	enum SINK_Format_t
+	{
+		SINK_FORMAT_JSON,
+		SINK_FORMAT_BINARY,
+		SINK_FORMAT_COUNT
+	};
+
+	// One record of a batch handed to SINK_Sink::push in a single call, the
+	// body is a slice of the shared payload of the batch. Binary records refer
+	// to their identifier by a SINK_Dictionary id, JSON ones carry npos.
+	struct SINK_Item_t
+	{
+		PayloadSlice_t body;
+		uint64_t key;
+		SINK_Priority_t priority;
+		uint32_t dictId;
+	};
+
+	struct SINK_Message_t
+	{
+		std::string path;
+		PayloadSlice_t body;
+		uint64_t key;
+		uint32_t dictId;
+		SINK_Priority_t priority;
+		std::chrono::steady_clock::time_point queuedAt;
+	};
+
+	// Queue of a single priority class, positions maps a key to the sequence
+	// number of its newest queued message so it can be coalesced in place
+	struct SINK_Lane_t
+	{
+		std::deque<SINK_Message_t> messages;
+		std::unordered_map<uint64_t, uint64_t> positions;
+		uint64_t head;
+		uint64_t sent;
+		uint64_t coalesced;
+		uint64_t dropped;
+		double latency;
+	};
+
+	// A destination of serialized variables with a queue and a thread of its
+	// own, so a slow sink never holds up another one. Critical messages are
+	// written right away, the others in rounds every batchInterval. Under
+	// overload low priority messages are coalesced per key and then dropped,
+	// followed by normal ones; critical ones never are. The worker hands up to
+	// maxBatch messages of one path to write() at a time and calls flush()
+	// whenever it runs out of due messages. On stop() the queued messages are
+	// still written for up to drainTimeout ms, only what is left is dropped.
+	class SINK_Sink
+	{
+	public:
+		SINK_Sink(
+			const std::string & name,
+			const std::string & jsonConfig
+		);
+		virtual ~SINK_Sink();
+		void start();
+		size_t push(const std::string & path, const SINK_Item_t * items, size_t count);
+		SINK_Format_t getFormat() const;
+		double getLoad();
+		size_t getPendingCount();
+		size_t getQueueLimit() const;
+		const std::string & getName() const;
+		virtual void reportMetrics();
+	protected:
+		// Derived sinks stop the worker before releasing what write() uses
+		void stop();
+		// For sinks that keep writing within write(): takes the next due
+		// messages off the queue on the worker thread, waiting up to timeout ms.
+		// Returns false once the sink is stopping.
+		bool pull(std::vector<SINK_Message_t> & messages, double timeout);
+		// Puts messages a failed write() took off the queue back in front of
+		// their lanes in the given order, nothing goes out for retryDelay ms
+		void requeue(const std::vector<SINK_Message_t> & messages, size_t first);
+		virtual bool write(const std::vector<SINK_Message_t> & messages) = 0;
+		virtual bool flush() = 0;
+	private:
+		void run();
+		void drain(std::unique_lock<std::mutex> & lock, bool & written);
+		bool enqueue(const std::string & path, const SINK_Item_t & item, std::chrono::steady_clock::time_point now, bool & wake);
+		bool pop(std::vector<SINK_Message_t> & messages, SINK_Priority_t & priority);
+		std::string m_name;
+		SINK_Format_t m_format;
+		size_t m_queueLimit;
+		double m_coalesceAt;
+		double m_dropAt;
+		double m_batchInterval;
+		size_t m_maxBatch;
+		double m_drainTimeout;
+		double m_retryDelay;
+		SINK_Lane_t m_lanes[SINK_PRIORITY_COUNT];
+		size_t m_pending;
+		uint64_t m_errors;
+		std::chrono::steady_clock::time_point m_batchAt;
+		std::chrono::steady_clock::time_point m_retryAt;
+		std::mutex m_mutex;
+		std::condition_variable m_condition;
+		bool m_running;
+		std::thread m_thread;
+	};
+
+	// "critical", "normal" or "low", anything else is normal
+	SINK_Priority_t SINK_ParsePriority(const std::string & name);
+	const char * SINK_PriorityName(SINK_Priority_t priority);
+	// "json" or "binary", anything else is json
+	SINK_Format_t SINK_ParseFormat(const std::string & name);
+
+}
+
+#endif // SINK_H
\ No newline at end of file
@@ -0,0 +1,196 @@
+#include "sink_socket.h"
+#ifdef _WIN32
+#include <winsock2.h>
+#include <ws2tcpip.h>
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netdb.h>
+#include <unistd.h>
+#endif
+#include <cstring>
+#include <open62541.h>
+#include "../macros.h"
+#include "../codec/codec_binary.h"
+#include "../3rdparty/json.hpp"
+
+// For convenience
+using json = nlohmann::json;
+
+// Native socket handle, the member keeps it as intptr_t with -1 for none. Sends never
+// block, a datagram the receiver has no room for is dropped like on the wire
+#ifdef _WIN32
+typedef SOCKET socket_t;
+#define SINK_SEND_FLAGS 0
+#else
+typedef int socket_t;
+#define SINK_SEND_FLAGS MSG_DONTWAIT
+#endif
+
+namespace gateway
+{
+
+	SINK_Socket::SINK_Socket(
+		const std::string & name,
+		const std::string & jsonConfig,
+		SINK_SocketType_t type
+	) :
+		SINK_Sink(name, jsonConfig),
+		m_type(type),
+		m_socket(-1),
+		m_maxDatagram(1472),
+		m_datagram(),
+		m_scope()
+	{
+		json jsonCfg = json::parse(jsonConfig);
+		m_maxDatagram = jsonCfg.value("maxDatagram", m_maxDatagram);
+		m_datagram.reserve(m_maxDatagram);
+
+#ifdef _WIN32
+		WSADATA wsaData;
+		WSAStartup(MAKEWORD(2, 2), &wsaData);
+#endif
+
+		if (open(jsonConfig) == false)
+			ERR("SINK_Socket(%s) cannot open the socket, variables are dropped.\n", UA_DateTime_now(), name.c_str());
+	}
+
+	SINK_Socket::~SINK_Socket()
+	{
+		stop();
+		close();
+
+#ifdef _WIN32
+		WSACleanup();
+#endif
+	}
+
+	bool SINK_Socket::open(const std::string & jsonConfig)
+	{
+		json jsonCfg = json::parse(jsonConfig);
+
+		if (m_type == SINK_SOCKET_UNIX)
+		{
+#ifdef _WIN32
+			ERR("SINK_Socket(%s) Unix domain sockets are not supported on this platform.\n", UA_DateTime_now(), getName().c_str());
+			return false;
+#else
+			std::string path = jsonCfg.value("path", std::string(""));
+			sockaddr_un address;
+
+			if (path.empty() || path.size() >= sizeof(address.sun_path))
+				return false;
+
+			memset(&address, 0, sizeof(address));
+			address.sun_family = AF_UNIX;
+			memcpy(address.sun_path, path.c_str(), path.size());
+
+			m_socket = (intptr_t) socket(AF_UNIX, SOCK_DGRAM, 0);
+
+			if (m_socket < 0 || connect((socket_t) m_socket, (sockaddr *) &address, sizeof(address)) != 0)
+			{
+				close();
+				return false;
+			}
+
+			return true;
+#endif
+		}
+
+		std::string host = jsonCfg.value("host", std::string("127.0.0.1"));
+		std::string port = std::to_string(jsonCfg.value("port", 9999));
+
+		addrinfo hints;
+		memset(&hints, 0, sizeof(hints));
+		hints.ai_family = AF_UNSPEC;
+		hints.ai_socktype = SOCK_DGRAM;
+
+		addrinfo * result = NULL;
+		if (getaddrinfo(host.c_str(), port.c_str(), &hints, &result) != 0)
+			return false;
+
+		// Connected datagram socket, send() then needs no address per call
+		for (addrinfo * it = result; it != NULL; it = it->ai_next)
+		{
+			m_socket = (intptr_t) socket(it->ai_family, it->ai_socktype, it->ai_protocol);
+
+			if (m_socket >= 0 && connect((socket_t) m_socket, it->ai_addr, (int) it->ai_addrlen) == 0)
+				break;
+
+			close();
+		}
+
+		freeaddrinfo(result);
+
+		return m_socket >= 0;
+	}
+
+	void SINK_Socket::close()
+	{
+		if (m_socket < 0)
+			return;
+
+#ifdef _WIN32
+		closesocket((socket_t) m_socket);
+#else
+		::close((socket_t) m_socket);
+#endif
+		m_socket = -1;
+	}
+
+	bool SINK_Socket::write(const std::vector<SINK_Message_t> & messages)
+	{
+		bool ok = true;
+
+		if (getFormat() == SINK_FORMAT_BINARY)
+		{
+			for (const SINK_Message_t & message : messages)
+			{
+				if (m_datagram.empty())
+					m_scope.begin(m_datagram);
+
+				// A record that does not fit anymore starts the next datagram along with its entry
+				size_t size = m_datagram.size();
+				m_scope.append(message, m_datagram);
+
+				if (m_datagram.size() > m_maxDatagram && size > sizeof(CODEC_MAGIC))
+				{
+					m_datagram.resize(size);
+					ok = flush() && ok;
+
+					m_scope.begin(m_datagram);
+					m_scope.append(message, m_datagram);
+				}
+			}
+
+			return ok;
+		}
+
+		for (const SINK_Message_t & message : messages)
+		{
+			// Send what is packed so far once the next body does not fit anymore
+			if (m_datagram.empty() == false && m_datagram.size() + 1 + message.body.size() > m_maxDatagram)
+				ok = flush() && ok;
+
+			if (m_datagram.empty() == false)
+				m_datagram += '\n';
+
+			m_datagram.append(message.body.data(), message.body.size());
+		}
+
+		return ok;
+	}
+
+	bool SINK_Socket::flush()
+	{
+		if (m_datagram.empty())
+			return true;
+
+		bool ok = m_socket >= 0 && send((socket_t) m_socket, m_datagram.data(), (int) m_datagram.size(), SINK_SEND_FLAGS) == (int) m_datagram.size();
+		m_datagram.clear();
+
+		return ok;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#ifndef SINK_SOCKET_H
+#define SINK_SOCKET_H
+
+#include <string>
+#include <cstdint>
+#include "sink_sink.h"
+#include "sink_dictionary.h"
+
+namespace gateway
+{
+
+	enum SINK_SocketType_t
+	{
+		SINK_SOCKET_UDP,
+		SINK_SOCKET_UNIX
+	};
+
+	// Sends variables as datagrams over UDP or a Unix domain socket. Bodies
+	// are packed newline separated into datagrams of up to maxDatagram bytes,
+	// a body larger than that goes out on its own. In the binary format each
+	// datagram is a stream of its own, so a lost one loses no dictionary.
+	class SINK_Socket : public SINK_Sink
+	{
+	public:
+		SINK_Socket(
+			const std::string & name,
+			const std::string & jsonConfig,
+			SINK_SocketType_t type
+		);
+		~SINK_Socket();
+	protected:
+		bool write(const std::vector<SINK_Message_t> & messages) override;
+		bool flush() override;
+	private:
+		bool open(const std::string & jsonConfig);
+		void close();
+		SINK_SocketType_t m_type;
+		intptr_t m_socket;
+		size_t m_maxDatagram;
+		std::string m_datagram;
+		SINK_DictionaryScope m_scope;
+	};
+
+}
+
+#endif // SINK_SOCKET_H
\ No newline at end of file
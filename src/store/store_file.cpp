@@ -0,0 +1,198 @@
+#include "store_file.h"
+#ifdef _WIN32
+#include <windows.h>
+#include <direct.h>
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <cerrno>
+
+namespace gateway
+{
+
+	STORE_Mapping::STORE_Mapping() :
+		m_data(NULL),
+		m_size(0),
+		m_file(-1),
+		m_mapping(-1)
+	{
+
+	}
+
+	STORE_Mapping::~STORE_Mapping()
+	{
+		unmap();
+	}
+
+	bool STORE_Mapping::map(const std::string & path)
+	{
+		unmap();
+
+#ifdef _WIN32
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size;
+		if (GetFileSizeEx(file, &size) == FALSE)
+		{
+			CloseHandle(file);
+			return false;
+		}
+
+		m_file = (intptr_t) file;
+		m_size = (size_t) size.QuadPart;
+		if (m_size == 0)
+			return true;
+
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping == NULL)
+		{
+			unmap();
+			return false;
+		}
+
+		m_mapping = (intptr_t) mapping;
+		m_data = (const uint8_t *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+		int file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0)
+			return false;
+
+		struct stat info;
+		if (fstat(file, &info) != 0)
+		{
+			::close(file);
+			return false;
+		}
+
+		m_file = file;
+		m_size = (size_t) info.st_size;
+		if (m_size == 0)
+			return true;
+
+		void * data = mmap(NULL, m_size, PROT_READ, MAP_SHARED, file, 0);
+		m_data = (data == MAP_FAILED) ? NULL : (const uint8_t *) data;
+#endif
+
+		if (m_data == NULL)
+		{
+			unmap();
+			return false;
+		}
+
+		return true;
+	}
+
+	void STORE_Mapping::unmap()
+	{
+#ifdef _WIN32
+		if (m_data != NULL)
+			UnmapViewOfFile(m_data);
+		if (m_mapping != -1)
+			CloseHandle((HANDLE) m_mapping);
+		if (m_file != -1)
+			CloseHandle((HANDLE) m_file);
+#else
+		if (m_data != NULL)
+			munmap((void *) m_data, m_size);
+		if (m_file != -1)
+			::close((int) m_file);
+#endif
+
+		m_data = NULL;
+		m_size = 0;
+		m_file = -1;
+		m_mapping = -1;
+	}
+
+	const uint8_t * STORE_Mapping::data() const
+	{
+		return m_data;
+	}
+
+	size_t STORE_Mapping::size() const
+	{
+		return m_size;
+	}
+
+	bool STORE_MakeDirectory(const std::string & path)
+	{
+#ifdef _WIN32
+		return _mkdir(path.c_str()) == 0 || errno == EEXIST;
+#else
+		return mkdir(path.c_str(), 0755) == 0 || errno == EEXIST;
+#endif
+	}
+
+	std::vector<std::string> STORE_ListFiles(const std::string & directory, const std::string & extension)
+	{
+		std::vector<std::string> names;
+
+#ifdef _WIN32
+		WIN32_FIND_DATAA entry;
+		HANDLE find = FindFirstFileA((directory + "\\*" + extension).c_str(), &entry);
+		if (find == INVALID_HANDLE_VALUE)
+			return names;
+
+		do
+		{
+			names.push_back(entry.cFileName);
+		} while (FindNextFileA(find, &entry));
+
+		FindClose(find);
+#else
+		DIR * dir = opendir(directory.c_str());
+		if (dir == NULL)
+			return names;
+
+		while (struct dirent * entry = readdir(dir))
+		{
+			std::string name = entry->d_name;
+			if (name.size() > extension.size() && name.compare(name.size() - extension.size(), extension.size(), extension) == 0)
+				names.push_back(name);
+		}
+
+		closedir(dir);
+#endif
+
+		return names;
+	}
+
+	uint64_t STORE_FileSize(const std::string & path)
+	{
+#ifdef _WIN32
+		WIN32_FILE_ATTRIBUTE_DATA info;
+		if (GetFileAttributesExA(path.c_str(), GetFileExInfoStandard, &info) == FALSE)
+			return 0;
+		return ((uint64_t) info.nFileSizeHigh << 32) | info.nFileSizeLow;
+#else
+		struct stat info;
+		if (stat(path.c_str(), &info) != 0)
+			return 0;
+		return (uint64_t) info.st_size;
+#endif
+	}
+
+	bool STORE_Truncate(const std::string & path, uint64_t size)
+	{
+#ifdef _WIN32
+		int file = _open(path.c_str(), _O_RDWR | _O_BINARY);
+		if (file < 0)
+			return false;
+		bool ok = _chsize_s(file, (__int64) size) == 0;
+		_close(file);
+		return ok;
+#else
+		return truncate(path.c_str(), (off_t) size) == 0;
+#endif
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#ifndef STORE_FILE_H
+#define STORE_FILE_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace gateway
+{
+
+	// Read-only memory mapping of a whole file, remapped by the owner when the
+	// file has grown. An empty file maps to no data.
+	class STORE_Mapping
+	{
+	public:
+		STORE_Mapping();
+		~STORE_Mapping();
+		bool map(const std::string & path);
+		void unmap();
+		const uint8_t * data() const;
+		size_t size() const;
+	private:
+		STORE_Mapping(const STORE_Mapping &);
+		STORE_Mapping & operator=(const STORE_Mapping &);
+		const uint8_t * m_data;
+		size_t m_size;
+		intptr_t m_file;
+		intptr_t m_mapping;
+	};
+
+	// Platform file helpers of the store
+	bool STORE_MakeDirectory(const std::string & path);
+	std::vector<std::string> STORE_ListFiles(const std::string & directory, const std::string & extension);
+	uint64_t STORE_FileSize(const std::string & path);
+	bool STORE_Truncate(const std::string & path, uint64_t size);
+
+}
+
+#endif // STORE_FILE_H
\ No newline at end of file
@@ -0,0 +1,722 @@
+#include "store_timeseries.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <limits>
+#include <open62541.h>
+#include "../macros.h"
+#include "../util/metrics.h"
+#include "../3rdparty/json.hpp"
+
+// For convenience
+using json = nlohmann::json;
+
+namespace gateway
+{
+
+	namespace
+	{
+
+		// Records are tagId u32, time i64 and value f64, index entries minTime i64, maxTime i64,
+		// first u64 and count u32, chunk index entries add tagId u32 and size u32, all packed
+		// little-endian
+		const size_t RECORD_SIZE = 20;
+		const size_t INDEX_SIZE = 28;
+		const size_t CHUNK_INDEX_SIZE = 36;
+
+		const char * dataExtension(bool compressed)
+		{
+			return compressed ? ".gseg" : ".seg";
+		}
+
+		const char * indexExtension(bool compressed)
+		{
+			return compressed ? ".gidx" : ".idx";
+		}
+
+		void resetBlock(STORE_Block_t & block, uint64_t first)
+		{
+			block.minTime = std::numeric_limits<int64_t>::max();
+			block.maxTime = std::numeric_limits<int64_t>::min();
+			block.first = first;
+			block.count = 0;
+			block.tagId = STORE_TimeSeries::npos;
+			block.size = 0;
+		}
+
+		void extendBlock(STORE_Block_t & block, int64_t time)
+		{
+			block.minTime = std::min(block.minTime, time);
+			block.maxTime = std::max(block.maxTime, time);
+			block.count++;
+		}
+
+		void encodeBlock(const STORE_Block_t & block, bool compressed, std::string & out)
+		{
+			char bytes[CHUNK_INDEX_SIZE];
+			memcpy(bytes, &block.minTime, 8);
+			memcpy(bytes + 8, &block.maxTime, 8);
+			memcpy(bytes + 16, &block.first, 8);
+			memcpy(bytes + 24, &block.count, 4);
+			memcpy(bytes + 28, &block.tagId, 4);
+			memcpy(bytes + 32, &block.size, 4);
+			out.append(bytes, compressed ? CHUNK_INDEX_SIZE : INDEX_SIZE);
+		}
+
+		void decodeBlock(const uint8_t * bytes, bool compressed, STORE_Block_t & block)
+		{
+			memcpy(&block.minTime, bytes, 8);
+			memcpy(&block.maxTime, bytes + 8, 8);
+			memcpy(&block.first, bytes + 16, 8);
+			memcpy(&block.count, bytes + 24, 4);
+			block.tagId = STORE_TimeSeries::npos;
+			block.size = 0;
+			if (compressed)
+			{
+				memcpy(&block.tagId, bytes + 28, 4);
+				memcpy(&block.size, bytes + 32, 4);
+			}
+		}
+
+		void decodeRecord(const uint8_t * record, uint32_t & tagId, int64_t & time, double & value)
+		{
+			memcpy(&tagId, record, 4);
+			memcpy(&time, record + 4, 8);
+			memcpy(&value, record + 12, 8);
+		}
+
+		void scanBlock(const uint8_t * data, const STORE_Block_t & block, uint32_t tagId, int64_t from, int64_t to, std::vector<STORE_Sample_t> & samples)
+		{
+			const uint8_t * record = data + block.first * RECORD_SIZE;
+
+			for (uint32_t i = 0; i < block.count; i++, record += RECORD_SIZE)
+			{
+				uint32_t id;
+				int64_t time;
+				double value;
+				decodeRecord(record, id, time, value);
+
+				if (id == tagId && time >= from && time <= to)
+					samples.push_back({ time, value });
+			}
+		}
+
+		void scanChunk(const uint8_t * data, size_t size, uint32_t count, int64_t from, int64_t to, std::vector<STORE_Sample_t> & samples)
+		{
+			CODEC_GorillaDecoder decoder(data, size, count);
+			int64_t time;
+			double value;
+
+			while (decoder.next(time, value))
+			{
+				if (time >= from && time <= to)
+					samples.push_back({ time, value });
+			}
+		}
+
+		void latestInChunk(const uint8_t * data, size_t size, uint32_t count, int64_t time, STORE_Sample_t & sample, bool & found)
+		{
+			CODEC_GorillaDecoder decoder(data, size, count);
+			int64_t t;
+			double value;
+
+			while (decoder.next(t, value))
+			{
+				if (t <= time && (found == false || t > sample.time))
+				{
+					sample.time = t;
+					sample.value = value;
+					found = true;
+				}
+			}
+		}
+
+	}
+
+	const uint32_t STORE_TimeSeries::npos;
+
+	STORE_TimeSeries::STORE_TimeSeries(
+		const std::string & jsonConfig
+	) :
+		m_path("./res/history"),
+		m_segmentDuration(3600 * UA_SEC_TO_DATETIME),
+		m_retention(7 * 24 * 3600 * UA_SEC_TO_DATETIME),
+		m_indexInterval(1024),
+		m_bufferSize(1024 * 1024),
+		m_compressed(false),
+		m_chunkSize(1024),
+		m_chunkDuration(300 * UA_SEC_TO_DATETIME),
+		m_mutex(),
+		m_tags(),
+		m_catalog(NULL),
+		m_segments(),
+		m_active(NULL),
+		m_data(NULL),
+		m_index(NULL),
+		m_dataBuffer(),
+		m_indexBuffer(),
+		m_chunks(),
+		m_chunkBytes(),
+		m_newest(std::numeric_limits<int64_t>::min()),
+		m_appended(0),
+		m_queries(0),
+		m_queryTime(0.0)
+	{
+		json jsonCfg = json::parse(jsonConfig);
+		m_path = jsonCfg.value("path", m_path);
+		m_segmentDuration = std::max<int64_t>(1, (int64_t)(jsonCfg.value("segmentDuration", 3600.0) * UA_SEC_TO_DATETIME));
+		m_retention = (int64_t)(jsonCfg.value("retention", 7 * 24 * 3600.0) * UA_SEC_TO_DATETIME);
+		m_indexInterval = std::max<uint32_t>(1, jsonCfg.value("indexInterval", m_indexInterval));
+		m_bufferSize = jsonCfg.value("bufferSize", m_bufferSize);
+		m_compressed = jsonCfg.value("compression", std::string("none")) == "gorilla";
+		m_chunkSize = std::max<uint32_t>(1, jsonCfg.value("chunkSize", m_chunkSize));
+		m_chunkDuration = std::max<int64_t>(1, (int64_t)(jsonCfg.value("chunkDuration", 300.0) * UA_SEC_TO_DATETIME));
+		m_dataBuffer.reserve(m_bufferSize + RECORD_SIZE);
+
+		load();
+
+		LOG("STORE_TimeSeries initialized, path: %s, compression: %s, segments: %u, tags: %u\n", UA_DateTime_now(), m_path.c_str(), m_compressed ? "gorilla" : "none", (unsigned int) m_segments.size(), (unsigned int) m_tags.size());
+	}
+
+	STORE_TimeSeries::~STORE_TimeSeries()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		// Index the open block, the next start need not scan it, and write out the open chunks
+		if (m_active != NULL && m_active->open.count > 0)
+		{
+			m_active->blocks.push_back(m_active->open);
+			encodeBlock(m_active->open, false, m_indexBuffer);
+			resetBlock(m_active->open, m_active->count);
+		}
+		sealAll();
+
+		flushLocked();
+
+		if (m_data != NULL)
+			fclose(m_data);
+		if (m_index != NULL)
+			fclose(m_index);
+		if (m_catalog != NULL)
+			fclose(m_catalog);
+	}
+
+	std::string STORE_TimeSeries::segmentPath(int64_t start, const char * extension) const
+	{
+		return m_path + "/" + std::to_string(start) + extension;
+	}
+
+	void STORE_TimeSeries::load()
+	{
+		if (STORE_MakeDirectory(m_path) == false)
+			ERR("STORE_TimeSeries cannot create directory %s.\n", UA_DateTime_now(), m_path.c_str());
+
+		// The catalog maps "serverId\tnsIndex\tidentifier" to the tag id, one line per tag
+		std::string catalogPath = m_path + "/tags.cat";
+		FILE * catalog = fopen(catalogPath.c_str(), "rb");
+		if (catalog != NULL)
+		{
+			std::string line;
+			int c;
+			while ((c = fgetc(catalog)) != EOF)
+			{
+				if (c != '\n')
+				{
+					line += (char) c;
+					continue;
+				}
+
+				size_t tab = line.find('\t');
+				if (tab != std::string::npos)
+					m_tags[line.substr(tab + 1)] = (uint32_t) strtoul(line.c_str(), NULL, 10);
+				line.clear();
+			}
+			fclose(catalog);
+		}
+
+		m_catalog = fopen(catalogPath.c_str(), "ab");
+		if (m_catalog == NULL)
+			ERR("STORE_TimeSeries cannot open %s for appending.\n", UA_DateTime_now(), catalogPath.c_str());
+
+		for (const std::string & name : STORE_ListFiles(m_path, dataExtension(false)))
+			loadSegment(strtoll(name.c_str(), NULL, 10), false);
+		for (const std::string & name : STORE_ListFiles(m_path, dataExtension(true)))
+			loadSegment(strtoll(name.c_str(), NULL, 10), true);
+
+		for (auto & it : m_segments)
+			m_newest = std::max(m_newest, it.second->maxTime);
+	}
+
+	void STORE_TimeSeries::loadSegment(int64_t start, bool compressed)
+	{
+		if (m_segments.count(start) > 0)
+		{
+			WRN("STORE_TimeSeries skips segment %lld, stored in both formats.\n", UA_DateTime_now(), (long long) start);
+			return;
+		}
+
+		std::unique_ptr<STORE_Segment_t> segment(new STORE_Segment_t());
+		segment->start = start;
+		segment->minTime = std::numeric_limits<int64_t>::max();
+		segment->maxTime = std::numeric_limits<int64_t>::min();
+		segment->compressed = compressed;
+
+		// A record cut short by an interrupted write is dropped
+		std::string dataPath = segmentPath(start, dataExtension(compressed));
+		uint64_t size = STORE_FileSize(dataPath);
+		segment->count = compressed ? 0 : size / RECORD_SIZE;
+		segment->size = compressed ? size : segment->count * RECORD_SIZE;
+		if (size != segment->size)
+			STORE_Truncate(dataPath, segment->size);
+
+		// Index entries past the data are dropped as well, the records after the last entry form the open block
+		size_t entrySize = compressed ? CHUNK_INDEX_SIZE : INDEX_SIZE;
+		std::string indexPath = segmentPath(start, indexExtension(compressed));
+		uint64_t indexSize = STORE_FileSize(indexPath);
+		FILE * index = fopen(indexPath.c_str(), "rb");
+		if (index != NULL)
+		{
+			uint8_t bytes[CHUNK_INDEX_SIZE];
+			while (fread(bytes, 1, entrySize, index) == entrySize)
+			{
+				STORE_Block_t block;
+				decodeBlock(bytes, compressed, block);
+
+				if (compressed ? block.first + block.size > segment->size : block.first + block.count > segment->count)
+					break;
+				segment->blocks.push_back(block);
+			}
+			fclose(index);
+		}
+
+		if (indexSize != segment->blocks.size() * entrySize)
+			STORE_Truncate(indexPath, segment->blocks.size() * entrySize);
+
+		if (compressed)
+		{
+			// Chunk bytes without their index entry cannot be read back
+			segment->size = segment->blocks.empty() ? 0 : segment->blocks.back().first + segment->blocks.back().size;
+			if (size != segment->size)
+				STORE_Truncate(dataPath, segment->size);
+			for (const STORE_Block_t & block : segment->blocks)
+				segment->count += block.count;
+			resetBlock(segment->open, 0);
+		}
+		else
+		{
+			uint64_t covered = segment->blocks.empty() ? 0 : segment->blocks.back().first + segment->blocks.back().count;
+			resetBlock(segment->open, covered);
+
+			if (covered < segment->count && mapSegment(*segment))
+			{
+				for (uint64_t i = covered; i < segment->count; i++)
+				{
+					uint32_t id;
+					int64_t time;
+					double value;
+					decodeRecord(segment->mapping.data() + i * RECORD_SIZE, id, time, value);
+					extendBlock(segment->open, time);
+				}
+			}
+		}
+
+		for (const STORE_Block_t & block : segment->blocks)
+		{
+			segment->minTime = std::min(segment->minTime, block.minTime);
+			segment->maxTime = std::max(segment->maxTime, block.maxTime);
+		}
+		if (segment->open.count > 0)
+		{
+			segment->minTime = std::min(segment->minTime, segment->open.minTime);
+			segment->maxTime = std::max(segment->maxTime, segment->open.maxTime);
+		}
+
+		m_segments[start] = std::move(segment);
+	}
+
+	uint32_t STORE_TimeSeries::intern(int32_t serverId, uint16_t nsIndex, const std::string & identifier)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::string key = std::to_string(serverId) + "\t" + std::to_string(nsIndex) + "\t" + identifier;
+
+		auto it = m_tags.find(key);
+		if (it != m_tags.end())
+			return it->second;
+
+		uint32_t id = (uint32_t) m_tags.size();
+		m_tags[key] = id;
+
+		if (m_catalog != NULL)
+		{
+			std::string line = std::to_string(id) + "\t" + key + "\n";
+			fwrite(line.data(), 1, line.size(), m_catalog);
+			fflush(m_catalog);
+		}
+
+		return id;
+	}
+
+	uint32_t STORE_TimeSeries::find(int32_t serverId, uint16_t nsIndex, const std::string & identifier)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_tags.find(std::to_string(serverId) + "\t" + std::to_string(nsIndex) + "\t" + identifier);
+		return (it != m_tags.end()) ? it->second : npos;
+	}
+
+	void STORE_TimeSeries::append(const STORE_Point_t * points, size_t count)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		for (size_t i = 0; i < count; i++)
+		{
+			const STORE_Point_t & point = points[i];
+			int64_t start = point.time - point.time % m_segmentDuration;
+			m_newest = std::max(m_newest, point.time);
+
+			if (m_active == NULL || start > m_active->start)
+				roll(start);
+
+			STORE_Segment_t & segment = *m_active;
+			segment.count++;
+			segment.minTime = std::min(segment.minTime, point.time);
+			segment.maxTime = std::max(segment.maxTime, point.time);
+
+			if (segment.compressed)
+			{
+				// Tag ids are interned densely
+				if (point.tagId >= m_chunks.size())
+					m_chunks.resize(point.tagId + 1);
+
+				STORE_Chunk_t & chunk = m_chunks[point.tagId];
+				if (chunk.encoder.getCount() > 0 && point.time - chunk.minTime >= m_chunkDuration)
+					seal(point.tagId);
+
+				if (chunk.encoder.getCount() == 0)
+				{
+					chunk.minTime = point.time;
+					chunk.maxTime = point.time;
+				}
+				else
+				{
+					chunk.minTime = std::min(chunk.minTime, point.time);
+					chunk.maxTime = std::max(chunk.maxTime, point.time);
+				}
+
+				chunk.encoder.append(point.time, point.value);
+				if (chunk.encoder.getCount() >= m_chunkSize)
+					seal(point.tagId);
+				continue;
+			}
+
+			char record[RECORD_SIZE];
+			memcpy(record, &point.tagId, 4);
+			memcpy(record + 4, &point.time, 8);
+			memcpy(record + 12, &point.value, 8);
+			m_dataBuffer.append(record, RECORD_SIZE);
+			segment.size += RECORD_SIZE;
+
+			// Close the block every indexInterval records
+			extendBlock(segment.open, point.time);
+			if (segment.open.count >= m_indexInterval)
+			{
+				segment.blocks.push_back(segment.open);
+				encodeBlock(segment.open, false, m_indexBuffer);
+				resetBlock(segment.open, segment.count);
+			}
+		}
+
+		m_appended += count;
+
+		if (m_dataBuffer.size() >= m_bufferSize)
+			flushLocked();
+	}
+
+	void STORE_TimeSeries::seal(uint32_t tagId)
+	{
+		STORE_Chunk_t & chunk = m_chunks[tagId];
+		if (chunk.encoder.getCount() == 0)
+			return;
+
+		chunk.encoder.getBytes(m_chunkBytes);
+		m_dataBuffer += m_chunkBytes;
+
+		STORE_Block_t block;
+		block.minTime = chunk.minTime;
+		block.maxTime = chunk.maxTime;
+		block.first = m_active->size;
+		block.count = chunk.encoder.getCount();
+		block.tagId = tagId;
+		block.size = (uint32_t) m_chunkBytes.size();
+
+		m_active->blocks.push_back(block);
+		m_active->size += block.size;
+		encodeBlock(block, true, m_indexBuffer);
+
+		chunk.encoder.reset();
+	}
+
+	void STORE_TimeSeries::sealAll()
+	{
+		for (uint32_t tagId = 0; tagId < m_chunks.size(); tagId++)
+			seal(tagId);
+	}
+
+	void STORE_TimeSeries::roll(int64_t start)
+	{
+		// Index the open block or write out the open chunks of the segment left behind
+		if (m_active != NULL && m_active->open.count > 0)
+		{
+			m_active->blocks.push_back(m_active->open);
+			encodeBlock(m_active->open, false, m_indexBuffer);
+			resetBlock(m_active->open, m_active->count);
+		}
+		sealAll();
+
+		flushLocked();
+
+		if (m_data != NULL)
+			fclose(m_data);
+		if (m_index != NULL)
+			fclose(m_index);
+
+		// A partition seen before, eg. before a restart, is continued in its format
+		std::unique_ptr<STORE_Segment_t> & segment = m_segments[start];
+		if (segment == NULL)
+		{
+			segment.reset(new STORE_Segment_t());
+			segment->start = start;
+			segment->minTime = std::numeric_limits<int64_t>::max();
+			segment->maxTime = std::numeric_limits<int64_t>::min();
+			segment->count = 0;
+			segment->size = 0;
+			segment->compressed = m_compressed;
+			resetBlock(segment->open, 0);
+		}
+
+		m_active = segment.get();
+		m_data = fopen(segmentPath(start, dataExtension(segment->compressed)).c_str(), "ab");
+		m_index = fopen(segmentPath(start, indexExtension(segment->compressed)).c_str(), "ab");
+
+		if (m_data == NULL || m_index == NULL)
+			ERR("STORE_TimeSeries cannot open segment %lld for appending.\n", UA_DateTime_now(), (long long) start);
+
+		enforceRetention();
+	}
+
+	void STORE_TimeSeries::enforceRetention()
+	{
+		if (m_retention <= 0)
+			return;
+
+		int64_t cutoff = m_newest - m_retention;
+
+		for (auto it = m_segments.begin(); it != m_segments.end();)
+		{
+			STORE_Segment_t & segment = *it->second;
+
+			if (&segment == m_active || segment.count == 0 || segment.maxTime >= cutoff)
+			{
+				++it;
+				continue;
+			}
+
+			segment.mapping.unmap();
+			std::remove(segmentPath(segment.start, dataExtension(segment.compressed)).c_str());
+			std::remove(segmentPath(segment.start, indexExtension(segment.compressed)).c_str());
+
+			LOG("STORE_TimeSeries removed segment %lld past retention\n", UA_DateTime_now(), (long long) segment.start);
+			it = m_segments.erase(it);
+		}
+	}
+
+	void STORE_TimeSeries::flushLocked()
+	{
+		// Records go out before the index entries that refer to them
+		if (m_data != NULL && m_dataBuffer.empty() == false)
+		{
+			fwrite(m_dataBuffer.data(), 1, m_dataBuffer.size(), m_data);
+			fflush(m_data);
+		}
+		if (m_index != NULL && m_indexBuffer.empty() == false)
+		{
+			fwrite(m_indexBuffer.data(), 1, m_indexBuffer.size(), m_index);
+			fflush(m_index);
+		}
+
+		m_dataBuffer.clear();
+		m_indexBuffer.clear();
+	}
+
+	void STORE_TimeSeries::flush()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		flushLocked();
+	}
+
+	bool STORE_TimeSeries::mapSegment(STORE_Segment_t & segment)
+	{
+		// Remap once the segment has grown past the mapped size
+		if (segment.mapping.size() < segment.size)
+			segment.mapping.map(segmentPath(segment.start, dataExtension(segment.compressed)));
+
+		return segment.mapping.data() != NULL && segment.mapping.size() >= segment.size;
+	}
+
+	size_t STORE_TimeSeries::query(uint32_t tagId, int64_t from, int64_t to, std::vector<STORE_Sample_t> & samples)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		size_t first = samples.size();
+
+		flushLocked();
+
+		for (auto & it : m_segments)
+		{
+			STORE_Segment_t & segment = *it.second;
+
+			if (segment.size == 0 || segment.maxTime < from || segment.minTime > to || mapSegment(segment) == false)
+				continue;
+
+			// Chunks belong to one tag, blocks of records to all of them
+			for (const STORE_Block_t & block : segment.blocks)
+			{
+				if (block.maxTime < from || block.minTime > to)
+					continue;
+
+				if (segment.compressed == false)
+					scanBlock(segment.mapping.data(), block, tagId, from, to, samples);
+				else if (block.tagId == tagId)
+					scanChunk(segment.mapping.data() + block.first, block.size, block.count, from, to, samples);
+			}
+
+			if (segment.open.count > 0 && segment.open.maxTime >= from && segment.open.minTime <= to)
+				scanBlock(segment.mapping.data(), segment.open, tagId, from, to, samples);
+		}
+
+		if (tagId < m_chunks.size())
+		{
+			const STORE_Chunk_t & chunk = m_chunks[tagId];
+			if (chunk.encoder.getCount() > 0 && chunk.maxTime >= from && chunk.minTime <= to)
+			{
+				chunk.encoder.getBytes(m_chunkBytes);
+				scanChunk((const uint8_t *) m_chunkBytes.data(), m_chunkBytes.size(), chunk.encoder.getCount(), from, to, samples);
+			}
+		}
+
+		// Late samples may be stored out of order
+		std::stable_sort(samples.begin() + first, samples.end(), [](const STORE_Sample_t & a, const STORE_Sample_t & b) { return a.time < b.time; });
+
+		m_queries++;
+		m_queryTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+		return samples.size() - first;
+	}
+
+	bool STORE_TimeSeries::at(uint32_t tagId, int64_t time, STORE_Sample_t & sample)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		std::chrono::steady_clock::time_point begin = std::chrono::steady_clock::now();
+		bool found = false;
+
+		flushLocked();
+
+		// The open chunk holds the newest samples of the tag
+		if (tagId < m_chunks.size())
+		{
+			const STORE_Chunk_t & chunk = m_chunks[tagId];
+			if (chunk.encoder.getCount() > 0 && chunk.minTime <= time)
+			{
+				chunk.encoder.getBytes(m_chunkBytes);
+				latestInChunk((const uint8_t *) m_chunkBytes.data(), m_chunkBytes.size(), chunk.encoder.getCount(), time, sample, found);
+			}
+		}
+
+		// Newest partitions first, blocks that cannot hold a later sample than the one found are skipped
+		for (auto it = m_segments.rbegin(); it != m_segments.rend(); ++it)
+		{
+			STORE_Segment_t & segment = *it->second;
+
+			if (segment.size == 0 || segment.minTime > time || (found && segment.maxTime <= sample.time) || mapSegment(segment) == false)
+				continue;
+
+			size_t n_blocks = segment.blocks.size() + ((segment.open.count > 0) ? 1 : 0);
+			for (size_t b = n_blocks; b-- > 0;)
+			{
+				const STORE_Block_t & block = (b < segment.blocks.size()) ? segment.blocks[b] : segment.open;
+
+				if (block.minTime > time || (found && block.maxTime <= sample.time))
+					continue;
+
+				if (segment.compressed)
+				{
+					if (block.tagId == tagId)
+						latestInChunk(segment.mapping.data() + block.first, block.size, block.count, time, sample, found);
+					continue;
+				}
+
+				const uint8_t * record = segment.mapping.data() + block.first * RECORD_SIZE;
+				for (uint32_t i = 0; i < block.count; i++, record += RECORD_SIZE)
+				{
+					uint32_t id;
+					int64_t t;
+					double value;
+					decodeRecord(record, id, t, value);
+
+					if (id == tagId && t <= time && (found == false || t > sample.time))
+					{
+						sample.time = t;
+						sample.value = value;
+						found = true;
+					}
+				}
+			}
+		}
+
+		m_queries++;
+		m_queryTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+
+		return found;
+	}
+
+	size_t STORE_TimeSeries::getSegmentCount()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_segments.size();
+	}
+
+	uint64_t STORE_TimeSeries::getSampleCount()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		uint64_t count = 0;
+		for (auto & it : m_segments)
+			count += it.second->count;
+		return count;
+	}
+
+	void STORE_TimeSeries::reportMetrics()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		uint64_t n_samples = 0;
+		uint64_t n_bytes = 0;
+		for (auto & it : m_segments)
+		{
+			n_samples += it.second->count;
+			n_bytes += it.second->size;
+		}
+		for (const STORE_Chunk_t & chunk : m_chunks)
+			n_bytes += chunk.encoder.size();
+
+		Metrics::instance().add("store.appended", (double) m_appended);
+		Metrics::instance().set("store.samples", (double) n_samples);
+		Metrics::instance().set("store.bytes", (double) n_bytes);
+		Metrics::instance().set("store.bytes_per_sample", (n_samples > 0) ? (double) n_bytes / n_samples : 0.0);
+		Metrics::instance().set("store.segments", (double) m_segments.size());
+		Metrics::instance().set("store.query_ms", (m_queries > 0) ? m_queryTime / m_queries : 0.0);
+
+		m_appended = 0;
+		m_queries = 0;
+		m_queryTime = 0.0;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,136 @@
+#ifndef STORE_TIMESERIES_H
+#define STORE_TIMESERIES_H
+
+#include <string>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include "store_file.h"
+#include "../codec/codec_gorilla.h"
+
+namespace gateway
+{
+
+	// One sample to append, time is a UA_DateTime (100 ns ticks since 1601)
+	struct STORE_Point_t
+	{
+		uint32_t tagId;
+		int64_t time;
+		double value;
+	};
+
+	struct STORE_Sample_t
+	{
+		int64_t time;
+		double value;
+	};
+
+	// Index entry. Of a raw segment: time bounds of indexInterval consecutive
+	// records starting at record first. Of a compressed segment: one chunk of
+	// tag tagId, size bytes at byte offset first holding count samples.
+	struct STORE_Block_t
+	{
+		int64_t minTime;
+		int64_t maxTime;
+		uint64_t first;
+		uint32_t count;
+		uint32_t tagId;
+		uint32_t size;
+	};
+
+	// A time partition. Raw ones keep 20 byte records in <start>.seg and
+	// their sparse index in <start>.idx, the block being filled is only kept
+	// in memory and on open rebuilt from the records past the last indexed
+	// block. Compressed ones keep Gorilla chunks in <start>.gseg and one
+	// index entry per chunk in <start>.gidx.
+	struct STORE_Segment_t
+	{
+		int64_t start;
+		int64_t minTime;
+		int64_t maxTime;
+		uint64_t count;
+		uint64_t size;
+		bool compressed;
+		std::vector<STORE_Block_t> blocks;
+		STORE_Block_t open;
+		STORE_Mapping mapping;
+	};
+
+	// Chunk of one tag being filled in the active compressed segment
+	struct STORE_Chunk_t
+	{
+		CODEC_GorillaEncoder encoder;
+		int64_t minTime;
+		int64_t maxTime;
+	};
+
+	// Append-only local history of numeric samples keyed by interned tag id.
+	// Records go into time partitions of segmentDuration seconds, a sample of
+	// an older partition arriving late joins the current one, the time bounds
+	// of blocks and segments cover it either way. Queries flush pending
+	// writes, memory map the segments overlapping the range and scan only the
+	// blocks whose bounds overlap it. Segments older than retention seconds,
+	// measured from the newest sample, are deleted as new ones are started.
+	// With "compression": "gorilla" new segments hold per tag chunks instead,
+	// sealed at chunkSize samples, after chunkDuration seconds or when the
+	// segment is left. Open chunks are only kept in memory, they are lost on
+	// a crash but not on a regular shutdown.
+	class STORE_TimeSeries
+	{
+	public:
+		STORE_TimeSeries(
+			const std::string & jsonConfig
+		);
+		~STORE_TimeSeries();
+		uint32_t intern(int32_t serverId, uint16_t nsIndex, const std::string & identifier);
+		uint32_t find(int32_t serverId, uint16_t nsIndex, const std::string & identifier);
+		void append(const STORE_Point_t * points, size_t count);
+		size_t query(uint32_t tagId, int64_t from, int64_t to, std::vector<STORE_Sample_t> & samples);
+		bool at(uint32_t tagId, int64_t time, STORE_Sample_t & sample);
+		void flush();
+		size_t getSegmentCount();
+		uint64_t getSampleCount();
+		void reportMetrics();
+		static const uint32_t npos = 0xFFFFFFFF;
+	private:
+		void load();
+		void loadSegment(int64_t start, bool compressed);
+		void roll(int64_t start);
+		void enforceRetention();
+		void flushLocked();
+		void seal(uint32_t tagId);
+		void sealAll();
+		bool mapSegment(STORE_Segment_t & segment);
+		std::string segmentPath(int64_t start, const char * extension) const;
+		std::string m_path;
+		int64_t m_segmentDuration;
+		int64_t m_retention;
+		uint32_t m_indexInterval;
+		size_t m_bufferSize;
+		bool m_compressed;
+		uint32_t m_chunkSize;
+		int64_t m_chunkDuration;
+		std::mutex m_mutex;
+		std::unordered_map<std::string, uint32_t> m_tags;
+		FILE * m_catalog;
+		std::map<int64_t, std::unique_ptr<STORE_Segment_t>> m_segments;
+		STORE_Segment_t * m_active;
+		FILE * m_data;
+		FILE * m_index;
+		std::string m_dataBuffer;
+		std::string m_indexBuffer;
+		std::vector<STORE_Chunk_t> m_chunks;
+		std::string m_chunkBytes;
+		int64_t m_newest;
+		uint64_t m_appended;
+		uint64_t m_queries;
+		double m_queryTime;
+	};
+
+}
+
+#endif // STORE_TIMESERIES_H
\ No newline at end of file
@@ -0,0 +1,81 @@
+#include "arena.h"
+#include <algorithm>
+
+namespace gateway
+{
+
+	Arena::Arena(size_t blockSize) :
+		m_blocks(),
+		m_current(0),
+		m_offset(0),
+		m_blockSize(blockSize),
+		m_used(0),
+		m_blockAllocations(0)
+	{
+
+	}
+
+	Arena::~Arena()
+	{
+		for (Block & block : m_blocks)
+			delete[] block.data;
+	}
+
+	void * Arena::allocate(size_t size, size_t align)
+	{
+		while (m_current < m_blocks.size())
+		{
+			Block & block = m_blocks[m_current];
+			uintptr_t base = (uintptr_t) block.data;
+			size_t offset = (size_t)(((base + m_offset + align - 1) & ~(uintptr_t)(align - 1)) - base);
+
+			if (offset + size <= block.size)
+			{
+				m_used += offset + size - m_offset;
+				m_offset = offset + size;
+				return block.data + offset;
+			}
+
+			// Move on to the next kept block, the rest of this one stays unused until reset()
+			m_current++;
+			m_offset = 0;
+		}
+
+		// Out of blocks, oversized requests get a block of their own
+		Block block = { new uint8_t[std::max(m_blockSize, size + align)], std::max(m_blockSize, size + align) };
+		m_blocks.push_back(block);
+		m_current = m_blocks.size() - 1;
+		m_offset = 0;
+		m_blockAllocations++;
+
+		return allocate(size, align);
+	}
+
+	void Arena::reset()
+	{
+		m_current = 0;
+		m_offset = 0;
+		m_used = 0;
+	}
+
+	size_t Arena::getUsed() const
+	{
+		return m_used;
+	}
+
+	size_t Arena::getCapacity() const
+	{
+		size_t capacity = 0;
+
+		for (const Block & block : m_blocks)
+			capacity += block.size;
+
+		return capacity;
+	}
+
+	uint64_t Arena::getBlockAllocations() const
+	{
+		return m_blockAllocations;
+	}
+
+}
\ No newline at end of file
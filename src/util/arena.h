@@ -0,0 +1,88 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+// std includes
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include <string>
+
+namespace gateway
+{
+
+	// ---------------------------------------------------------------------------
+	// Arena
+	// Monotonic buffer for temporaries that die together, eg. everything built
+	// while handling one publish response. Allocations bump a pointer, nothing
+	// is freed individually; reset() rewinds to the start and keeps the blocks
+	// so a steady workload stops calling the system allocator altogether.
+	// ---------------------------------------------------------------------------
+	class Arena
+	{
+	public:
+		explicit Arena(size_t blockSize = 64 * 1024);
+		~Arena();
+		void * allocate(size_t size, size_t align = alignof(std::max_align_t));
+		void reset();
+		size_t getUsed() const;
+		size_t getCapacity() const;
+		uint64_t getBlockAllocations() const;
+	private:
+		Arena(const Arena &);
+		Arena & operator=(const Arena &);
+		struct Block
+		{
+			uint8_t * data;
+			size_t size;
+		};
+		std::vector<Block> m_blocks;
+		size_t m_current;
+		size_t m_offset;
+		size_t m_blockSize;
+		size_t m_used;
+		uint64_t m_blockAllocations;
+	};
+
+	// ---------------------------------------------------------------------------
+	// ArenaAllocator
+	// Standard allocator drawing from an Arena, deallocate is a no-op.
+	// ---------------------------------------------------------------------------
+	template<typename T>
+	class ArenaAllocator
+	{
+	public:
+		typedef T value_type;
+		ArenaAllocator(Arena * arena) : m_arena(arena) {}
+		template<typename U>
+		ArenaAllocator(const ArenaAllocator<U> & other) : m_arena(other.getArena()) {}
+		T * allocate(size_t n)
+		{
+			return (T *) m_arena->allocate(n * sizeof(T), alignof(T));
+		}
+		void deallocate(T *, size_t)
+		{
+
+		}
+		Arena * getArena() const
+		{
+			return m_arena;
+		}
+		template<typename U>
+		bool operator==(const ArenaAllocator<U> & other) const
+		{
+			return m_arena == other.getArena();
+		}
+		template<typename U>
+		bool operator!=(const ArenaAllocator<U> & other) const
+		{
+			return m_arena != other.getArena();
+		}
+	private:
+		Arena * m_arena;
+	};
+
+	typedef std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>> ArenaString;
+
+}
+
+#endif // ARENA_H
\ No newline at end of file
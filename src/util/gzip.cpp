@@ -0,0 +1,607 @@
+#include "gzip.h"
+#include <algorithm>
+#include <queue>
+#include <cstring>
+
+namespace gateway
+{
+
+	namespace
+	{
+
+		const size_t WINDOW_SIZE = 32768;
+		const size_t WINDOW_MASK = WINDOW_SIZE - 1;
+		const size_t HASH_SIZE = 32768;
+		const size_t MIN_MATCH = 3;
+		const size_t MAX_MATCH = 258;
+		const size_t BLOCK_SYMBOLS = 16384;
+		const size_t STORED_MAX = 65535;
+
+		const uint16_t LENGTH_BASE[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+		const uint8_t LENGTH_EXTRA[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+		const uint16_t DIST_BASE[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577 };
+		const uint8_t DIST_EXTRA[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+		const uint8_t CODELEN_ORDER[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+		// Per level: hash chain length searched, match length that ends the search, lazy matching
+		const size_t LEVEL_CHAIN[10] = { 0, 4, 8, 16, 32, 64, 128, 256, 1024, 4096 };
+		const size_t LEVEL_NICE[10] = { 0, 8, 16, 32, 64, 128, 128, 258, 258, 258 };
+
+		void buildCodes(const uint8_t * lengths, size_t n, uint16_t * codes)
+		{
+			uint16_t count[16] = { 0 };
+			uint16_t next[16] = { 0 };
+
+			for (size_t i = 0; i < n; i++)
+				count[lengths[i]]++;
+			count[0] = 0;
+
+			uint16_t code = 0;
+			for (int bits = 1; bits < 16; bits++)
+			{
+				code = (uint16_t)((code + count[bits - 1]) << 1);
+				next[bits] = code;
+			}
+
+			// Deflate sends Huffman codes starting from their most significant bit
+			for (size_t i = 0; i < n; i++)
+			{
+				codes[i] = 0;
+				if (lengths[i] == 0)
+					continue;
+
+				uint16_t value = next[lengths[i]]++;
+				for (int b = 0; b < lengths[i]; b++)
+					codes[i] |= (uint16_t)(((value >> b) & 1) << (lengths[i] - 1 - b));
+			}
+		}
+
+		// Huffman code lengths of at most limit bits. Frequencies are halved until the tree fits,
+		// at least two symbols get a code so every code is complete
+		void buildLengths(const uint32_t * freq, size_t n, int limit, uint8_t * lengths)
+		{
+			std::vector<uint32_t> weights(freq, freq + n);
+
+			size_t n_used = 0;
+			for (size_t i = 0; i < n; i++)
+				n_used += (weights[i] > 0) ? 1 : 0;
+			for (size_t i = 0; i < n && n_used < 2; i++)
+			{
+				if (weights[i] == 0)
+				{
+					weights[i] = 1;
+					n_used++;
+				}
+			}
+
+			std::vector<int> parents(2 * n);
+			std::vector<uint8_t> depths(2 * n);
+
+			for (;;)
+			{
+				typedef std::pair<uint64_t, int> node_t;
+				std::priority_queue<node_t, std::vector<node_t>, std::greater<node_t>> queue;
+
+				for (size_t i = 0; i < n; i++)
+				{
+					if (weights[i] > 0)
+						queue.push(node_t(weights[i], (int) i));
+				}
+
+				int next = (int) n;
+				while (queue.size() > 1)
+				{
+					node_t a = queue.top();
+					queue.pop();
+					node_t b = queue.top();
+					queue.pop();
+
+					parents[a.second] = next;
+					parents[b.second] = next;
+					queue.push(node_t(a.first + b.first, next++));
+				}
+
+				// Internal nodes are created after their children, the root last
+				int root = next - 1;
+				depths[root] = 0;
+				for (int i = root - 1; i >= (int) n; i--)
+					depths[i] = (uint8_t)(depths[parents[i]] + 1);
+
+				int maxLength = 0;
+				for (size_t i = 0; i < n; i++)
+				{
+					lengths[i] = (weights[i] > 0) ? (uint8_t)(depths[parents[i]] + 1) : 0;
+					maxLength = std::max<int>(maxLength, lengths[i]);
+				}
+
+				if (maxLength <= limit)
+					return;
+
+				for (size_t i = 0; i < n; i++)
+				{
+					if (weights[i] > 0)
+						weights[i] = (weights[i] >> 1) | 1;
+				}
+			}
+		}
+
+		struct Tables
+		{
+			uint8_t lengthCode[MAX_MATCH + 1];
+			uint8_t distCode[WINDOW_SIZE];
+			uint32_t crc[256];
+			uint8_t fixedLitLengths[288];
+			uint16_t fixedLitCodes[288];
+			uint8_t fixedDistLengths[30];
+			uint16_t fixedDistCodes[30];
+
+			Tables()
+			{
+				for (int code = 0; code < 29; code++)
+				{
+					for (size_t length = LENGTH_BASE[code]; length < LENGTH_BASE[code] + (1u << LENGTH_EXTRA[code]) && length <= MAX_MATCH; length++)
+						lengthCode[length] = (uint8_t) code;
+				}
+				lengthCode[MAX_MATCH] = 28;
+
+				for (int code = 0; code < 30; code++)
+				{
+					for (size_t distance = DIST_BASE[code]; distance < DIST_BASE[code] + (1u << DIST_EXTRA[code]) && distance < WINDOW_SIZE; distance++)
+						distCode[distance] = (uint8_t) code;
+				}
+
+				for (uint32_t i = 0; i < 256; i++)
+				{
+					uint32_t c = i;
+					for (int k = 0; k < 8; k++)
+						c = (c & 1) ? 0xEDB88320 ^ (c >> 1) : c >> 1;
+					crc[i] = c;
+				}
+
+				for (int i = 0; i < 288; i++)
+					fixedLitLengths[i] = (i < 144) ? 8 : (i < 256) ? 9 : (i < 280) ? 7 : 8;
+				for (int i = 0; i < 30; i++)
+					fixedDistLengths[i] = 5;
+
+				buildCodes(fixedLitLengths, 288, fixedLitCodes);
+				buildCodes(fixedDistLengths, 30, fixedDistCodes);
+			}
+		};
+
+		const Tables & tables()
+		{
+			static Tables instance;
+			return instance;
+		}
+
+	}
+
+	Gzip::Gzip(int level) :
+		m_level(6),
+		m_maxChain(0),
+		m_niceLength(0),
+		m_lazy(false),
+		m_head(HASH_SIZE, -1),
+		m_prev(WINDOW_SIZE, -1),
+		m_inserted(0),
+		m_symbols(),
+		m_litFreq(),
+		m_distFreq(),
+		m_out(NULL),
+		m_bits(0),
+		m_bitCount(0)
+	{
+		setLevel(level);
+		m_symbols.reserve(BLOCK_SYMBOLS);
+	}
+
+	void Gzip::setLevel(int level)
+	{
+		m_level = std::min(std::max(level, 0), 9);
+		m_maxChain = LEVEL_CHAIN[m_level];
+		m_niceLength = LEVEL_NICE[m_level];
+		m_lazy = m_level >= 4;
+	}
+
+	int Gzip::getLevel() const
+	{
+		return m_level;
+	}
+
+	uint32_t Gzip::crc32(const uint8_t * data, size_t size, uint32_t crc)
+	{
+		const uint32_t * table = tables().crc;
+
+		crc = ~crc;
+		for (size_t i = 0; i < size; i++)
+			crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+		return ~crc;
+	}
+
+	void Gzip::compress(const char * data, size_t size, std::string & out)
+	{
+		const uint8_t * bytes = (const uint8_t *) data;
+
+		out.clear();
+		out.reserve(size / 4 + 64);
+
+		m_out = &out;
+		m_bits = 0;
+		m_bitCount = 0;
+
+		// Member header: deflate, no name or mtime, extra flags per level, unknown OS
+		const char header[10] = { 0x1F, (char) 0x8B, 8, 0, 0, 0, 0, 0, (char)((m_level == 9) ? 2 : (m_level <= 1) ? 4 : 0), (char) 0xFF };
+		out.append(header, sizeof(header));
+
+		deflate(bytes, size);
+		alignBits();
+
+		uint32_t crc = crc32(bytes, size);
+		uint32_t isize = (uint32_t) size;
+		for (int i = 0; i < 4; i++)
+			out += (char)(uint8_t)(crc >> (8 * i));
+		for (int i = 0; i < 4; i++)
+			out += (char)(uint8_t)(isize >> (8 * i));
+
+		m_out = NULL;
+	}
+
+	void Gzip::deflate(const uint8_t * data, size_t size)
+	{
+		std::fill(m_head.begin(), m_head.end(), -1);
+		std::fill(m_litFreq, m_litFreq + 286, 0);
+		std::fill(m_distFreq, m_distFreq + 30, 0);
+		m_symbols.clear();
+		m_inserted = 0;
+
+		if (m_level == 0)
+		{
+			writeStored(data, 0, size, true);
+			return;
+		}
+
+		size_t start = 0;
+		size_t pos = 0;
+		bool last = false;
+
+		while (pos < size)
+		{
+			size_t distance = 0;
+			size_t length = findMatch(data, size, pos, 0, distance);
+
+			// Lazy matching: emit a literal instead when the match at the next byte is longer
+			while (m_lazy && length >= MIN_MATCH && length < m_niceLength && pos + 1 < size)
+			{
+				size_t nextDistance = 0;
+				size_t nextLength = findMatch(data, size, pos + 1, length, nextDistance);
+
+				if (nextLength <= length)
+					break;
+
+				literal(data[pos++]);
+				length = nextLength;
+				distance = nextDistance;
+			}
+
+			// Far away 3 byte matches cost more than their literals
+			if (length >= MIN_MATCH && (length > MIN_MATCH || distance <= 4096))
+			{
+				match(length, distance);
+				pos += length;
+			}
+			else
+			{
+				literal(data[pos++]);
+			}
+
+			if (m_symbols.size() >= BLOCK_SYMBOLS)
+			{
+				last = pos >= size;
+				flushBlock(data, start, pos, last);
+				start = pos;
+			}
+		}
+
+		if (last == false)
+			flushBlock(data, start, size, true);
+	}
+
+	void Gzip::insert(const uint8_t * data, size_t size, size_t upTo)
+	{
+		for (size_t p = m_inserted; p < upTo && p + MIN_MATCH <= size; p++)
+		{
+			size_t hash = ((data[p] << 10) ^ (data[p + 1] << 5) ^ data[p + 2]) & (HASH_SIZE - 1);
+			m_prev[p & WINDOW_MASK] = m_head[hash];
+			m_head[hash] = (int32_t) p;
+		}
+
+		m_inserted = std::max(m_inserted, upTo);
+	}
+
+	size_t Gzip::findMatch(const uint8_t * data, size_t size, size_t pos, size_t prevLength, size_t & distance)
+	{
+		// Every position before this one is in the hash chains
+		insert(data, size, pos);
+
+		if (pos + MIN_MATCH > size)
+			return 0;
+
+		size_t maxLength = std::min(MAX_MATCH, size - pos);
+		size_t best = std::max(prevLength, MIN_MATCH - 1);
+		size_t found = 0;
+
+		if (best >= maxLength)
+			return 0;
+
+		const uint8_t * a = data + pos;
+		size_t hash = ((a[0] << 10) ^ (a[1] << 5) ^ a[2]) & (HASH_SIZE - 1);
+		int32_t cur = m_head[hash];
+		size_t chain = m_maxChain;
+
+		while (cur >= 0 && chain-- > 0)
+		{
+			size_t d = pos - (size_t) cur;
+			if (d >= WINDOW_SIZE)
+				break;
+
+			const uint8_t * b = data + cur;
+
+			// Only a match longer than the best so far is of interest
+			if (b[best] == a[best] && b[0] == a[0] && b[1] == a[1])
+			{
+				size_t length = 2;
+				while (length < maxLength && a[length] == b[length])
+					length++;
+
+				if (length > best)
+				{
+					best = length;
+					found = length;
+					distance = d;
+
+					if (length >= m_niceLength || length >= maxLength)
+						break;
+				}
+			}
+
+			int32_t next = m_prev[(size_t) cur & WINDOW_MASK];
+			if (next >= cur)
+				break;
+			cur = next;
+		}
+
+		return found;
+	}
+
+	void Gzip::literal(uint8_t value)
+	{
+		m_symbols.push_back(value);
+		m_litFreq[value]++;
+	}
+
+	void Gzip::match(size_t length, size_t distance)
+	{
+		m_symbols.push_back(0x80000000u | ((uint32_t) distance << 9) | (uint32_t) length);
+		m_litFreq[257 + tables().lengthCode[length]]++;
+		m_distFreq[tables().distCode[distance]]++;
+	}
+
+	void Gzip::flushBlock(const uint8_t * data, size_t start, size_t end, bool last)
+	{
+		const Tables & t = tables();
+
+		m_litFreq[256]++;
+
+		uint8_t litLengths[286];
+		uint8_t distLengths[30];
+		buildLengths(m_litFreq, 286, 15, litLengths);
+		buildLengths(m_distFreq, 30, 15, distLengths);
+
+		size_t n_lit = 286;
+		while (n_lit > 257 && litLengths[n_lit - 1] == 0)
+			n_lit--;
+		size_t n_dist = 30;
+		while (n_dist > 1 && distLengths[n_dist - 1] == 0)
+			n_dist--;
+
+		// Run length encode the code lengths of both trees as one sequence
+		uint8_t lengths[286 + 30];
+		memcpy(lengths, litLengths, n_lit);
+		memcpy(lengths + n_lit, distLengths, n_dist);
+		size_t n_lengths = n_lit + n_dist;
+
+		std::vector<uint16_t> runs;
+		uint32_t codeLenFreq[19] = { 0 };
+		for (size_t i = 0; i < n_lengths;)
+		{
+			uint8_t length = lengths[i];
+			size_t run = 1;
+			while (i + run < n_lengths && lengths[i + run] == length)
+				run++;
+
+			if (length == 0 && run >= 3)
+			{
+				run = std::min<size_t>(run, 138);
+				uint16_t symbol = (run >= 11) ? 18 : 17;
+				runs.push_back((uint16_t)(symbol | ((run - ((symbol == 18) ? 11 : 3)) << 8)));
+				codeLenFreq[symbol]++;
+			}
+			else if (length != 0 && run >= 4)
+			{
+				// The first length goes as it is, the repeats after it
+				run = std::min<size_t>(run, 7);
+				runs.push_back(length);
+				runs.push_back((uint16_t)(16 | ((run - 4) << 8)));
+				codeLenFreq[length]++;
+				codeLenFreq[16]++;
+			}
+			else
+			{
+				run = 1;
+				runs.push_back(length);
+				codeLenFreq[length]++;
+			}
+
+			i += run;
+		}
+
+		uint8_t codeLenLengths[19];
+		uint16_t codeLenCodes[19];
+		buildLengths(codeLenFreq, 19, 7, codeLenLengths);
+		buildCodes(codeLenLengths, 19, codeLenCodes);
+
+		size_t n_codeLen = 19;
+		while (n_codeLen > 4 && codeLenLengths[CODELEN_ORDER[n_codeLen - 1]] == 0)
+			n_codeLen--;
+
+		// Size of each block type in bits, the extra bits of matches are the same for both Huffman types
+		uint64_t extraBits = 0;
+		for (int i = 0; i < 29; i++)
+			extraBits += (uint64_t) m_litFreq[257 + i] * LENGTH_EXTRA[i];
+		for (int i = 0; i < 30; i++)
+			extraBits += (uint64_t) m_distFreq[i] * DIST_EXTRA[i];
+
+		uint64_t dynamicBits = 3 + 14 + 3 * n_codeLen + extraBits;
+		for (uint16_t run : runs)
+		{
+			uint8_t symbol = (uint8_t)(run & 0xFF);
+			dynamicBits += codeLenLengths[symbol] + ((symbol == 16) ? 2 : (symbol == 17) ? 3 : (symbol == 18) ? 7 : 0);
+		}
+
+		uint64_t fixedBits = 3 + extraBits;
+		for (int i = 0; i < 286; i++)
+		{
+			dynamicBits += (uint64_t) m_litFreq[i] * litLengths[i];
+			fixedBits += (uint64_t) m_litFreq[i] * t.fixedLitLengths[i];
+		}
+		for (int i = 0; i < 30; i++)
+		{
+			dynamicBits += (uint64_t) m_distFreq[i] * distLengths[i];
+			fixedBits += (uint64_t) m_distFreq[i] * t.fixedDistLengths[i];
+		}
+
+		size_t n_stored = std::max<size_t>(1, (end - start + STORED_MAX - 1) / STORED_MAX);
+		uint64_t storedBits = 8 * (uint64_t)(end - start) + 42 * n_stored;
+
+		if (storedBits <= fixedBits && storedBits <= dynamicBits)
+		{
+			writeStored(data, start, end, last);
+		}
+		else if (fixedBits <= dynamicBits)
+		{
+			putBits(last ? 1 : 0, 1);
+			putBits(1, 2);
+			writeSymbols(t.fixedLitLengths, t.fixedLitCodes, t.fixedDistLengths, t.fixedDistCodes);
+		}
+		else
+		{
+			uint16_t litCodes[286];
+			uint16_t distCodes[30];
+			buildCodes(litLengths, 286, litCodes);
+			buildCodes(distLengths, 30, distCodes);
+
+			putBits(last ? 1 : 0, 1);
+			putBits(2, 2);
+			putBits((uint32_t)(n_lit - 257), 5);
+			putBits((uint32_t)(n_dist - 1), 5);
+			putBits((uint32_t)(n_codeLen - 4), 4);
+			for (size_t i = 0; i < n_codeLen; i++)
+				putBits(codeLenLengths[CODELEN_ORDER[i]], 3);
+
+			for (uint16_t run : runs)
+			{
+				uint8_t symbol = (uint8_t)(run & 0xFF);
+				putBits(codeLenCodes[symbol], codeLenLengths[symbol]);
+
+				if (symbol == 16)
+					putBits(run >> 8, 2);
+				else if (symbol == 17)
+					putBits(run >> 8, 3);
+				else if (symbol == 18)
+					putBits(run >> 8, 7);
+			}
+
+			writeSymbols(litLengths, litCodes, distLengths, distCodes);
+		}
+
+		m_symbols.clear();
+		std::fill(m_litFreq, m_litFreq + 286, 0);
+		std::fill(m_distFreq, m_distFreq + 30, 0);
+	}
+
+	void Gzip::writeStored(const uint8_t * data, size_t start, size_t end, bool last)
+	{
+		do
+		{
+			size_t length = std::min(end - start, STORED_MAX);
+			bool final = last && start + length == end;
+
+			putBits(final ? 1 : 0, 1);
+			putBits(0, 2);
+			alignBits();
+
+			*m_out += (char)(uint8_t) length;
+			*m_out += (char)(uint8_t)(length >> 8);
+			*m_out += (char)(uint8_t) ~length;
+			*m_out += (char)(uint8_t)(~length >> 8);
+			m_out->append((const char *) data + start, length);
+
+			start += length;
+		} while (start < end);
+	}
+
+	void Gzip::writeSymbols(const uint8_t * litLengths, const uint16_t * litCodes, const uint8_t * distLengths, const uint16_t * distCodes)
+	{
+		const Tables & t = tables();
+
+		for (uint32_t symbol : m_symbols)
+		{
+			if ((symbol & 0x80000000u) == 0)
+			{
+				putBits(litCodes[symbol], litLengths[symbol]);
+				continue;
+			}
+
+			size_t length = symbol & 0x1FF;
+			size_t distance = (symbol >> 9) & 0xFFFF;
+			uint8_t lengthCode = t.lengthCode[length];
+			uint8_t distCode = t.distCode[distance];
+
+			putBits(litCodes[257 + lengthCode], litLengths[257 + lengthCode]);
+			putBits((uint32_t)(length - LENGTH_BASE[lengthCode]), LENGTH_EXTRA[lengthCode]);
+			putBits(distCodes[distCode], distLengths[distCode]);
+			putBits((uint32_t)(distance - DIST_BASE[distCode]), DIST_EXTRA[distCode]);
+		}
+
+		putBits(litCodes[256], litLengths[256]);
+	}
+
+	void Gzip::putBits(uint32_t value, int count)
+	{
+		m_bits |= (uint64_t) value << m_bitCount;
+		m_bitCount += count;
+
+		if (m_bitCount >= 32)
+		{
+			char bytes[4] = { (char)(uint8_t) m_bits, (char)(uint8_t)(m_bits >> 8), (char)(uint8_t)(m_bits >> 16), (char)(uint8_t)(m_bits >> 24) };
+			m_out->append(bytes, 4);
+			m_bits >>= 32;
+			m_bitCount -= 32;
+		}
+	}
+
+	void Gzip::alignBits()
+	{
+		while (m_bitCount > 0)
+		{
+			*m_out += (char)(uint8_t) m_bits;
+			m_bits >>= 8;
+			m_bitCount -= 8;
+		}
+
+		m_bits = 0;
+		m_bitCount = 0;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,59 @@
+#ifndef GZIP_H
+#define GZIP_H
+
+// std includes
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace gateway
+{
+
+	// ---------------------------------------------------------------------------
+	// Gzip
+	// Self-contained gzip (RFC 1952) compressor of request bodies. Deflate runs
+	// LZ77 over a 32 KiB window with hash chains, lazy matching from level 4,
+	// and picks the smallest of a stored, fixed or dynamic Huffman block for
+	// every run of symbols. The hash tables and buffers live in the object and
+	// are reused, so a compressor is meant to stay with its sending thread.
+	// Levels: 0 stores, 1 is fastest, 9 searches longest.
+	// ---------------------------------------------------------------------------
+	class Gzip
+	{
+	public:
+		Gzip(int level = 6);
+		void setLevel(int level);
+		int getLevel() const;
+		// Replaces out with the gzip member of data
+		void compress(const char * data, size_t size, std::string & out);
+		static uint32_t crc32(const uint8_t * data, size_t size, uint32_t crc = 0);
+	private:
+		void deflate(const uint8_t * data, size_t size);
+		size_t findMatch(const uint8_t * data, size_t size, size_t pos, size_t prevLength, size_t & distance);
+		void insert(const uint8_t * data, size_t size, size_t upTo);
+		void literal(uint8_t value);
+		void match(size_t length, size_t distance);
+		void flushBlock(const uint8_t * data, size_t start, size_t end, bool last);
+		void writeStored(const uint8_t * data, size_t start, size_t end, bool last);
+		void writeSymbols(const uint8_t * litLengths, const uint16_t * litCodes, const uint8_t * distLengths, const uint16_t * distCodes);
+		void putBits(uint32_t value, int count);
+		void alignBits();
+		int m_level;
+		size_t m_maxChain;
+		size_t m_niceLength;
+		bool m_lazy;
+		std::vector<int32_t> m_head;
+		std::vector<int32_t> m_prev;
+		size_t m_inserted;
+		std::vector<uint32_t> m_symbols;
+		uint32_t m_litFreq[286];
+		uint32_t m_distFreq[30];
+		std::string * m_out;
+		uint64_t m_bits;
+		int m_bitCount;
+	};
+
+}
+
+#endif // GZIP_H
\ No newline at end of file
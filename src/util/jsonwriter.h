@@ -0,0 +1,149 @@
+#ifndef JSONWRITER_H
+#define JSONWRITER_H
+
+// std includes
+#include <string>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cmath>
+
+namespace gateway
+{
+
+	// ---------------------------------------------------------------------------
+	// JsonWriter
+	// Appends JSON text straight to a string of any allocator, without building
+	// a json tree first. Commas are inserted automatically; a key is followed by
+	// exactly one value.
+	// ---------------------------------------------------------------------------
+	template<typename S>
+	class JsonWriter
+	{
+	public:
+		explicit JsonWriter(S & out) : m_out(out), m_first(true) {}
+		// Starts a new top level value, e.g. after the text was truncated back
+		void reset() { m_first = true; }
+		JsonWriter & beginObject() { separator(); m_out += '{'; m_first = true; return *this; }
+		JsonWriter & endObject() { m_out += '}'; m_first = false; return *this; }
+		JsonWriter & beginArray() { separator(); m_out += '['; m_first = true; return *this; }
+		JsonWriter & endArray() { m_out += ']'; m_first = false; return *this; }
+		JsonWriter & key(const char * name)
+		{
+			string(name, std::char_traits<char>::length(name));
+			m_out += ':';
+			m_first = true;
+			return *this;
+		}
+		JsonWriter & string(const char * data, size_t length)
+		{
+			static const char hex[] = "0123456789abcdef";
+
+			separator();
+			m_out += '"';
+
+			for (size_t i = 0; i < length; i++)
+			{
+				unsigned char c = (unsigned char) data[i];
+
+				switch (c)
+				{
+				case '"': m_out.append("\\\"", 2); break;
+				case '\\': m_out.append("\\\\", 2); break;
+				case '\b': m_out.append("\\b", 2); break;
+				case '\f': m_out.append("\\f", 2); break;
+				case '\n': m_out.append("\\n", 2); break;
+				case '\r': m_out.append("\\r", 2); break;
+				case '\t': m_out.append("\\t", 2); break;
+				default:
+					if (c < 0x20)
+					{
+						char escaped[6] = { '\\', 'u', '0', '0', hex[c >> 4], hex[c & 15] };
+						m_out.append(escaped, 6);
+					}
+					else
+					{
+						m_out += (char) c;
+					}
+				}
+			}
+
+			m_out += '"';
+			return *this;
+		}
+		JsonWriter & string(const char * data)
+		{
+			return string(data, std::char_traits<char>::length(data));
+		}
+		JsonWriter & value(bool x)
+		{
+			separator();
+			m_out.append(x ? "true" : "false");
+			return *this;
+		}
+		JsonWriter & value(int32_t x) { return value((int64_t) x); }
+		JsonWriter & value(uint32_t x) { return value((uint64_t) x); }
+		JsonWriter & value(int64_t x)
+		{
+			char buffer[24];
+			separator();
+			m_out.append(buffer, std::snprintf(buffer, sizeof(buffer), "%lld", (long long) x));
+			return *this;
+		}
+		JsonWriter & value(uint64_t x)
+		{
+			char buffer[24];
+			separator();
+			m_out.append(buffer, std::snprintf(buffer, sizeof(buffer), "%llu", (unsigned long long) x));
+			return *this;
+		}
+		JsonWriter & value(float x)
+		{
+			// Shortest of the usual precisions that reads back as the same value
+			return real((double) x, 7, 9, true);
+		}
+		JsonWriter & value(double x)
+		{
+			return real(x, 15, 17, false);
+		}
+		JsonWriter & null()
+		{
+			separator();
+			m_out.append("null", 4);
+			return *this;
+		}
+	private:
+		JsonWriter & real(double x, int precision, int maxPrecision, bool single)
+		{
+			separator();
+
+			// JSON has no NaN or infinity
+			if (std::isfinite(x) == false)
+			{
+				m_out.append("null", 4);
+				return *this;
+			}
+
+			char buffer[32];
+			int length = std::snprintf(buffer, sizeof(buffer), "%.*g", precision, x);
+			double back = std::strtod(buffer, NULL);
+
+			if (single ? (float) back != (float) x : back != x)
+				length = std::snprintf(buffer, sizeof(buffer), "%.*g", maxPrecision, x);
+
+			m_out.append(buffer, length);
+			return *this;
+		}
+		void separator()
+		{
+			if (m_first == false)
+				m_out += ',';
+			m_first = false;
+		}
+		S & m_out;
+		bool m_first;
+	};
+
+}
+
+#endif // JSONWRITER_H
\ No newline at end of file
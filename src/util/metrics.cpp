@@ -0,0 +1,54 @@
+#include "metrics.h"
+#include <open62541.h>
+#include "../macros.h"
+
+namespace gateway
+{
+
+	Metrics::Metrics() :
+		m_mutex(),
+		m_values()
+	{
+
+	}
+
+	Metrics & Metrics::instance()
+	{
+		static Metrics metrics;
+		return metrics;
+	}
+
+	void Metrics::add(const std::string & name, double value)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_values[name] += value;
+	}
+
+	void Metrics::set(const std::string & name, double value)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_values[name] = value;
+	}
+
+	double Metrics::get(const std::string & name)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_values.find(name);
+		return (it != m_values.end()) ? it->second : 0.0;
+	}
+
+	std::map<std::string, double> Metrics::snapshot()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_values;
+	}
+
+	void Metrics::report()
+	{
+		std::map<std::string, double> values = snapshot();
+
+		for (const auto & value : values)
+			LOG("Metric %s: %.3f\n", UA_DateTime_now(), value.first.c_str(), value.second);
+	}
+
+}
\ No newline at end of file
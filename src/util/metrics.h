@@ -0,0 +1,45 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+// std includes
+#include <string>
+#include <map>
+#include <mutex>
+#include <cstdint>
+
+namespace gateway
+{
+
+	// ---------------------------------------------------------------------------
+	// Metrics
+	// Process wide registry of named counters and gauges. Meant for events that
+	// happen at most a few times per publish cycle; hot paths should aggregate
+	// locally and add the totals here.
+	// ---------------------------------------------------------------------------
+	class Metrics
+	{
+	public:
+		static Metrics & instance();
+		void add(const std::string & name, double value = 1.0);
+		void set(const std::string & name, double value);
+		double get(const std::string & name);
+		std::map<std::string, double> snapshot();
+		void report();
+	private:
+		Metrics();
+		std::mutex m_mutex;
+		std::map<std::string, double> m_values;
+	};
+
+	// ---------------------------------------------------------------------------
+	// metricname
+	// Builds a metric name scoped to the given serverId, eg. opcua.10.reconnects
+	// ---------------------------------------------------------------------------
+	inline std::string metricname(const char * scope, int32_t serverId, const char * name)
+	{
+		return std::string(scope) + "." + std::to_string(serverId) + "." + name;
+	}
+
+}
+
+#endif // METRICS_H
\ No newline at end of file
@@ -0,0 +1,53 @@
+#include "payload.h"
+#include <cstring>
+
+namespace gateway
+{
+
+	std::atomic<size_t> Payload::s_bytes(0);
+	std::atomic<size_t> Payload::s_count(0);
+
+	Payload::Payload(const char * data, size_t size) :
+		m_data(new char[size > 0 ? size : 1]),
+		m_size(size)
+	{
+		memcpy(m_data, data, size);
+
+		s_bytes += size;
+		s_count++;
+	}
+
+	Payload::~Payload()
+	{
+		s_bytes -= m_size;
+		s_count--;
+
+		delete[] m_data;
+	}
+
+	PayloadRef Payload::create(const char * data, size_t size)
+	{
+		return PayloadRef(new Payload(data, size));
+	}
+
+	const char * Payload::data() const
+	{
+		return m_data;
+	}
+
+	size_t Payload::size() const
+	{
+		return m_size;
+	}
+
+	size_t Payload::getBytesInFlight()
+	{
+		return s_bytes;
+	}
+
+	size_t Payload::getCountInFlight()
+	{
+		return s_count;
+	}
+
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#ifndef PAYLOAD_H
+#define PAYLOAD_H
+
+// std includes
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <atomic>
+
+namespace gateway
+{
+
+	class Payload;
+	typedef std::shared_ptr<const Payload> PayloadRef;
+
+	// ---------------------------------------------------------------------------
+	// Payload
+	// Immutable, reference counted bytes of one serialized batch. Every sink
+	// and queued message refers to slices of the same buffer; it is freed once
+	// the last of them is written or dropped. Live buffers are counted process
+	// wide, so the memory held by egress queues shows up in the metrics.
+	// ---------------------------------------------------------------------------
+	class Payload
+	{
+	public:
+		static PayloadRef create(const char * data, size_t size);
+		~Payload();
+		const char * data() const;
+		size_t size() const;
+		static size_t getBytesInFlight();
+		static size_t getCountInFlight();
+	private:
+		Payload(const char * data, size_t size);
+		Payload(const Payload &);
+		Payload & operator=(const Payload &);
+		char * m_data;
+		size_t m_size;
+		static std::atomic<size_t> s_bytes;
+		static std::atomic<size_t> s_count;
+	};
+
+	// ---------------------------------------------------------------------------
+	// PayloadSlice_t
+	// One record within a payload
+	// ---------------------------------------------------------------------------
+	struct PayloadSlice_t
+	{
+		PayloadRef payload;
+		uint32_t offset;
+		uint32_t length;
+		const char * data() const { return payload->data() + offset; }
+		size_t size() const { return length; }
+	};
+
+}
+
+#endif // PAYLOAD_H
\ No newline at end of file
@@ -7,6 +7,7 @@
 #include <algorithm>
 #include <functional>
 #include <cctype>
+#include <cstdint>
 
 #ifdef _MSC_VER
 #define strncasecmp _strnicmp
@@ -42,6 +43,83 @@ namespace gateway
 		return !str[h] ? 5381 : (cstr2int(str, h + 1) * 33) ^ str[h];
 	}
 
+	// ---------------------------------------------------------------------------
+	// strglob
+	// Matches a string against a glob pattern, '*' matches any sequence and
+	// '?' any single character.
+	// ---------------------------------------------------------------------------
+	inline bool strglob(const char * pattern, const char * str)
+	{
+		const char * star = NULL;
+		const char * retry = NULL;
+
+		while (*str)
+		{
+			if (*pattern == '?' || *pattern == *str)
+			{
+				pattern++;
+				str++;
+			}
+			else if (*pattern == '*')
+			{
+				star = pattern++;
+				retry = str;
+			}
+			else if (star != NULL)
+			{
+				pattern = star + 1;
+				str = ++retry;
+			}
+			else
+			{
+				return false;
+			}
+		}
+
+		while (*pattern == '*')
+			pattern++;
+
+		return *pattern == '\0';
+	}
+
+	// ---------------------------------------------------------------------------
+	// base64encode
+	// Encodes a byte buffer as standard base64 with padding.
+	// ---------------------------------------------------------------------------
+	inline std::string base64encode(const uint8_t * data, size_t length)
+	{
+		static const char table[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+		std::string result(((length + 2) / 3) * 4, '=');
+		char * out = &result[0u];
+
+		// Full 3 byte groups
+		size_t i = 0;
+		for (; i + 2 < length; i += 3)
+		{
+			uint32_t n = (uint32_t(data[i]) << 16) | (uint32_t(data[i + 1]) << 8) | uint32_t(data[i + 2]);
+			*out++ = table[(n >> 18) & 63];
+			*out++ = table[(n >> 12) & 63];
+			*out++ = table[(n >> 6) & 63];
+			*out++ = table[n & 63];
+		}
+
+		// Remaining 1 or 2 bytes, padding is already in place
+		if (i < length)
+		{
+			uint32_t n = uint32_t(data[i]) << 16;
+			if (i + 1 < length)
+				n |= uint32_t(data[i + 1]) << 8;
+
+			*out++ = table[(n >> 18) & 63];
+			*out++ = table[(n >> 12) & 63];
+			if (i + 1 < length)
+				*out++ = table[(n >> 6) & 63];
+		}
+
+		return result;
+	}
+
 	// ---------------------------------------------------------------------------
 	// filetofilepath
 	// Converts a filepath ending to a file into a path to the folder of the file.